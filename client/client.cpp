@@ -1,7 +1,6 @@
 #include "client/client.hpp"
 
 #include "client/client_state.hpp"
-#include "client/graphics/graphics_manager.hpp"
 #include "common/log.hpp"
 #include "common/net_platform.hpp"
 #include "common/session_info.hpp"
@@ -9,15 +8,21 @@
 #include "common/file_watcher.hpp"
 #include "common/frame_timer.hpp"
 #include "common/crc32.hpp"
-#include "client/console.hpp"
 #include "client/config/config.hpp"
 
+#if HEADLESS
+#include <thread>
+#else
+#include "client/graphics/graphics_manager.hpp"
+#include "client/console.hpp"
 #include "client/gui/text_box.hpp"
+#endif
 
 //static Text_Box _text_box; // TODO(janh): Remove this
 
 void RegisterClientCommands();
 
+#if !HEADLESS
 static bool LoadTexture(Texture &texture, StringView filename) {
     auto res = texture.LoadFromFile(filename);
     if (!res) {
@@ -131,10 +136,27 @@ bool Assets::Load() {
 
     return all_loaded;
 }
+#endif
 
 Client::Client() = default;
 Client::~Client() = default;
 
+#if HEADLESS
+bool Client::Init() {
+    LogMilestone("client", "Initializing headless");
+
+    // No window, no audio and no assets. The frame allocator is only used for text rendering.
+    GetConfig().Load();
+    Crc32::InitTable();
+
+    this->SetNextState(client_states::MakeMenu());
+
+    RegisterClientCommands();
+    LogMilestone("client", "Initialization done.");
+
+    return true;
+}
+#else
 bool Client::Init() {
     LogMilestone("client", "Initializing");
 
@@ -173,6 +195,7 @@ bool Client::Init() {
 
     return true;
 }
+#endif
 
 void Client::Deinit() {
     LogInfo("client", "Cleaning up");
@@ -181,11 +204,14 @@ void Client::Deinit() {
         this->state->End();
     }
 
-    this->socket.Close(false);
+    this->net_io.Stop();
+    StopNetTrace(this->net_trace);
 
+#if !HEADLESS
     GetGraphicsManager().Shutdown();
     Mix_CloseAudio();
     SDL_Quit();
+#endif
 }
 
 void Client::MainLoop() {
@@ -198,19 +224,16 @@ void Client::MainLoop() {
         timer.BeginFrame();
 
         auto socket_done =
-            this->socket.state != SocketState::CONNECTED ||
+            this->net_io.GetState() != SocketState::CONNECTED ||
             !this->finish_outbound_packets ||
-            this->socket.send.queue.empty();
+            this->net_io.IsSendDone();
 
         if (this->quit_flag && socket_done) {
             break;
         }
 
-        if (this->socket.DoSend(); this->CheckSocketError()) {
-            continue;
-        }
-
-        if (this->socket.DoRecv(); this->CheckSocketError()) {
+        // The network thread sends and receives, the ticks only exchange packets with it
+        if (this->CheckSocketError()) {
             continue;
         }
 
@@ -219,18 +242,34 @@ void Client::MainLoop() {
             timer.BeginTick();
             this->Input();
             this->Tick();
+#if HEADLESS
+            this->input_latency.OnFrameRendered(); // There are no frames, the tick after the ack is as close as it gets
+#else
             this->Render(); // NOTE(janh): We could also pull this out to render as often as we can
+#endif
             timer.AdvanceTick();
 
             if (++ticks_done > 100) {
                 LogWarning("client", "Cannot keep up the framerate! Did {} ticks in this main loop iteration"_format(ticks_done));
             }
         }
+
+#if HEADLESS
+        // There is no vsync to wait for, so do not burn a core per client between the ticks
+        std::this_thread::sleep_for(timer.GetTickLength() - timer.accu);
+#endif
     }
 
     LogInfo("Client", "Main loop exit");
 }
 
+#if HEADLESS
+void Client::Input() {
+    this->LockStateChange();
+    this->driver.Tick();
+    this->UnlockStateChange();
+}
+#else
 void Client::Input() {
     SDL_Event event;
     this->gui.BeginInput();
@@ -248,6 +287,13 @@ void Client::Input() {
             case SDL_QUIT: {
                 this->Quit();
             } break;
+
+            case SDL_KEYDOWN: {
+                if (event.key.keysym.sym == SDLK_F3) {
+                    this->net_graph.Toggle();
+                    continue;
+                }
+            } break;
         }
 
         //_text_box.handle_input(event);
@@ -264,6 +310,7 @@ void Client::Input() {
 
     this->gui.EndInput();
 }
+#endif
 
 void Client::Tick() {
     //_text_box.tick();
@@ -271,11 +318,18 @@ void Client::Tick() {
     GetFileWatcher().Update(); // TODO(janh): We don't need to do this every frame!
 
     Packet incoming_packet;
+    NetIoThread::ReceivedPacket received;
 
+#if !HEADLESS
     GetConsole().Tick(dt);
+    this->net_graph.BeginTick(this->net_io);
+#endif
 
-    while (this->socket.Pop(incoming_packet)) {
+    while (this->net_io.Pop(received)) {
         if (this->state) {
+            incoming_packet.Reset(ToRvalue(received.data));
+            this->packet_received_at = received.received_at;
+
             this->LockStateChange();
             this->state->net_message_handlers.HandlePacket(ToRvalue(incoming_packet));
             this->UnlockStateChange();
@@ -287,8 +341,13 @@ void Client::Tick() {
         this->state->Tick(dt);
         this->UnlockStateChange();
     }
+
+#if !HEADLESS
+    this->net_graph.EndTick(this->net_io, this->clock_estimate);
+#endif
 }
 
+#if !HEADLESS
 void Client::Render() {
     GetGraphicsManager().BeginFrame();
 
@@ -300,6 +359,7 @@ void Client::Render() {
 
     this->gui.Render();
     GetConsole().Render();
+    this->net_graph.Render();
     //_text_box.render();
 
 #if defined(DEVELOPMENT) && DEVELOPMENT // TODO(janh) show_fps in config???
@@ -320,7 +380,9 @@ void Client::Render() {
 #endif
 
     GetGraphicsManager().EndFrame();
+    this->input_latency.OnFrameRendered();
 }
+#endif
 
 void Client::Quit() {
 #if defined(DEVELOPMENT) && DEVELOPMENT && WINDOWS
@@ -395,7 +457,7 @@ void Client::_SetState(UniquePtr<ClientState> new_state) {
 
 void Client::Disconnect() {
     assert(false);
-    this->socket.Close(false);
+    this->net_io.Stop();
 }
 
 void Client::ProtocolError() {
@@ -405,12 +467,17 @@ void Client::ProtocolError() {
 
 void Client::SendPacket(Packet &pkt) {
     pkt.WriteHeader();
-    this->socket.Push(pkt);
+    this->net_io.Send(ToRvalue(pkt));
+}
+
+f32 Client::GetTicksSinceReceived() const {
+    auto waited = NetIoThread::Clock::now() - this->packet_received_at;
+    return chrono::duration<f32>{waited} / chrono::duration<f32>{GetFrameTimer().GetTickLength()};
 }
 
 bool Client::CheckSocketError() {
-    if (this->socket.state == SocketState::ERROR) {
-        this->socket.Close(false);
+    if (this->net_io.GetState() == SocketState::ERROR) {
+        this->net_io.Stop();
         LogInfo("Client", "Network error");
 
         if (!this->error_message.has_value()) {
@@ -424,11 +491,13 @@ bool Client::CheckSocketError() {
     return false;
 }
 
+#if !HEADLESS
 void Client::PlaySample(Mix_Chunk *chunk) {
     Mix_PlayChannel(-1, chunk, 0);
 }
+#endif
 
-void Client::HandleDisconnectMessage(DisconnectMessage &&message) {
+void Client::HandleDisconnectMessage(const DisconnectMessageView &message) {
     this->error_message = "Disconnected from server: {} (message: {})"_format(ToString(message.reason), message.message);
 }
 
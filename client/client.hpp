@@ -3,23 +3,34 @@
 #include "common/common.hpp"
 #include "common/game_state.hpp"
 #include "common/socket.hpp"
+#include "common/net_trace.hpp"
+#include "common/net_msg.hpp"
+#include "client/input_latency.hpp"
+#include "client/net_io.hpp"
 #include "client_state.hpp"
-#include "client/gui.hpp"
-#include "client/graphics/text.hpp"
-#include "client/graphics/shader.hpp"
 #include "common/frame_allocator.hpp"
 
-#if defined(LINUX) && LINUX
-#	include <SDL2/SDL.h>
-#	include <SDL2/SDL_mixer.h>
+#if HEADLESS
+#	include "client/headless/driver.hpp"
 #else
-#	include <SDL.h>
-#	include <SDL_mixer.h>
+#	include "client/gui.hpp"
+#	include "client/net_graph.hpp"
+#	include "client/graphics/text.hpp"
+#	include "client/graphics/shader.hpp"
+
+#	if defined(LINUX) && LINUX
+#		include <SDL2/SDL.h>
+#		include <SDL2/SDL_mixer.h>
+#	else
+#		include <SDL.h>
+#		include <SDL_mixer.h>
+#	endif
 #endif
 
 struct SessionInfo;
 struct DisconnectMessage;
 
+#if !HEADLESS
 struct Assets {
     bool Load();
 
@@ -62,6 +73,7 @@ struct Assets {
         Shader glowing_projectile;
     } shaders;
 };
+#endif
 
 struct Client {
     Client();
@@ -75,7 +87,9 @@ struct Client {
     void MainLoop();
     void Input();
     void Tick();
+#if !HEADLESS
     void Render();
+#endif
     void Quit();
     void LockStateChange();
     void UnlockStateChange();
@@ -83,10 +97,13 @@ struct Client {
     void SetNextState(UniquePtr<ClientState> state);
     void Disconnect();
     void SendPacket(Packet &pkt);
+    f32 GetTicksSinceReceived() const; // How long the packet that is being handled waited for the tick
     void ProtocolError();
     bool CheckSocketError();
+#if !HEADLESS
     void PlaySample(Mix_Chunk *chunk);
-    void HandleDisconnectMessage(DisconnectMessage &&message);
+#endif
+    void HandleDisconnectMessage(const DisconnectMessageView &message);
 
     template<typename T>
     void Send(const T &data) {
@@ -107,12 +124,23 @@ struct Client {
     bool quit_flag = false;
     FrameAllocator frame_allocator;
     bool finish_outbound_packets = false;
+#if !HEADLESS
     Assets assets;
+#endif
     UniquePtr<ClientState> state;
     UniquePtr<ClientState> next_state;
     bool defer_state_change = false;
-    TcpSocket socket;
+    NetTraceWriter net_trace; // See the trace command
+    InputLatencyTracer input_latency; // See the latency_trace command
+    NetIoThread net_io;
+    NetIoThread::Clock::time_point packet_received_at; // Of the packet that is being handled
+#if HEADLESS
+    HeadlessDriver driver; // Takes the place of the GUI and the SDL input
+#else
     GuiState gui;
+    NetGraph net_graph;
+#endif
+    Optional<ClockSyncMessage> clock_estimate; // The server's latest, while ingame
 
     Optional<String> error_message;
 };
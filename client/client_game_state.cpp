@@ -4,150 +4,172 @@
 #include "common/log.hpp"
 #include "client/client.hpp"
 
+#if !HEADLESS
+#include "client/graphics/graphics_manager.hpp"
+#endif
+
 #include <glm/glm.hpp>
 #include <algorithm>
 #include <random>
 
-ClientGameState::ClientGameState() {
-    this->command_callbacks[GameCommand::Type::MOVE_TANK] =
-        [](ClientGameState &state, const CommandContext &context, GameCommand &command) {
-            auto &move_tank = static_cast<MoveTankCommand &>(command);
-            auto entity = Entity{move_tank.entity};
-            auto &planet_position = state.entities.Get<CPlanetPosition>(entity);
-            planet_position.value = move_tank.planet_position;
-            planet_position.delta = move_tank.velocity;
-            return true;
-        };
+#if HEADLESS
+static const Vec2 headless_view_size{1920.0f, 1080.0f}; // What the camera would see without a window
+#endif
 
-    this->command_callbacks[GameCommand::Type::ROTATE_TURRET] =
-        [](ClientGameState &state, const CommandContext &context, GameCommand &command) {
-            auto &rotate_turret = static_cast<RotateTurretCommand &>(command);
-            state.entities.Get<CTank>(Entity{rotate_turret.entity}).target_turret_rotation = rotate_turret.target_rotation;
-            return true;
-        };
-
-    this->command_callbacks[GameCommand::Type::CHARGE] =
-        [](ClientGameState &state, const CommandContext &context, GameCommand &command) {
-            auto &charge_command = static_cast<ChargeCommand &>(command);
-
-            auto player_tank = state.my_tank.value();
-            if (player_tank != Entity{charge_command.entity}) {
-                return false;
-            }
-
-            auto charging = state.entities.TryGet<CCharging>(player_tank);
-            if (charge_command.fire) {
-                if (charging == nullptr) {
-                    // Was not charging
-                    return false;
-                } else {
-                    state.entities.Remove<CCharging>(player_tank);
-                }
-            } else {
-                if (charging == nullptr) {
-                    // Charge
-                    state.entities.Add<CCharging>(player_tank).start_time = state.time;
-                    return true;
-                } else {
-                    // Was already charging
-                    charging->start_time = state.time;
-                    return false;
-                }
-            }
+bool ClientGameState::Deserialize(Packet &packet) {
+    return
+        packet.ReadU8(this->background_color.r) &&
+        packet.ReadU8(this->background_color.g) &&
+        packet.ReadU8(this->background_color.b) &&
+        packet.ReadU8(this->background_color.a) &&
+        packet.ReadF32(this->size.x) &&
+        packet.ReadF32(this->size.y) &&
+        DeserializeEntities(this->entities, packet);
+}
 
-            return true;
-        };
-
-    this->command_callbacks[GameCommand::Type::SPAWN_PROJECTILE] =
-        [](ClientGameState &state, const CommandContext &context, GameCommand &command) {
-            auto &spawn_projectile = static_cast<SpawnProjectileCommand &>(command);
-            auto projectile = CreateEntity(state.entities, EntityPrefabId::PROJECTILE, Entity{spawn_projectile.target});
-            state.entities.Get<CPosition>(projectile).value = spawn_projectile.position;
-            state.entities.Get<CVelocity>(projectile).value = spawn_projectile.velocity;
-            state.entities.Get<CMass>(projectile).value = g_weapons[static_cast<size_t>(spawn_projectile.weapon_type)].projectile_mass;
-            state.entities.Get<CProjectile>(projectile).firing_entity = Entity{spawn_projectile.firing_entity};
-            //log_debug("client_game_state", "Spawn projectile");
-            return true;
-        };
+bool ClientGameState::OnCommand(const CommandContext &context, MoveTankCommand &move_tank) {
+    auto entity = Entity{move_tank.entity};
+    auto &planet_position = this->entities.Get<CPlanetPosition>(entity);
+    planet_position.value = move_tank.planet_position;
+    planet_position.delta = move_tank.velocity;
+    return true;
+}
 
-    this->command_callbacks[GameCommand::Type::DESTROY_ENTITY] =
-        [](ClientGameState &state, const CommandContext &context, GameCommand &command) {
-            auto &destroy_entity = static_cast<DestroyEntityCommand &>(command);
+bool ClientGameState::OnCommand(const CommandContext &context, RotateTurretCommand &rotate_turret) {
+    this->entities.Get<CTank>(Entity{rotate_turret.entity}).target_turret_rotation = rotate_turret.target_rotation;
+    return true;
+}
 
-            //log_debug("client_game_state", "Destroy entity {}"_format(destroy_entity.target));
-            // TODO(janh): I don't know what's going wrong here, but entt sometimes complains about the entity not being valid.
-            // This if-condition is just a hack and probably leads to orphaned entities.
-            if (state.entities.IsValid(Entity{destroy_entity.target})) {
-                state.entities.Destroy(Entity{destroy_entity.target});
-            }
+bool ClientGameState::OnCommand(const CommandContext &context, ChargeCommand &charge_command) {
+    auto player_tank = this->my_tank.value();
+    if (player_tank != Entity{charge_command.entity}) {
+        return false;
+    }
 
+    auto charging = this->entities.TryGet<CCharging>(player_tank);
+    if (charge_command.fire) {
+        if (charging == nullptr) {
+            // Was not charging
+            return false;
+        } else {
+            this->entities.Remove<CCharging>(player_tank);
+        }
+    } else {
+        if (charging == nullptr) {
+            // Charge
+            this->entities.Add<CCharging>(player_tank).start_time = this->time;
             return true;
-        };
-
-    this->command_callbacks[GameCommand::Type::SET_HEALTH] =
-        [](ClientGameState &state, const CommandContext &context, GameCommand &command) {
-            auto &set_health = static_cast<SetHealthCommand &>(command);
-            auto &health = state.entities.Get<CHealth>(Entity{set_health.target});
-            health.value = set_health.health;
-            health.max = set_health.max;
-            return true;
-        };
+        } else {
+            // Was already charging
+            charging->start_time = this->time;
+            return false;
+        }
+    }
+
+    return true;
+}
 
-    this->command_callbacks[GameCommand::Type::PLAY_SFX] =
-        [](ClientGameState &state, const CommandContext &context, GameCommand &command) {
-            auto &play_sfx = static_cast<PlaySfxCommand &>(command);
+bool ClientGameState::OnCommand(const CommandContext &context, SpawnProjectileCommand &spawn_projectile) {
+    auto projectile = CreateEntity(this->entities, EntityPrefabId::PROJECTILE, Entity{spawn_projectile.target});
+    this->entities.Get<CPosition>(projectile).value = spawn_projectile.position;
+    this->entities.Get<CVelocity>(projectile).value = spawn_projectile.velocity;
+    this->entities.Get<CMass>(projectile).value = g_weapons[static_cast<size_t>(spawn_projectile.weapon_type)].projectile_mass;
+    this->entities.Get<CProjectile>(projectile).firing_entity = Entity{spawn_projectile.firing_entity};
+    this->entities.Get<CProjectile>(projectile).weapon_type = spawn_projectile.weapon_type;
+    //log_debug("client_game_state", "Spawn projectile");
+    return true;
+}
+
+bool ClientGameState::OnCommand(const CommandContext &context, SpawnTankCommand &spawn_tank) {
+    auto tank_entity = CreateEntity(this->entities, EntityPrefabId::TANK, Entity{spawn_tank.target});
+    auto &tank = this->entities.Get<CTank>(tank_entity);
+    tank.planet_id = Entity{spawn_tank.planet};
+    tank.turret_rotation = spawn_tank.turret_rotation;
+    tank.target_turret_rotation = spawn_tank.target_turret_rotation;
+    tank.flags = spawn_tank.flags;
+    tank.fuel = spawn_tank.fuel;
+    tank.weapon_type = spawn_tank.weapon_type;
+    auto &planet_position = this->entities.Get<CPlanetPosition>(tank_entity);
+    planet_position.value = spawn_tank.planet_position;
+    planet_position.delta = spawn_tank.velocity;
+    auto &health = this->entities.Get<CHealth>(tank_entity);
+    health.value = spawn_tank.health;
+    health.max = spawn_tank.max_health;
+    return true;
+}
 
-            auto &client = GetClient();
+bool ClientGameState::OnCommand(const CommandContext &context, DestroyEntityCommand &destroy_entity) {
+    //log_debug("client_game_state", "Destroy entity {}"_format(destroy_entity.target));
+    // TODO(janh): I don't know what's going wrong here, but entt sometimes complains about the entity not being valid.
+    // This if-condition is just a hack and probably leads to orphaned entities.
+    if (this->entities.IsValid(Entity{destroy_entity.target})) {
+        this->entities.Destroy(Entity{destroy_entity.target});
+    }
 
-            switch (play_sfx.sfx) {
-                case PlaySfxCommand::Sfx::TANK_EXPLOSION:
-                    client.PlaySample(client.assets.sounds.tank_explode);
-                    return true;
+    return true;
+}
 
-                case PlaySfxCommand::Sfx::TANK_FIRE:
-                    client.PlaySample(client.assets.sounds.tank_fire);
-                    return true;
+bool ClientGameState::OnCommand(const CommandContext &context, SetHealthCommand &set_health) {
+    auto &health = this->entities.Get<CHealth>(Entity{set_health.target});
+    health.value = set_health.health;
+    health.max = set_health.max;
+    return true;
+}
 
-                default:
-                    return false;
-            }
-        };
+bool ClientGameState::OnCommand(const CommandContext &context, PlaySfxCommand &play_sfx) {
+#if HEADLESS
+    return play_sfx.sfx == PlaySfxCommand::Sfx::TANK_EXPLOSION || play_sfx.sfx == PlaySfxCommand::Sfx::TANK_FIRE;
+#else
+    auto &client = GetClient();
 
-    this->command_callbacks[GameCommand::Type::SET_POSITION] =
-        [](ClientGameState &state, const CommandContext &context, GameCommand &command) {
-            auto &set_position = static_cast<SetPositionCommand &>(command);
-            auto &position = state.entities.Get<CPosition>(Entity{set_position.target});
-            position.value = set_position.position;
+    switch (play_sfx.sfx) {
+        case PlaySfxCommand::Sfx::TANK_EXPLOSION:
+            client.PlaySample(client.assets.sounds.tank_explode);
             return true;
-        };
 
-    this->command_callbacks[GameCommand::Type::SWITCH_WEAPON] =
-        [](ClientGameState &state, const CommandContext &context, GameCommand &command) {
-            auto &switch_weapon = static_cast<SwitchWeaponCommand &>(command);
-            auto &tank = state.entities.Get<CTank>(state.my_tank.value());
-            tank.weapon_type = switch_weapon.weapon_type;
+        case PlaySfxCommand::Sfx::TANK_FIRE:
+            client.PlaySample(client.assets.sounds.tank_fire);
             return true;
-        };
+
+        default:
+            return false;
+    }
+#endif
 }
 
-bool ClientGameState::Deserialize(Packet &packet) {
-    return
-        packet.ReadU8(this->background_color.r) &&
-        packet.ReadU8(this->background_color.g) &&
-        packet.ReadU8(this->background_color.b) &&
-        packet.ReadU8(this->background_color.a) &&
-        packet.ReadF32(this->size.x) &&
-        packet.ReadF32(this->size.y) &&
-        DeserializeEntities(this->entities, packet);
+bool ClientGameState::OnCommand(const CommandContext &context, SetPositionCommand &set_position) {
+    auto &position = this->entities.Get<CPosition>(Entity{set_position.target});
+    position.value = set_position.position;
+    return true;
 }
 
-bool ClientGameState::HandleCommand(const CommandContext &context, GameCommand &command) {
-    auto it = this->command_callbacks.find(command.type);
-    if (it == this->command_callbacks.end()) {
+bool ClientGameState::OnCommand(const CommandContext &context, SwitchWeaponCommand &switch_weapon) {
+    auto &tank = this->entities.Get<CTank>(this->my_tank.value());
+    tank.weapon_type = switch_weapon.weapon_type;
+    return true;
+}
+
+bool ClientGameState::OnCommand(const CommandContext &context, FireVolleyCommand &fire_volley) {
+    if (static_cast<u32>(fire_volley.weapon_type) >= static_cast<u32>(Weapon::Type::COUNT)) {
         return false;
     }
 
-    return it->second(*this, context, command);;
+    this->SpawnVolley(fire_volley);
+
+#if !HEADLESS
+    auto &client = GetClient();
+    client.PlaySample(client.assets.sounds.tank_fire);
+#endif
+
+    return true;
+}
+
+Vec2 ClientGameState::GetViewSize() const {
+#if HEADLESS
+    return headless_view_size;
+#else
+    return GetGraphicsManager().GetWindowSize();
+#endif
 }
 
 void ClientGameState::DestroyEntity(Entity entity) {
@@ -157,7 +179,6 @@ void ClientGameState::DestroyEntity(Entity entity) {
 void ClientGameState::Clone(ClientGameState &target) const {
     this->GameState::Clone(target);
     target.cam = this->cam;
-    target.command_callbacks = this->command_callbacks;
     target.my_tank = this->my_tank;
     target.is_pause_menu_open = this->is_pause_menu_open;
 }
@@ -166,13 +187,13 @@ void ClientGameState::SimulateProjectileMovement(Vec2 direction, f32 charge, Arr
     ClientGameState alternative_reality;
     this->Clone(alternative_reality);
 
-    auto projectiles = alternative_reality.Fire(this->my_tank.value(), true);
+    auto volley = alternative_reality.Fire(this->my_tank.value(), true);
 
-    if (projectiles.size() != 1) {
+    if (!volley.has_value() || g_weapons[static_cast<size_t>(volley.value().weapon_type)].burst != 1) {
         return;
     }
 
-    auto projectile = projectiles[0];
+    auto projectile = Entity{volley.value().first_projectile};
     for (size_t i = 0; i < num_ticks; ++i) {
         alternative_reality.Tick(1.0f);
         auto position_after_tick = alternative_reality.entities.Get<CPosition>(projectile).value;
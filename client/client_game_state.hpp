@@ -1,25 +1,62 @@
 #include "common/game_state.hpp"
+#include "common/player_input.hpp"
+#include "common/net_msg.hpp"
 
 #include "client/graphics/camera.hpp"
+#include "client/input_latency.hpp"
 
 union SDL_Event;
 
 struct ClientGameState : public GameState {
-    using CommandCallback = bool(ClientGameState &, const CommandContext &, GameCommand &);
-    using CommandCallbackMap = HashMap<GameCommand::Type, CommandCallback *>;
-
-    ClientGameState();
     bool Deserialize(Packet &packet);
+#if !HEADLESS
     bool HandleInput(Entity controlled_entity, const SDL_Event &event);
-    bool HandleCommand(const CommandContext &context, GameCommand &command) final;
+#endif
+    void SendInput();
+    void AcknowledgeInput(u32 sequence);
+
+    inline bool HandleCommandPacket(const CommandContext &context, Packet &packet) {
+        return DispatchCommandPacket(*this, context, packet);
+    }
+
+    // Commands from the server. Types without an OnCommand overload are rejected.
+    template<typename Command>
+    bool HandleCommand(const CommandContext &context, Command &command) {
+        if constexpr (HandlesCommand<ClientGameState, Command>) {
+            return this->OnCommand(context, command);
+        } else {
+            return false;
+        }
+    }
+
+    bool OnCommand(const CommandContext &context, MoveTankCommand &move_tank);
+    bool OnCommand(const CommandContext &context, RotateTurretCommand &rotate_turret);
+    bool OnCommand(const CommandContext &context, ChargeCommand &charge_command);
+    bool OnCommand(const CommandContext &context, SpawnProjectileCommand &spawn_projectile);
+    bool OnCommand(const CommandContext &context, SpawnTankCommand &spawn_tank);
+    bool OnCommand(const CommandContext &context, DestroyEntityCommand &destroy_entity);
+    bool OnCommand(const CommandContext &context, SetHealthCommand &set_health);
+    bool OnCommand(const CommandContext &context, PlaySfxCommand &play_sfx);
+    bool OnCommand(const CommandContext &context, SetPositionCommand &set_position);
+    bool OnCommand(const CommandContext &context, SwitchWeaponCommand &switch_weapon);
+    bool OnCommand(const CommandContext &context, FireVolleyCommand &fire_volley);
+
+#if !HEADLESS
     void Render();
+#endif
+    Vec2 GetViewSize() const;
     void DestroyEntity(Entity entity) final;
     void Clone(ClientGameState &target) const;
     void SimulateProjectileMovement(Vec2 direction, f32 charge, Array<Vec2> &output, size_t num_ticks) const;
 
     Camera cam;
-    CommandCallbackMap command_callbacks;
     Optional<Entity> my_tank;
     bool is_pause_menu_open = false;
     bool is_camera_locked = false;
+    PlayerInput input; // Updated by HandleInput, sent once per tick by SendInput
+    PlayerInput last_sent_input;
+    Array<PlayerInput> unacked_inputs;
+    u32 next_input_sequence = 1;
+    Optional<InputLatencyTracer::Clock::time_point> input_changed_at; // First change since the last bundle, see InputLatencyTracer
+    Optional<TimeEcho> pending_echo; // Server timestamp to echo back with the next input bundle or pong
 };
@@ -13,9 +13,13 @@ struct PlayerInfo;
 struct ClientState {
     virtual void Begin() = 0;
     virtual void End() = 0;
+#if !HEADLESS
     virtual void Input(const SDL_Event &event) = 0;
+#endif
     virtual void Tick(f32 dt) = 0;
+#if !HEADLESS
     virtual void Render() = 0;
+#endif
     virtual StringView GetDisplayName() const = 0;
 
     NetMessageHandlerMap net_message_handlers;
@@ -25,8 +29,8 @@ namespace client_states {
 
 UniquePtr<ClientState> MakeMenu();
 UniquePtr<ClientState> MakeOptions();
-UniquePtr<ClientState> MakeConnecting(Optional<StringView> ip = std::nullopt);
-UniquePtr<ClientState> MakeHandshake();
+UniquePtr<ClientState> MakeConnecting(Optional<StringView> ip = std::nullopt, Optional<HandshakeRequest::FastJoin> fast_join = std::nullopt);
+UniquePtr<ClientState> MakeHandshake(Optional<HandshakeRequest::FastJoin> fast_join = std::nullopt);
 UniquePtr<ClientState> MakeSessionbrowser(bool show_error_message = false);
 UniquePtr<ClientState> MakeCreateSession();
 UniquePtr<ClientState> MakeLobby(Array<PlayerInfo> connected_players);
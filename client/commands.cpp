@@ -1,8 +1,11 @@
 #include "client/client.hpp"
-#include "client/console.hpp"
 #include "client/config/config.hpp"
 #include "common/command_manager.hpp"
 
+#if !HEADLESS
+#include "client/console.hpp"
+#endif
+
 void RegisterClientCommands() {
     auto &command_manager = GetCommandManager();
 
@@ -12,25 +15,83 @@ void RegisterClientCommands() {
             GetClient().Quit();
         });
 
+#if !HEADLESS
     command_manager.RegisterCommand(
         "cls",
         [](const Array<String> &args) {
             GetConsole().SetVisible(false);
         });
 
+    command_manager.RegisterCommand(
+        "net_graph",
+        [](const Array<String> &args) {
+            GetClient().net_graph.Toggle();
+        });
+#endif
+
     command_manager.RegisterCommand(
         "connect",
         [](const Array<String> &args) {
             auto print_help = []() {
-                LogError("connect command", "usage: connect <ip>");
+                LogError("connect command", "usage: connect <ip>[:<port>] [<session id>|any]");
             };
 
             String ip;
 
             if (!GetArg(args, 0, ip)) {
                 print_help();
+                return;
+            }
+
+            // With a session the lobby is joined along with the handshake, skipping the session browser
+            Optional<HandshakeRequest::FastJoin> fast_join;
+            String session;
+
+            if (GetArg(args, 1, session)) {
+                auto &join = fast_join.emplace();
+                join.player_name = GetConfig().values.player_name;
+
+                if (session != "any" && !GetArg(args, 1, join.session_id)) {
+                    print_help();
+                    return;
+                }
+            }
+
+            GetClient().SetNextState(client_states::MakeConnecting(ip, ToRvalue(fast_join)));
+        });
+
+    command_manager.RegisterCommand(
+        "trace",
+        [](const Array<String> &args) {
+            String filename;
+
+            if (!GetArg(args, 0, filename)) {
+                LogError("trace command", "usage: trace <file> | trace off");
+            } else if (filename == "off") {
+                StopNetTrace(GetClient().net_trace);
+            } else {
+                StartNetTrace(GetClient().net_trace, filename, NetTraceRole::RECORDED_BY_CLIENT);
+            }
+        });
+
+    command_manager.RegisterCommand(
+        "latency_trace",
+        [](const Array<String> &args) {
+            String mode;
+            auto &tracer = GetClient().input_latency;
+
+            if (!GetArg(args, 0, mode)) {
+                LogError("latency_trace command", "usage: latency_trace on | latency_trace off | latency_trace report");
+            } else if (mode == "on") {
+                tracer.SetEnabled(true);
+                LogInfo("latency_trace command", "Tracing the input latency");
+            } else if (mode == "off") {
+                tracer.Report();
+                tracer.SetEnabled(false);
+            } else if (mode == "report") {
+                tracer.Report();
             } else {
-                GetClient().SetNextState(client_states::MakeConnecting(ip));
+                LogError("latency_trace command", "usage: latency_trace on | latency_trace off | latency_trace report");
             }
         });
 
@@ -74,4 +135,15 @@ void RegisterClientCommands() {
             }
         });
 
+    command_manager.RegisterCommand(
+        "netstats",
+        [](const Array<String> &args) {
+            const auto &net_io = GetClient().net_io;
+            auto stats = net_io.GetStats();
+            LogNetTrafficStats("client", stats.traffic);
+            LogInfo("net_stats", "scope=client send_queue={} compression_ratio={:.2f} chunks_received={}"_format(
+                net_io.GetSendQueueSize(),
+                stats.GetCompressionRatio(),
+                stats.chunks_received));
+        });
 }
@@ -1,20 +1,25 @@
 #include "client/config/config.hpp"
 
-#include "client/graphics/graphics_manager.hpp"
 #include <filesystem>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+
+#if !HEADLESS
+#include "client/graphics/graphics_manager.hpp"
 #include <SDL.h>
+#endif
 
 constexpr StringView file_path = "config.json";
 
+#if !HEADLESS
 inline bool operator ==(const SDL_DisplayMode& lhs, const SDL_DisplayMode& rhs) {
     return
         lhs.h == rhs.h &&
         lhs.w == rhs.w &&
         lhs.refresh_rate == rhs.refresh_rate;
 }
+#endif
 
 static void SaveJsonFile(const nlohmann::json& json, StringView file_path) {
     std::ofstream ofs{file_path.data()};
@@ -32,6 +37,7 @@ static void SaveJsonFile(const nlohmann::json& json, StringView file_path) {
     return !ifs.fail();
 }
 
+#if !HEADLESS
 void to_json(nlohmann::json& json, const SDL_DisplayMode& mode) {
     json = {
         {"width", mode.w},
@@ -64,9 +70,13 @@ static Optional<int> FindDisplayModeIndex(const SDL_DisplayMode &mode) {
 
     return std::nullopt;
 }
+#endif
 
 void Config::Serialize() {
+    // The headless client does not know the display, it keeps the resolution the file has if any
+#if !HEADLESS
     this->storage["resolution"] = this->GetDisplayMode();
+#endif
     this->storage["window_mode"] = static_cast<int>(this->values.window_mode);
     this->storage["limit_fps"] = this->values.limit_fps;
     this->storage["player_name"] = this->values.player_name;
@@ -75,13 +85,16 @@ void Config::Serialize() {
 }
 
 void Config::Deserialize() {
-    auto mode = this->storage.at("resolution").get<SDL_DisplayMode>();
-
-    if (auto dmi = FindDisplayModeIndex(mode); dmi.has_value()) {
+#if !HEADLESS
+    // A config that the headless client wrote without a window has no resolution
+    if (!this->storage.contains("resolution")) {
+        this->values.display_mode_index = 0;
+    } else if (auto dmi = FindDisplayModeIndex(this->storage.at("resolution").get<SDL_DisplayMode>()); dmi.has_value()) {
         this->values.display_mode_index = dmi.value();
     } else {
         FAIL("Could not find a suitable display mode");
     }
+#endif
 
     this->values.window_mode = static_cast<WindowMode>(this->storage.at("window_mode").get<int>());
     this->values.limit_fps = this->storage.at("limit_fps");
@@ -110,6 +123,7 @@ void Config::Load() {
     this->Deserialize();
 }
 
+#if !HEADLESS
 void Config::ApplyWindowSettings() {
     auto mode = this->GetDisplayMode();
     auto win = GetGraphicsManager().win;
@@ -146,6 +160,7 @@ SDL_DisplayMode Config::GetDisplayMode() const {
     SDL_GetDisplayMode(Config::DEFAULT_DISPLAY_INDEX, this->values.display_mode_index, &mode);
     return mode;
 }
+#endif
 
 Config &GetConfig() {
     static Config res;
@@ -1,9 +1,12 @@
 #pragma once
 
 #include "common/common.hpp"
-#include "SDL.h"
 #include "json.hpp"
 
+#if !HEADLESS
+#include "SDL.h"
+#endif
+
 struct Client;
 
 struct Config {
@@ -19,8 +22,10 @@ struct Config {
     void Deserialize();
     void Save();
     void Load();
+#if !HEADLESS
     void ApplyWindowSettings();
     SDL_DisplayMode GetDisplayMode() const;
+#endif
 
     struct {
         int display_mode_index;
@@ -59,11 +59,12 @@ void Console::PrintLine(StringView text, Color color) {
         .end = static_cast<i32>(text.size()),
         .color = color,
         });
-    this->lines.emplace_back(text, ToRvalue(ranges));
+    this->PrintLine(text, ToRvalue(ranges));
 }
 
 void Console::PrintLine(StringView text, Array<FancyTextRange> &&ranges) {
-    this->lines.emplace_back(text, ToRvalue(ranges));
+    std::lock_guard lock{this->pending_mutex};
+    this->pending_lines.emplace_back(text, ToRvalue(ranges));
 }
 
 bool Console::HandleInput(const SDL_Event &event) {
@@ -248,6 +249,12 @@ bool Console::HandleInput(const SDL_Event &event) {
 }
 
 void Console::Tick(f32 dt) {
+    {
+        std::lock_guard lock{this->pending_mutex};
+        std::move(this->pending_lines.begin(), this->pending_lines.end(), std::back_inserter(this->lines));
+        this->pending_lines.clear();
+    }
+
     auto now = chrono::high_resolution_clock::now();
     if (now > this->last_cursor_toggle + 500ms) {
         this->SetCursorVisible(!this->cursor_visible);
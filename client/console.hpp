@@ -3,6 +3,8 @@
 #include "common/common.hpp"
 #include "client/graphics/text.hpp"
 
+#include <mutex>
+
 union SDL_Event;
 
 struct ConsoleLine {
@@ -59,6 +61,8 @@ struct Console {
     f32 current_height = 0.0f; // Animate
     Vec2 cursor_position{}; // Animated | remove
     Array<ConsoleLine> lines;
+    std::mutex pending_mutex;
+    Array<ConsoleLine> pending_lines; // Guarded by pending_mutex, the network thread logs too. Moved to lines in Tick
     Array<String> history;
     i32 history_offset = 0;
     String current_input; // remove
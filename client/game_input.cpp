@@ -1,8 +1,11 @@
 #include "client/client_game_state.hpp"
 
 #include "client/client.hpp"
-#include "client/graphics/graphics_manager.hpp"
 #include "common/log.hpp"
+#include "common/net_msg.hpp"
+
+#if !HEADLESS
+#include "client/graphics/graphics_manager.hpp"
 
 #include <nuklear.h>
 #include <SDL.h>
@@ -16,46 +19,27 @@ bool ClientGameState::HandleInput(Entity controlled_entity, const SDL_Event &eve
         case SDL_KEYDOWN: {
             switch (event.key.keysym.sym) {
                 case SDLK_d: {
-                    MoveTankCommand move_tank;
-                    move_tank.entity = entt::to_integral(controlled_entity);
-                    move_tank.velocity = -0.5f;
-                    GetClient().SendGameCommand(move_tank);
+                    this->input.move = -1;
                     return true;
                 } break;
 
                 case SDLK_a: {
-                    MoveTankCommand move_tank;
-                    move_tank.entity = entt::to_integral(controlled_entity);
-                    move_tank.velocity = 0.5f;
-                    GetClient().SendGameCommand(move_tank);
+                    this->input.move = 1;
                     return true;
                 } break;
 
                 case SDLK_q: {
-                    RotateTurretCommand rotate_turret;
-                    rotate_turret.is_absolute = false;
-                    rotate_turret.entity = entt::to_integral(controlled_entity);
-                    rotate_turret.flags = CTank::ROTATE_TURRET_LEFT;
-                    GetClient().SendGameCommand(rotate_turret);
+                    this->input.turret_flags = PlayerInput::ROTATE_TURRET_LEFT;
                     return true;
                 } break;
 
                 case SDLK_e: {
-                    RotateTurretCommand rotate_turret;
-                    rotate_turret.is_absolute = false;
-                    rotate_turret.entity = entt::to_integral(controlled_entity);
-                    rotate_turret.flags = CTank::ROTATE_TURRET_RIGHT;
-                    GetClient().SendGameCommand(rotate_turret);
+                    this->input.turret_flags = PlayerInput::ROTATE_TURRET_RIGHT;
                     return true;
                 } break;
 
                 case SDLK_TAB: {
-                    auto &tank = this->entities.Get<CTank>(controlled_entity);
-                    SwitchWeaponCommand switch_weapon;
-                    switch_weapon.weapon_type =
-                        static_cast<Weapon::Type>(
-                            (static_cast<size_t>(tank.weapon_type) + 1) % static_cast<size_t>(Weapon::Type::COUNT));
-                    GetClient().SendGameCommand(switch_weapon);
+                    this->input.weapon = (this->input.weapon + 1) % static_cast<u8>(Weapon::Type::COUNT);
                     return true;
                 } break;
 
@@ -102,30 +86,30 @@ bool ClientGameState::HandleInput(Entity controlled_entity, const SDL_Event &eve
         case SDL_KEYUP: {
             if (event.key.keysym.sym == SDLK_d || event.key.keysym.sym == SDLK_a) {
                 // Stop the tank
-                MoveTankCommand move_tank;
-                move_tank.entity = entt::to_integral(controlled_entity);
-                move_tank.velocity = 0.0f;
-                GetClient().SendGameCommand(move_tank);
+                this->input.move = 0;
                 return true;
             }
         } break;
 
         case SDL_MOUSEBUTTONDOWN: {
             if (event.button.button == SDL_BUTTON_LEFT) {
-                ChargeCommand charge;
-                charge.entity = entt::to_integral(controlled_entity);
-                charge.fire = false;
-                GetClient().SendGameCommand(charge);
+                // Do not lose a click that was released within the same tick
+                if (this->input.fire != this->last_sent_input.fire) {
+                    this->SendInput();
+                }
+
+                this->input.fire = true;
                 return true;
             }
         } break;
 
         case SDL_MOUSEBUTTONUP: {
             if (event.button.button == SDL_BUTTON_LEFT) {
-                ChargeCommand charge;
-                charge.entity = entt::to_integral(controlled_entity);
-                charge.fire = true;
-                GetClient().SendGameCommand(charge);
+                if (this->input.fire != this->last_sent_input.fire) {
+                    this->SendInput();
+                }
+
+                this->input.fire = false;
                 return true;
             }
         } break;
@@ -136,11 +120,7 @@ bool ClientGameState::HandleInput(Entity controlled_entity, const SDL_Event &eve
             auto direction = glm::normalize(Vec2{mouse_world} - tank_position);
             auto angle = std::fmod(glm::degrees(std::atan2(direction.x, direction.y)) + 360.0f, 360.0f);
 
-            RotateTurretCommand rotate_turret;
-            rotate_turret.is_absolute = true;
-            rotate_turret.entity = entt::to_integral(controlled_entity);
-            rotate_turret.target_rotation = angle;
-            GetClient().SendGameCommand(rotate_turret);
+            this->input.target_turret_rotation = angle;
             return true;
         } break;
 
@@ -162,3 +142,46 @@ bool ClientGameState::HandleInput(Entity controlled_entity, const SDL_Event &eve
 
     return false;
 }
+#endif
+
+void ClientGameState::SendInput() {
+    if (this->input.HasSameState(this->last_sent_input)) {
+        this->input_changed_at.reset();
+        return;
+    }
+
+    this->input.sequence = this->next_input_sequence++;
+    this->last_sent_input = this->input;
+    this->unacked_inputs.emplace_back(this->input);
+
+    // Older inputs would not be repeated anyway
+    if (this->unacked_inputs.size() > InputBundleMessage::max_inputs) {
+        this->unacked_inputs.erase(this->unacked_inputs.begin());
+    }
+
+    auto &client = GetClient();
+
+    InputBundleMessage bundle;
+    bundle.inputs = this->unacked_inputs;
+    bundle.trace_latency = client.input_latency.enabled;
+
+    if (this->pending_echo.has_value()) {
+        bundle.echo = this->pending_echo.value();
+        bundle.echo->hold_time = this->time - bundle.echo->client_time;
+        this->pending_echo.reset();
+    }
+
+    client.Send(bundle);
+
+    // Inputs that did not come from an event (e.g. the headless driver) count as changed right now
+    auto changed_at = this->input_changed_at.value_or(InputLatencyTracer::Clock::now());
+    client.input_latency.OnInputPushed(this->input.sequence, changed_at, client.net_io);
+    this->input_changed_at.reset();
+}
+
+void ClientGameState::AcknowledgeInput(u32 sequence) {
+    std::erase_if(this->unacked_inputs,
+        [&](const PlayerInput &input) {
+            return input.sequence <= sequence;
+        });
+}
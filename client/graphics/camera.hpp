@@ -1,7 +1,10 @@
 #pragma once
 
 #include "common/common.hpp"
+
+#if !HEADLESS
 #include "client/graphics/glad.h"
+#endif
 
 struct Camera {
     Vec2 position{};
@@ -15,6 +15,7 @@
 #include "client/config/config.hpp"
 #include "client/graphics/graphics_manager.hpp"
 #include "client/client_game_state.hpp"
+#include "client/session_list.hpp"
 #include "server/session.hpp"
 #include "common/log.hpp"
 
@@ -230,21 +231,46 @@ void MainMenu::Show() {
 void SessionBrowserMenu::Show() {
     auto &client = GetClient();
     auto ctx = client.gui.ctx;
-    this->password_buffers.resize(this->session_infos->size());
+    auto &list = *this->session_list;
+    this->password_buffers.resize(list.sessions.size());
 
     if (nk_begin(ctx, "Sessionbrowser", nk_rect(0.2f * ctx->w, 0.1f * ctx->h, 0.6f * ctx->w, 0.8f * ctx->h), NK_WINDOW_BACKGROUND | NK_WINDOW_BORDER | NK_WINDOW_NO_SCROLLBAR | NK_WINDOW_TITLE)) {
         float ratio[] = { 0.3f, 0.1f, 0.2f, 0.3f, 0.1f };
 
+        // Filters, the server applies them so only the page that is shown is transferred
+        nk_layout_row_dynamic(ctx, 30, 4);
+        nk_edit_string_zero_terminated(ctx, NK_EDIT_FIELD, this->name_filter_buffer.data(), this->name_filter_buffer.size() - 1, nk_filter_default);
+
+        auto filter_flags = list.filter.flags;
+        int hide_full = (filter_flags & SessionFilter::NOT_FULL) != 0;
+        int hide_locked = (filter_flags & SessionFilter::NO_PASSWORD) != 0;
+        int hide_ingame = (filter_flags & SessionFilter::LOBBY_ONLY) != 0;
+        nk_checkbox_label(ctx, "Hide full", &hide_full);
+        nk_checkbox_label(ctx, "Hide locked", &hide_locked);
+        nk_checkbox_label(ctx, "Hide running", &hide_ingame);
+
+        filter_flags =
+            (hide_full ? SessionFilter::NOT_FULL : 0) |
+            (hide_locked ? SessionFilter::NO_PASSWORD : 0) |
+            (hide_ingame ? SessionFilter::LOBBY_ONLY : 0);
+
+        if (filter_flags != list.filter.flags || list.filter.name_prefix != this->name_filter_buffer.data()) {
+            list.filter.flags = filter_flags;
+            list.filter.name_prefix = this->name_filter_buffer.data();
+            list.first = 0;
+            list.Request();
+        }
+
         nk_layout_row(ctx, NK_DYNAMIC, 30, 5, ratio);
         nk_label(ctx, "Name", NK_TEXT_LEFT);
         nk_label(ctx, "Players", NK_TEXT_LEFT);
         nk_label(ctx, "Status", NK_TEXT_LEFT);
         nk_label(ctx, "Password", NK_TEXT_LEFT);
 
-        for (size_t i = 0; i < this->session_infos->size(); ++i) {
+        for (size_t i = 0; i < list.sessions.size(); ++i) {
             int dummy;
 
-            auto& info = this->session_infos->at(i);
+            auto& info = list.sessions.at(i);
             char nplayers[16];
             snprintf(nplayers, sizeof(nplayers), "%d/%d", (int)info.nplayers_connected, (int)info.nplayers);
             nk_layout_row(ctx, NK_DYNAMIC, 30, 5, ratio);
@@ -275,17 +301,26 @@ void SessionBrowserMenu::Show() {
         nk_layout_space_push(ctx, local_space);
 
         if (nk_group_begin(ctx, "Nav", NK_WINDOW_BORDER | NK_WINDOW_NO_SCROLLBAR)) {
-            nk_layout_row_dynamic(ctx, bounds.h * 0.08f, 3);
+            nk_layout_row_dynamic(ctx, bounds.h * 0.08f, 6);
 
             if (sound_button_label(ctx, "Back")) {
                 client.SetNextState(client_states::MakeMenu());
             }
 
-            if (sound_button_label(ctx, "Reload")) {
-                this->session_infos->clear();
+            if (sound_button_label(ctx, "<")) {
+                list.PreviousPage();
+            }
 
-                GetSessionInfoRequest request;
-                client.Send(request);
+            char page[32];
+            snprintf(page, sizeof(page), "%d/%d", list.first / SessionList::page_size + 1, (int)list.GetNumPages());
+            nk_label(ctx, page, NK_TEXT_CENTERED);
+
+            if (sound_button_label(ctx, ">")) {
+                list.NextPage();
+            }
+
+            if (sound_button_label(ctx, "Reload")) {
+                list.Request();
             }
             if (sound_button_label(ctx, "Create Session")) {
                 client.SetNextState(client_states::MakeCreateSession());
@@ -5,7 +5,7 @@
 
 struct nk_context;
 struct Client;
-struct SessionInfo;
+struct SessionList;
 struct ClientGameState;
 union SDL_Event;
 
@@ -16,8 +16,9 @@ struct MainMenu {
 struct SessionBrowserMenu {
     void Show();
 
-    Array<SessionInfo> *session_infos = nullptr;
+    SessionList *session_list = nullptr;
     Array<std::array<char, 32>> password_buffers;
+    std::array<char, 32> name_filter_buffer{};
 };
 
 struct SessionLobbyMenu {
@@ -0,0 +1,236 @@
+#include "client/headless/driver.hpp"
+
+#include "client/client.hpp"
+#include "client/client_game_state.hpp"
+#include "client/config/config.hpp"
+#include "common/command_manager.hpp"
+#include "client/session_list.hpp"
+#include "common/log.hpp"
+
+#include <fstream>
+#include <sstream>
+
+// Used when no script is given: find a game on this machine and play it until the process is killed
+constexpr StringView default_script =
+    "connect 127.0.0.1\n"
+    "wait_state SessionBrowserState\n"
+    "join_or_create headless 4\n"
+    "ready\n"
+    "wait_state IngameState\n"
+    "bot 0\n";
+
+bool HeadlessDriver::LoadScript(StringView filename) {
+    std::ifstream ifs{String{filename}};
+    if (!ifs.is_open()) {
+        LogError("headless", "Cannot open script {}"_format(filename));
+        return false;
+    }
+
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    this->SetScript(ss.str());
+    return true;
+}
+
+void HeadlessDriver::SetScript(StringView text) {
+    this->script.clear();
+    this->script_position = 0;
+    this->line_ticks = 0;
+
+    std::istringstream iss{String{text}};
+    String line;
+
+    while (std::getline(iss, line)) {
+        std::istringstream line_stream{line};
+        Array<String> args;
+        String arg;
+
+        while (line_stream >> arg) {
+            args.emplace_back(ToRvalue(arg));
+        }
+
+        if (!args.empty() && args.front().front() != '#') {
+            this->script.emplace_back(ToRvalue(args));
+        }
+    }
+}
+
+void HeadlessDriver::Tick() {
+    if (this->release_fire && this->game_state != nullptr) {
+        this->game_state->input.fire = false;
+        this->release_fire = false;
+    }
+
+    if (this->script.empty()) {
+        this->SetScript(default_script);
+    }
+
+    // Run lines until one of them has to wait for something
+    while (this->script_position < this->script.size()) {
+        if (!this->Step(this->script[this->script_position])) {
+            ++this->line_ticks;
+            return;
+        }
+
+        ++this->script_position;
+        this->line_ticks = 0;
+
+        if (this->script_position == this->script.size()) {
+            LogInfo("headless", "Script done");
+        }
+    }
+}
+
+bool HeadlessDriver::Step(const Array<String> &line) {
+    const auto &command = line.front();
+    auto &client = GetClient();
+
+    if (command == "wait") {
+        i32 num_ticks = 0;
+        GetArg(line, 1, num_ticks);
+        return this->line_ticks >= num_ticks;
+    }
+
+    if (command == "wait_state") {
+        String state_name;
+        GetArg(line, 1, state_name);
+        return client.state != nullptr && client.state->GetDisplayName() == state_name;
+    }
+
+    if (command == "join_or_create") {
+        String session_name;
+        i32 num_players = 2;
+        if (!GetArg(line, 1, session_name)) {
+            LogError("headless", "usage: join_or_create <session> [num_players]");
+            return true;
+        }
+
+        GetArg(line, 2, num_players);
+        return this->JoinOrCreateSession(session_name, num_players);
+    }
+
+    if (command == "ready") {
+        if (this->player_info == nullptr) {
+            return false;
+        }
+
+        client.Send(ReadyMessage{});
+        return true;
+    }
+
+    if (command == "move" || command == "aim" || command == "fire" || command == "weapon" || command == "bot") {
+        if (this->game_state == nullptr) {
+            return false;
+        }
+
+        auto &input = this->game_state->input;
+
+        if (command == "move") {
+            i32 move = 0;
+            GetArg(line, 1, move);
+            input.move = static_cast<i8>(std::clamp(move, -1, 1));
+        } else if (command == "aim") {
+            f32 rotation = 0.0f;
+            GetArg(line, 1, rotation);
+            input.target_turret_rotation = rotation;
+        } else if (command == "fire") {
+            // Released in the next tick, after SendInput has seen the press
+            input.fire = true;
+            this->release_fire = true;
+        } else if (command == "weapon") {
+            i32 weapon = 0;
+            GetArg(line, 1, weapon);
+            input.weapon = static_cast<u8>(std::clamp(weapon, 0, static_cast<i32>(Weapon::Type::COUNT) - 1));
+        } else {
+            i32 num_ticks = 0;
+            GetArg(line, 1, num_ticks);
+
+            if (num_ticks > 0 && this->line_ticks >= num_ticks) {
+                input.move = 0;
+                input.fire = false;
+                return true;
+            }
+
+            // Roughly what a player does: change their mind a few times per second
+            if (this->line_ticks % 6 == 0) {
+                this->RandomizeInput();
+            }
+
+            return false;
+        }
+
+        return true;
+    }
+
+    auto args = Array<String>(line.begin() + 1, line.end());
+    GetCommandManager().Dispatch(command, args);
+    return true;
+}
+
+bool HeadlessDriver::JoinOrCreateSession(const String &session_name, i32 num_players) {
+    auto &client = GetClient();
+
+    if (client.state != nullptr && client.state->GetDisplayName() == "LobbyState") {
+        return true;
+    }
+
+    // Not in the session browser (yet) or waiting for the server to create the session
+    if (this->session_list == nullptr) {
+        return false;
+    }
+
+    // Refresh the session list every second and decide half a second after the refresh
+    auto tick_in_second = this->line_ticks % 60;
+
+    if (tick_in_second == 0) {
+        this->session_list->filter.flags = SessionFilter::NOT_FULL | SessionFilter::LOBBY_ONLY;
+        this->session_list->filter.name_prefix = session_name;
+        this->session_list->first = 0;
+        this->session_list->Request();
+        return false;
+    }
+
+    if (tick_in_second != 30) {
+        return false;
+    }
+
+    for (const auto &info : this->session_list->sessions) {
+        if (info.name == session_name && this->session_list->filter.Matches(info)) {
+            JoinSessionRequest request;
+            request.session_id = info.id;
+            request.player_name = GetConfig().values.player_name;
+            request.password = "";
+            client.Send(request);
+            return false;
+        }
+    }
+
+    // The create session state joins the session once the server created it
+    client.SetNextState(client_states::MakeCreateSession());
+
+    CreateSessionRequest request;
+    request.num_players = num_players;
+    request.num_bots = 0;
+    request.name = session_name;
+    request.player_name = GetConfig().values.player_name;
+    client.Send(request);
+    return false;
+}
+
+void HeadlessDriver::RandomizeInput() {
+    std::uniform_int_distribution dist_move{-1, 1};
+    std::uniform_real_distribution dist_rotation{0.0f, 360.0f};
+    std::uniform_real_distribution dist_chance{0.0f, 1.0f};
+
+    auto &input = this->game_state->input;
+    input.move = static_cast<i8>(dist_move(this->rng));
+    input.target_turret_rotation = dist_rotation(this->rng);
+
+    if (dist_chance(this->rng) < 0.3f) {
+        input.fire = !input.fire;
+    }
+
+    if (dist_chance(this->rng) < 0.02f) {
+        input.weapon = (input.weapon + 1) % static_cast<u8>(Weapon::Type::COUNT);
+    }
+}
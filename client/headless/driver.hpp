@@ -0,0 +1,37 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/player_info.hpp"
+
+#include <random>
+
+struct SessionList;
+struct ClientGameState;
+
+// Stands in for the GUI and the keyboard/mouse of the windowed client. Executes a script with one command per line:
+//   wait <ticks>                              Do nothing for the given number of ticks
+//   wait_state <state>                        Wait until the client is in the given state (e.g. IngameState)
+//   join_or_create <session> <num_players>    Join a lobby by name from the session browser or create it if there is none
+//   ready                                     Mark the player as ready in the lobby
+//   move <-1|0|1>, aim <degrees>, fire, weapon <index>
+//   bot <ticks>                               Play with random input for the given number of ticks (0 = forever)
+// Everything else is dispatched to the command manager like console input (connect, netstats, exit, ...).
+struct HeadlessDriver {
+    bool LoadScript(StringView filename);
+    void SetScript(StringView text);
+    void Tick();
+    bool Step(const Array<String> &line);
+    bool JoinOrCreateSession(const String &session_name, i32 num_players);
+    void RandomizeInput();
+
+    Array<Array<String>> script;
+    size_t script_position = 0;
+    i32 line_ticks = 0; // Number of ticks the current line has been running
+    bool release_fire = false;
+    std::mt19937 rng{std::random_device{}()};
+
+    // Set by the client states, just like the pointers of the GUI menus
+    SessionList *session_list = nullptr;
+    Array<PlayerInfo> *player_info = nullptr;
+    ClientGameState *game_state = nullptr;
+};
@@ -0,0 +1,106 @@
+#include "client/input_latency.hpp"
+
+#include "common/log.hpp"
+#include "common/net_msg.hpp"
+#include "client/net_io.hpp"
+
+static f32 GetMilliseconds(InputLatencyTracer::Clock::duration duration) {
+    return chrono::duration<f32, std::milli>{duration}.count();
+}
+
+void InputLatencyTracer::SetEnabled(bool enabled) {
+    this->enabled = enabled;
+    this->samples.clear();
+
+    if (enabled) {
+        this->hops = {};
+        this->num_dropped = 0;
+    }
+}
+
+void InputLatencyTracer::OnInputPushed(u32 sequence, Clock::time_point changed_at, const NetIoThread &net_io) {
+    if (!this->enabled) {
+        return;
+    }
+
+    if (this->samples.size() >= InputLatencyTracer::max_samples) {
+        this->samples.erase(this->samples.begin());
+        ++this->num_dropped;
+    }
+
+    auto &sample = this->samples.emplace_back();
+    sample.sequence = sequence;
+    sample.changed_at = changed_at;
+    sample.pushed_at = Clock::now();
+    sample.packet = net_io.packets_queued;
+}
+
+void InputLatencyTracer::OnInputAcked(u32 sequence, const Optional<InputLatencyTiming> &timing, const NetIoThread &net_io) {
+    if (this->samples.empty()) {
+        return;
+    }
+
+    // The server only reports the timing of the newest input, the older ones it applied in the same tick are left without
+    this->num_dropped += std::erase_if(this->samples,
+        [&](const Sample &sample) {
+            return sample.sequence < sequence && !sample.acked_at.has_value();
+        });
+
+    auto it = std::find_if(this->samples.begin(), this->samples.end(),
+        [&](const Sample &sample) {
+            return sample.sequence == sequence;
+        });
+
+    if (it == this->samples.end()) {
+        return;
+    }
+
+    if (!timing.has_value()) {
+        // The tracing was enabled while the input was on its way
+        this->samples.erase(it);
+        ++this->num_dropped;
+        return;
+    }
+
+    it->acked_at = Clock::now();
+    it->written_at = net_io.GetWriteTime(it->packet);
+    it->server_ms = timing->queued_us / 1000.0f;
+}
+
+void InputLatencyTracer::OnFrameRendered() {
+    if (this->samples.empty() || !this->samples.front().acked_at.has_value()) {
+        return;
+    }
+
+    auto now = Clock::now();
+
+    while (!this->samples.empty() && this->samples.front().acked_at.has_value()) {
+        const auto &sample = this->samples.front();
+        auto written_at = sample.written_at.value_or(sample.pushed_at);
+        auto acked_at = sample.acked_at.value();
+
+        this->hops.input.Add(GetMilliseconds(sample.pushed_at - sample.changed_at));
+        this->hops.send.Add(GetMilliseconds(written_at - sample.pushed_at));
+        this->hops.server.Add(sample.server_ms);
+        this->hops.network.Add(std::max(GetMilliseconds(acked_at - written_at) - sample.server_ms, 0.0f));
+        this->hops.frame.Add(GetMilliseconds(now - acked_at));
+        this->hops.total.Add(GetMilliseconds(now - sample.changed_at));
+
+        this->samples.erase(this->samples.begin());
+    }
+}
+
+void InputLatencyTracer::Report() const {
+    if (this->hops.total.count == 0) {
+        LogInfo("latency", "No traced inputs yet{}"_format(this->enabled ? "" : ", enable the tracing with 'latency_trace on'"));
+        return;
+    }
+
+    LogLatencyHistogram("client", "input", this->hops.input);
+    LogLatencyHistogram("client", "send", this->hops.send);
+    LogLatencyHistogram("client", "server", this->hops.server);
+    LogLatencyHistogram("client", "network", this->hops.network);
+    LogLatencyHistogram("client", "frame", this->hops.frame);
+    LogLatencyHistogram("client", "total", this->hops.total);
+    LogInfo("latency", "scope=client dropped={}"_format(this->num_dropped));
+}
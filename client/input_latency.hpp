@@ -0,0 +1,52 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/net_stats.hpp"
+
+struct NetIoThread;
+struct InputLatencyTiming;
+
+// Follows inputs from the event that changed them until the first frame that shows the
+// server's answer and keeps a histogram per hop:
+//   input:   event -> input bundle pushed by the next tick
+//   send:    pushed -> written to the socket by the network thread
+//   server:  received by the server -> applied by a session tick (from InputLatencyTiming)
+//   network: written -> ack received, minus the server part; includes the server's send delay
+//   frame:   ack received -> first frame rendered after it (the next tick when headless)
+//   total:   event -> frame
+// Only enabled with the latency_trace command, the bundles then ask the server for timings.
+struct InputLatencyTracer {
+    using Clock = chrono::high_resolution_clock;
+
+    constexpr static size_t max_samples = 64; // In flight, older ones are dropped if the acks do not come
+
+    struct Sample {
+        u32 sequence = 0;
+        Clock::time_point changed_at;
+        Clock::time_point pushed_at;
+        Optional<Clock::time_point> written_at;
+        u64 packet = 0; // See NetIoThread::GetWriteTime
+        Optional<Clock::time_point> acked_at;
+        f32 server_ms = 0.0f;
+    };
+
+    struct Hops {
+        LatencyHistogram input;
+        LatencyHistogram send;
+        LatencyHistogram server;
+        LatencyHistogram network;
+        LatencyHistogram frame;
+        LatencyHistogram total;
+    };
+
+    void SetEnabled(bool enabled);
+    void OnInputPushed(u32 sequence, Clock::time_point changed_at, const NetIoThread &net_io);
+    void OnInputAcked(u32 sequence, const Optional<InputLatencyTiming> &timing, const NetIoThread &net_io);
+    void OnFrameRendered();
+    void Report() const;
+
+    bool enabled = false;
+    Array<Sample> samples; // Ordered by sequence
+    Hops hops;
+    u64 num_dropped = 0; // Samples that were never acked with a timing, e.g. collapsed by a newer input
+};
@@ -1,9 +1,34 @@
 #include "client/client.hpp"
+#include "client/config/config.hpp"
 #include "client/graphics/graphics.hpp"
 #include "common/log.hpp"
 
 #include <filesystem>
 
+#if HEADLESS
+// usage: tankgame-cl-headless [--name <player name>] [--script <file>]
+static bool ApplyHeadlessArgs(int argc, char **argv) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        StringView arg = argv[i];
+        StringView value = argv[i + 1];
+
+        if (arg == "--name") {
+            GetConfig().values.player_name = value;
+            GetConfig().Serialize();
+        } else if (arg == "--script") {
+            if (!GetClient().driver.LoadScript(value)) {
+                return false;
+            }
+        } else {
+            LogError("client main", "Unknown argument {}"_format(arg));
+            return false;
+        }
+    }
+
+    return argc % 2 == 1;
+}
+#endif
+
 int main(int argc, char **argv) {
     assert(argc > 0);
 
@@ -25,6 +50,11 @@ int main(int argc, char **argv) {
     if (!client.Init()) {
         LogError("client main", "Failed to initialize");
         res = 1;
+#if HEADLESS
+    } else if (!ApplyHeadlessArgs(argc, argv)) {
+        LogError("client main", "usage: tankgame-cl-headless [--name <player name>] [--script <file>]");
+        res = 1;
+#endif
     } else {
         client.MainLoop();
     }
@@ -0,0 +1,295 @@
+#include "client/net_graph.hpp"
+
+#include "client/client.hpp"
+#include "client/graphics/graphics_manager.hpp"
+#include "client/graphics/vertex_array.hpp"
+#include "common/frame_timer.hpp"
+#include "common/net_msg.hpp"
+#include "client/net_io.hpp"
+
+constexpr f32 bar_width = 1.0f;
+constexpr f32 panel_height = 48.0f;
+constexpr f32 margin = 8.0f;
+
+constexpr Color background_color{0, 0, 0, 150};
+constexpr Color midline_color{255, 255, 255, 60};
+constexpr Color in_color{90, 200, 90, 220};
+constexpr Color out_color{90, 140, 230, 220};
+constexpr Color rtt_color{230, 200, 80, 220};
+constexpr Color best_rtt_color{255, 255, 255, 220};
+constexpr Color slower_color{170, 10, 100, 120}; // The server slowed our ticks down
+constexpr Color faster_color{100, 10, 170, 120};
+
+// Message types are told apart by color in the bytes plot
+constexpr Color type_colors[] = {
+    {90, 200, 90, 220},
+    {230, 120, 60, 220},
+    {200, 90, 200, 220},
+    {80, 200, 220, 220},
+    {230, 220, 90, 220},
+    {230, 80, 80, 220},
+    {150, 150, 150, 220},
+    {120, 110, 240, 220},
+};
+
+static size_t GetDelta(size_t now, size_t last) {
+    // The counters start over with a new socket
+    return now >= last ? now - last : now;
+}
+
+static Color GetTypeColor(size_t type) {
+    return type_colors[type % std::size(type_colors)];
+}
+
+static f32 GetTickLengthMs() {
+    return chrono::duration<f32, std::milli>{GetFrameTimer().GetTickLength()}.count();
+}
+
+// Bars grow up from y if height is positive and down from it otherwise
+static void AddBar(VertexArray &va, f32 x, f32 y, f32 height, Color color) {
+    if (height == 0.0f) {
+        return;
+    }
+
+    auto bottom = height > 0.0f ? y : y + height;
+    va.Add(Vec2{}, Vec2{1.0f, 1.0f}, Vec2{x, bottom}, Vec2{bar_width, std::abs(height)}, color);
+}
+
+void NetGraph::BeginTick(const NetIoThread &net_io) {
+    this->recv_queue = static_cast<u16>(std::min<size_t>(net_io.inbound.GetSize(), UINT16_MAX));
+}
+
+void NetGraph::EndTick(const NetIoThread &net_io, const Optional<ClockSyncMessage> &clock) {
+    auto &sample = this->samples[this->next_sample];
+    auto &last = this->last_totals;
+    auto stats = net_io.GetStats();
+
+    sample = {};
+    sample.bytes_in = static_cast<u32>(GetDelta(stats.bytes_received, last.bytes_received));
+    sample.bytes_out = static_cast<u32>(GetDelta(stats.bytes_sent, last.bytes_sent));
+    sample.packets_in = static_cast<u16>(std::min<size_t>(GetDelta(stats.packets_received, last.packets_received), UINT16_MAX));
+    sample.packets_out = static_cast<u16>(std::min<size_t>(GetDelta(stats.packets_sent, last.packets_sent), UINT16_MAX));
+    sample.recv_queue = this->recv_queue;
+    sample.send_queue = static_cast<u16>(std::min<size_t>(net_io.GetSendQueueSize(), UINT16_MAX));
+    sample.tick_length_delta_us = static_cast<i32>(chrono::duration_cast<chrono::microseconds>(GetFrameTimer().tick_length_delta).count());
+
+    if (clock.has_value()) {
+        auto tick_ms = GetTickLengthMs();
+        sample.has_clock = true;
+        sample.rtt_ms = clock->rtt * tick_ms;
+        sample.last_rtt_ms = clock->last_rtt * tick_ms;
+        sample.offset_ms = clock->offset * tick_ms;
+    }
+
+    for (size_t i = 0; i < NetTrafficStats::max_message_types; ++i) {
+        auto bytes = stats.traffic.messages[i][static_cast<size_t>(NetDirection::INBOUND)].bytes;
+        sample.bytes_in_by_type[i] = static_cast<u32>(GetDelta(bytes, last.bytes_by_type[i]));
+        last.bytes_by_type[i] = bytes;
+    }
+
+    last.bytes_received = stats.bytes_received;
+    last.bytes_sent = stats.bytes_sent;
+    last.packets_received = stats.packets_received;
+    last.packets_sent = stats.packets_sent;
+
+    this->next_sample = (this->next_sample + 1) % NetGraph::num_samples;
+    this->num_filled = std::min(this->num_filled + 1, NetGraph::num_samples);
+}
+
+void NetGraph::Toggle() {
+    this->visible = !this->visible;
+}
+
+void NetGraph::Render() {
+    if (!this->visible || this->num_filled == 0) {
+        return;
+    }
+
+    auto &font = GetClient().assets.fonts.default_font;
+    auto screen_size = GetGraphicsManager().GetWindowSize();
+    auto width = NetGraph::num_samples * bar_width;
+    auto left = screen_size.x - width - margin;
+    auto label_height = font.line_spacing;
+
+    // Oldest first, the newest sample is at the right edge
+    auto get_sample = [&](size_t i) -> const Sample & {
+        return this->samples[(this->next_sample + NetGraph::num_samples - this->num_filled + i) % NetGraph::num_samples];
+    };
+
+    auto get_x = [&](size_t i) {
+        return left + width - static_cast<f32>(this->num_filled - i) * bar_width;
+    };
+
+    auto get_max = [&](f32 floor, auto &&get_value) {
+        auto max = floor;
+        for (size_t i = 0; i < this->num_filled; ++i) {
+            max = std::max(max, static_cast<f32>(get_value(get_sample(i))));
+        }
+        return max;
+    };
+
+    auto get_average = [&](auto &&get_value) {
+        f32 sum = 0.0f;
+        for (size_t i = 0; i < this->num_filled; ++i) {
+            sum += static_cast<f32>(get_value(get_sample(i)));
+        }
+        return sum / static_cast<f32>(this->num_filled);
+    };
+
+    VertexArray va;
+    Array<std::pair<Vec2, String>> labels;
+    auto y = margin;
+
+    auto add_panel = [&](String label) {
+        va.Add(Vec2{}, Vec2{1.0f, 1.0f}, Vec2{left, y}, Vec2{width, panel_height}, background_color);
+        labels.emplace_back(Vec2{left, y + panel_height}, ToRvalue(label));
+
+        auto bottom = y;
+        y += panel_height + label_height + margin;
+        return bottom;
+    };
+
+    auto add_midline = [&](f32 bottom) {
+        auto middle = bottom + panel_height / 2.0f;
+        va.Add(Vec2{}, Vec2{1.0f, 1.0f}, Vec2{left, middle}, Vec2{width, 1.0f}, midline_color);
+        return middle;
+    };
+
+    { // Clock offset, with the tick length corrections behind it
+        auto scale = get_max(5.0f, [](const Sample &s) { return std::abs(s.offset_ms); });
+        const auto &newest = get_sample(this->num_filled - 1);
+        auto bottom = add_panel("offset {:.1f} ms (scale +-{:.0f}) tick delta {} us"_format(newest.offset_ms, scale, newest.tick_length_delta_us));
+        auto middle = add_midline(bottom);
+
+        for (size_t i = 0; i < this->num_filled; ++i) {
+            const auto &sample = get_sample(i);
+
+            if (sample.tick_length_delta_us != 0) {
+                AddBar(va, get_x(i), bottom, panel_height, sample.tick_length_delta_us < 0 ? slower_color : faster_color);
+            }
+
+            if (sample.has_clock) {
+                AddBar(va, get_x(i), middle, sample.offset_ms / scale * panel_height / 2.0f, rtt_color);
+            }
+        }
+    }
+
+    { // Round trip, the best sample of the server's window as a line
+        auto scale = get_max(20.0f, [](const Sample &s) { return std::max(s.rtt_ms, s.last_rtt_ms); });
+        const auto &newest = get_sample(this->num_filled - 1);
+        auto bottom = add_panel("rtt {:.1f} ms best {:.1f} ms (scale {:.0f})"_format(newest.last_rtt_ms, newest.rtt_ms, scale));
+
+        for (size_t i = 0; i < this->num_filled; ++i) {
+            const auto &sample = get_sample(i);
+
+            if (sample.has_clock) {
+                AddBar(va, get_x(i), bottom, sample.last_rtt_ms / scale * panel_height, rtt_color);
+                AddBar(va, get_x(i), bottom + sample.rtt_ms / scale * panel_height, 1.0f, best_rtt_color);
+            }
+        }
+    }
+
+    { // Queue depths, received above and unsent below the line
+        auto scale = get_max(4.0f, [](const Sample &s) { return std::max(s.recv_queue, s.send_queue); });
+        const auto &newest = get_sample(this->num_filled - 1);
+        auto bottom = add_panel("queue recv {} send {} (scale {:.0f})"_format(newest.recv_queue, newest.send_queue, scale));
+        auto middle = add_midline(bottom);
+
+        for (size_t i = 0; i < this->num_filled; ++i) {
+            const auto &sample = get_sample(i);
+            AddBar(va, get_x(i), middle, sample.recv_queue / scale * panel_height / 2.0f, in_color);
+            AddBar(va, get_x(i), middle, -(sample.send_queue / scale * panel_height / 2.0f), out_color);
+        }
+    }
+
+    { // Packets, in above and out below the line
+        auto scale = get_max(4.0f, [](const Sample &s) { return std::max(s.packets_in, s.packets_out); });
+        auto bottom = add_panel("packets/tick in {:.1f} out {:.1f} (scale {:.0f})"_format(
+            get_average([](const Sample &s) { return s.packets_in; }),
+            get_average([](const Sample &s) { return s.packets_out; }),
+            scale));
+        auto middle = add_midline(bottom);
+
+        for (size_t i = 0; i < this->num_filled; ++i) {
+            const auto &sample = get_sample(i);
+            AddBar(va, get_x(i), middle, sample.packets_in / scale * panel_height / 2.0f, in_color);
+            AddBar(va, get_x(i), middle, -(sample.packets_out / scale * panel_height / 2.0f), out_color);
+        }
+    }
+
+    // Bytes in window per message type for the legend
+    std::array<u64, NetTrafficStats::max_message_types> type_totals{};
+    for (size_t i = 0; i < this->num_filled; ++i) {
+        const auto &sample = get_sample(i);
+        for (size_t type = 0; type < NetTrafficStats::max_message_types; ++type) {
+            type_totals[type] += sample.bytes_in_by_type[type];
+        }
+    }
+
+    { // Bytes, in above the line stacked by message type (uncompressed), out below (as sent)
+        auto scale = get_max(256.0f,
+            [](const Sample &s) {
+                u32 in = 0;
+                for (auto bytes : s.bytes_in_by_type) {
+                    in += bytes;
+                }
+                return std::max(in, s.bytes_out);
+            });
+        auto bottom = add_panel("bytes/tick in {:.0f} out {:.0f} (scale {:.0f})"_format(
+            get_average([](const Sample &s) { return s.bytes_in; }),
+            get_average([](const Sample &s) { return s.bytes_out; }),
+            scale));
+        auto middle = add_midline(bottom);
+
+        for (size_t i = 0; i < this->num_filled; ++i) {
+            const auto &sample = get_sample(i);
+            auto stack = middle;
+
+            for (size_t type = 0; type < NetTrafficStats::max_message_types; ++type) {
+                auto height = sample.bytes_in_by_type[type] / scale * panel_height / 2.0f;
+                AddBar(va, get_x(i), stack, height, GetTypeColor(type));
+                stack += height;
+            }
+
+            AddBar(va, get_x(i), middle, -(sample.bytes_out / scale * panel_height / 2.0f), out_color);
+        }
+    }
+
+    GetGraphicsManager().Draw(va, GetClient().assets.textures.white_pixel, Camera{});
+
+    for (const auto &[position, text] : labels) {
+        DrawString(font, position, text, Color{255, 255, 255, 255});
+    }
+
+    // The legend of the bytes plot, the biggest message types in the window first
+    Array<size_t> types;
+    for (size_t type = 0; type < NetTrafficStats::max_message_types; ++type) {
+        if (type_totals[type] > 0) {
+            types.emplace_back(type);
+        }
+    }
+
+    std::sort(types.begin(), types.end(),
+        [&](size_t a, size_t b) {
+            return type_totals[a] > type_totals[b];
+        });
+
+    types.resize(std::min<size_t>(types.size(), 5));
+
+    String legend;
+    Array<FancyTextRange> style;
+
+    for (auto type : types) {
+        auto start = static_cast<i32>(legend.size());
+        legend += "{} {:.0f}  "_format(ToString(static_cast<NetMessageType>(type)), static_cast<f32>(type_totals[type]) / this->num_filled);
+        style.emplace_back(FancyTextRange{
+            .start = start,
+            .end = static_cast<i32>(legend.size()),
+            .color = GetTypeColor(type),
+        });
+    }
+
+    if (!legend.empty()) {
+        DrawString(font, Vec2{left, y}, legend, style);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/net_stats.hpp"
+
+struct NetIoThread;
+struct ClockSyncMessage;
+struct VertexArray;
+
+// Plots the connection per tick over the last few seconds in the corner of the screen:
+// bytes in (by message type) and out, packets, queue depths, the server's round trip and
+// clock offset estimate and the tick length corrections. Toggled with F3 or the net_graph
+// command. All plots are quads in one vertex array, so they take a single draw call.
+struct NetGraph {
+    constexpr static size_t num_samples = 300; // 5 seconds at 60 ticks per second
+
+    struct Sample {
+        u32 bytes_in = 0; // As received, possibly compressed
+        u32 bytes_out = 0;
+        u16 packets_in = 0;
+        u16 packets_out = 0;
+        u16 recv_queue = 0; // Packets waiting for the tick
+        u16 send_queue = 0; // Packets the network thread has not written after the tick
+        bool has_clock = false; // The server sent an estimate
+        f32 rtt_ms = 0.0f;
+        f32 last_rtt_ms = 0.0f;
+        f32 offset_ms = 0.0f; // < 0: ahead of the server, > 0: behind
+        i32 tick_length_delta_us = 0;
+        std::array<u32, NetTrafficStats::max_message_types> bytes_in_by_type{}; // Uncompressed
+    };
+
+    // The socket counters at the previous sample
+    struct Totals {
+        size_t bytes_received = 0;
+        size_t bytes_sent = 0;
+        size_t packets_received = 0;
+        size_t packets_sent = 0;
+        std::array<u64, NetTrafficStats::max_message_types> bytes_by_type{};
+    };
+
+    void BeginTick(const NetIoThread &net_io); // Before the received packets are handled
+    void EndTick(const NetIoThread &net_io, const Optional<ClockSyncMessage> &clock); // After the tick pushed its packets
+    void Render();
+    void Toggle();
+
+    bool visible = false;
+    std::array<Sample, num_samples> samples{};
+    size_t next_sample = 0;
+    size_t num_filled = 0;
+    u16 recv_queue = 0; // From BeginTick until EndTick
+    Totals last_totals;
+};
@@ -0,0 +1,181 @@
+#include "client/net_io.hpp"
+
+#include "common/log.hpp"
+
+NetIoThread::~NetIoThread() {
+    this->Stop();
+}
+
+void NetIoThread::Connect(sockaddr_in remote_address) {
+    this->Stop();
+    this->socket.Connect(remote_address);
+
+    // The handshake offers compression, and the server may compress right after its response
+    this->socket.max_decompressed_size = TcpSocket::max_decompressed_packet_size;
+}
+
+SocketResult NetIoThread::DoConnect() {
+    assert(!this->thread.joinable());
+    return this->socket.DoConnect();
+}
+
+void NetIoThread::Start() {
+    assert(!this->thread.joinable());
+    assert(this->socket.state == SocketState::CONNECTED);
+
+    this->quit = false;
+    this->state = this->socket.state;
+    this->send_done = true;
+    this->overflowed = false;
+    this->packets_queued = 0;
+    this->packets_written = 0;
+    this->packets_sent_before = this->socket.stats.packets_sent;
+    this->PublishStats();
+
+    this->thread = std::thread{&NetIoThread::Run, this};
+}
+
+void NetIoThread::Stop() {
+    if (this->thread.joinable()) {
+        this->quit = true;
+        this->thread.join();
+    }
+
+    this->socket.Close(false);
+    this->outbound.Clear();
+    this->inbound.Clear();
+    this->state = SocketState::NONE;
+    this->compression_enabled = false;
+    this->send_done = true;
+    this->overflowed = false;
+}
+
+bool NetIoThread::Send(Packet &&packet) {
+    if (!this->thread.joinable()) {
+        return false;
+    }
+
+    if (!this->outbound.TryPush(ToRvalue(packet))) {
+        if (!this->overflowed) {
+            LogError("net io", "{} packets are waiting for the network thread, giving up on the connection"_format(NetIoThread::queue_capacity));
+            this->overflowed = true;
+        }
+
+        return false;
+    }
+
+    ++this->packets_queued;
+    return true;
+}
+
+bool NetIoThread::Pop(ReceivedPacket &out) {
+    return this->inbound.TryPop(out);
+}
+
+SocketState NetIoThread::GetState() const {
+    return this->overflowed ? SocketState::ERROR : this->state.load();
+}
+
+bool NetIoThread::IsSendDone() const {
+    return this->outbound.GetSize() == 0 && this->send_done;
+}
+
+void NetIoThread::SetCompression(bool enabled) {
+    this->compression_enabled = enabled;
+}
+
+SocketStats NetIoThread::GetStats() const {
+    std::lock_guard lock{this->stats_mutex};
+    return this->stats;
+}
+
+size_t NetIoThread::GetSendQueueSize() const {
+    std::lock_guard lock{this->stats_mutex};
+    return this->outbound.GetSize() + this->socket_send_queue;
+}
+
+Optional<NetIoThread::Clock::time_point> NetIoThread::GetWriteTime(u64 packet) const {
+    auto written = this->packets_written.load(std::memory_order_acquire);
+
+    if (packet == 0 || packet > written || written - packet >= NetIoThread::num_write_times) {
+        return std::nullopt;
+    }
+
+    Clock::time_point time{Clock::duration{this->write_times[(packet - 1) % NetIoThread::num_write_times].load(std::memory_order_relaxed)}};
+
+    // The slot may have been reused in the meantime
+    if (this->packets_written.load(std::memory_order_acquire) - packet >= NetIoThread::num_write_times) {
+        return std::nullopt;
+    }
+
+    return time;
+}
+
+void NetIoThread::Run() {
+    auto &socket = this->socket;
+    auto last_bytes_sent = socket.stats.bytes_sent;
+    auto last_bytes_received = socket.stats.bytes_received;
+
+    while (!this->quit) {
+        socket.compression_enabled = this->compression_enabled;
+
+        Packet packet;
+        while (this->outbound.TryPop(packet)) {
+            socket.Push(ToRvalue(packet));
+        }
+
+        socket.DoSend();
+        this->PublishWrites(Clock::now());
+
+        socket.DoRecv();
+        auto now = Clock::now();
+
+        // If the main thread does not keep up, the rest waits in the socket's queue
+        while (!socket.recv.queue.empty() && this->inbound.GetSize() < NetIoThread::queue_capacity) {
+            this->inbound.TryPush(ReceivedPacket{.data = ToRvalue(socket.recv.queue.front()), .received_at = now});
+            socket.recv.queue.pop_front();
+        }
+
+        auto sending = !socket.IsSendDone();
+        this->send_done = !sending;
+
+        if (socket.stats.bytes_sent != last_bytes_sent || socket.stats.bytes_received != last_bytes_received) {
+            last_bytes_sent = socket.stats.bytes_sent;
+            last_bytes_received = socket.stats.bytes_received;
+            this->PublishStats();
+        }
+
+        if (socket.state != SocketState::CONNECTED) {
+            this->PublishStats();
+            this->state = socket.state == SocketState::ERROR ? SocketState::ERROR : SocketState::NONE;
+            return;
+        }
+
+        pollfd pfd{.fd = socket.sd, .events = static_cast<short>(POLLIN | (sending ? POLLOUT : 0))};
+        net::Poll(&pfd, 1, NetIoThread::poll_timeout_ms);
+    }
+}
+
+void NetIoThread::PublishWrites(Clock::time_point now) {
+    auto written = this->packets_written.load(std::memory_order_relaxed);
+    auto sent = static_cast<u64>(this->socket.stats.packets_sent - this->packets_sent_before);
+
+    if (sent == written) {
+        return;
+    }
+
+    // Only the last num_write_times packets can be looked up anyway
+    auto first = std::max(written + 1, sent > NetIoThread::num_write_times ? sent - NetIoThread::num_write_times + 1 : 1);
+
+    for (auto packet = first; packet <= sent; ++packet) {
+        this->write_times[(packet - 1) % NetIoThread::num_write_times].store(now.time_since_epoch().count(), std::memory_order_relaxed);
+    }
+
+    this->packets_written.store(sent, std::memory_order_release);
+}
+
+void NetIoThread::PublishStats() {
+    std::lock_guard lock{this->stats_mutex};
+    this->stats = this->socket.stats;
+    this->socket_send_queue = this->socket.send.queue.size() + this->socket.send.urgent.size() + (this->socket.send.current.empty() ? 0 : 1);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/socket.hpp"
+#include "common/spsc_queue.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// Does the client's socket I/O on its own thread once the connection is established, so
+// packets move while the main thread renders, waits for vsync or catches up on ticks.
+// Packets cross over in two SPSC queues: the main thread pushes the ones to send and pops
+// the received ones, which carry the time they were read from the socket.
+//
+// Before Start and after Stop only the main thread touches the socket (Connect, DoConnect).
+struct NetIoThread {
+    using Clock = chrono::high_resolution_clock;
+
+    constexpr static size_t queue_capacity = 4096;
+    constexpr static int poll_timeout_ms = 1; // Packets the main thread pushes wait at most this long
+    constexpr static size_t num_write_times = 64;
+
+    struct ReceivedPacket {
+        Array<char> data;
+        Clock::time_point received_at;
+    };
+
+    ~NetIoThread();
+    void Connect(sockaddr_in remote_address);
+    SocketResult DoConnect();
+    void Start();
+    void Stop(); // Closes the socket and drops everything that was not sent or handled yet
+    bool Send(Packet &&packet); // False if the thread is too far behind, the connection fails then
+    bool Pop(ReceivedPacket &out);
+    SocketState GetState() const;
+    bool IsSendDone() const;
+    void SetCompression(bool enabled);
+    SocketStats GetStats() const; // As of the thread's last pass
+    size_t GetSendQueueSize() const; // Packets pushed by the main thread but not written yet
+    Optional<Clock::time_point> GetWriteTime(u64 packet) const; // Of the packet that made packets_queued this value
+    void Run();
+    void PublishWrites(Clock::time_point now);
+    void PublishStats();
+
+    TcpSocket socket; // Only touched by the thread while it runs
+    std::thread thread;
+    std::atomic<bool> quit = false;
+    std::atomic<SocketState> state = SocketState::NONE;
+    std::atomic<bool> compression_enabled = false;
+    std::atomic<bool> send_done = true; // The socket's send queue is empty
+    bool overflowed = false; // Main thread only, see Send
+    SpscQueue<Packet, queue_capacity> outbound;
+    SpscQueue<ReceivedPacket, queue_capacity> inbound;
+    u64 packets_queued = 0; // Main thread only
+    std::atomic<u64> packets_written = 0;
+    size_t packets_sent_before = 0; // socket.stats.packets_sent at Start, the stats count all connections
+    std::array<std::atomic<Clock::rep>, num_write_times> write_times{}; // Packet n was written at write_times[(n - 1) % num_write_times]
+
+    mutable std::mutex stats_mutex;
+    SocketStats stats; // Guarded by stats_mutex
+    size_t socket_send_queue = 0; // Guarded by stats_mutex
+};
@@ -0,0 +1,86 @@
+#include "client/session_list.hpp"
+
+#include "client/client.hpp"
+#include "common/net_msg.hpp"
+#include "common/net_msg_view.hpp"
+
+void SessionList::Request() {
+    GetSessionInfoRequest request;
+    request.first = this->first;
+    request.max_sessions = page_size;
+    request.filter = this->filter;
+    request.subscribe = true;
+    GetClient().Send(request);
+}
+
+void SessionList::NextPage() {
+    if (this->first + page_size < this->num_matching) {
+        this->first += page_size;
+        this->Request();
+    }
+}
+
+void SessionList::PreviousPage() {
+    if (this->first > 0) {
+        this->first -= std::min(this->first, page_size);
+        this->Request();
+    }
+}
+
+void SessionList::Apply(const GetSessionInfoResponseView &response) {
+    this->first = response.first;
+    this->num_matching = response.num_matching;
+
+    // Assigning in place keeps the string buffers of the previous response
+    this->sessions.resize(response.GetNumSessions());
+    auto it = this->sessions.begin();
+
+    response.ForEachSession(
+        [&](const GetSessionInfoResponseView::Entry &entry) {
+            auto &info = *it++;
+            info.name = entry.name;
+            info.id = entry.id;
+            info.nplayers = entry.nplayers;
+            info.nplayers_connected = entry.nplayers_connected;
+            info.state = entry.state;
+            info.haspw = entry.haspw;
+        });
+}
+
+// The update is not filtered by the server. Sessions that are not on the page are only added
+// while the page has room, the next request puts them where they belong.
+void SessionList::Apply(const SessionListUpdateMessage &update) {
+    auto find = [&](u16 id) {
+        return std::find_if(this->sessions.begin(), this->sessions.end(),
+            [&](const SessionInfo &info) {
+                return info.id == id;
+            });
+    };
+
+    auto remove = [&](u16 id) {
+        auto it = find(id);
+        if (it != this->sessions.end()) {
+            this->sessions.erase(it);
+            this->num_matching -= std::min<u16>(this->num_matching, 1);
+        }
+    };
+
+    for (const auto &info : update.updated) {
+        if (!this->filter.Matches(info)) {
+            remove(info.id);
+            continue;
+        }
+
+        auto it = find(info.id);
+        if (it != this->sessions.end()) {
+            *it = info;
+        } else if (this->sessions.size() < page_size) {
+            this->sessions.emplace_back(info);
+            ++this->num_matching;
+        }
+    }
+
+    for (auto id : update.removed) {
+        remove(id);
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/session_info.hpp"
+
+struct GetSessionInfoResponseView;
+struct SessionListUpdateMessage;
+
+// One page of the server's session listing, kept up to date with the updates the server
+// pushes while the session browser is open. Used by the session browser GUI and the
+// headless driver.
+struct SessionList {
+    constexpr static u16 page_size = 12;
+
+    void Request(); // Fetches the current page with the current filter
+    void NextPage();
+    void PreviousPage();
+    void Apply(const GetSessionInfoResponseView &response);
+    void Apply(const SessionListUpdateMessage &update);
+
+    inline u16 GetNumPages() const {
+        return std::max<u16>((this->num_matching + page_size - 1) / page_size, 1);
+    }
+
+    Array<SessionInfo> sessions;
+    SessionFilter filter;
+    u16 first = 0;
+    u16 num_matching = 0; // On all pages
+};
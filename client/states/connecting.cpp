@@ -1,15 +1,20 @@
 #include "client/client_state.hpp"
 
 #include "client/client.hpp"
-#include "client/graphics/graphics_manager.hpp"
 #include "common/log.hpp"
 #include "client/config/config.hpp"
 
 #include <chrono>
+#include <charconv>
+
+#if !HEADLESS
+#include "client/graphics/graphics_manager.hpp"
+#endif
 
 class ConnectingState : public ClientState {
 public:
-    explicit ConnectingState(Optional<StringView> ip) {
+    ConnectingState(Optional<StringView> ip, Optional<HandshakeRequest::FastJoin> fast_join)
+        : fast_join(ToRvalue(fast_join)) {
         if (ip.has_value()) {
             this->target_ip = ip.value();
             this->try_localhost_on_failure = false;
@@ -25,14 +30,17 @@ public:
     void End() override {
     }
 
+#if !HEADLESS
     void Input(const SDL_Event &e) override {
     }
+#endif
 
     void Tick(f32 dt) override {
-        switch (GetClient().socket.DoConnect()) {
+        switch (GetClient().net_io.DoConnect()) {
             case SocketResult::DONE:
                 LogInfo("connecting", "Connected to {}"_format(this->is_connecting_to_deployment_server ? "deployment server" : "localhost"));
-                GetClient().SetNextState(client_states::MakeHandshake());
+                GetClient().net_io.Start();
+                GetClient().SetNextState(client_states::MakeHandshake(ToRvalue(this->fast_join)));
                 break;
 
             case SocketResult::ERROR:
@@ -59,21 +67,32 @@ public:
         }
     }
 
+#if !HEADLESS
     void Render() override {
         GetGraphicsManager().DrawBackground(GetClient().assets.textures.sessionbrowser_background);
     }
+#endif
 
     StringView GetDisplayName() const override { return "ConnectingState"; }
 
+    // Address is <ip> or <ip>:<port>, the latter e.g. for going through tankgame-netsim
     void Connect(StringView address) {
         this->connecting_started = chrono::high_resolution_clock::now();
+        String host{address};
+        u16 port = 1303;
+
+        if (auto colon = host.find(':'); colon != String::npos) {
+            std::from_chars(host.data() + colon + 1, host.data() + host.size(), port);
+            host.resize(colon);
+        }
+
         sockaddr_in server_address;
         server_address.sin_family = AF_INET;
-        auto result = inet_pton(AF_INET, address.data(), &server_address.sin_addr);
+        auto result = inet_pton(AF_INET, host.c_str(), &server_address.sin_addr);
         assert(result == 1);
-        LogInfo("client", "Connecting to {}:{}"_format(inet_ntoa(server_address.sin_addr), server_address.sin_port));
-        server_address.sin_port = htons(1303);
-        GetClient().socket.Connect(server_address);
+        server_address.sin_port = htons(port);
+        LogInfo("client", "Connecting to {}:{}"_format(inet_ntoa(server_address.sin_addr), port));
+        GetClient().net_io.Connect(server_address);
     }
 
     void ConnectToTargetServer() {
@@ -92,8 +111,9 @@ public:
     bool try_localhost_on_failure = true;
     chrono::high_resolution_clock::time_point connecting_started;
     String target_ip;
+    Optional<HandshakeRequest::FastJoin> fast_join; // Sent along with the handshake
 };
 
-UniquePtr<ClientState> client_states::MakeConnecting(Optional<StringView> ip) {
-    return std::make_unique<ConnectingState>(ip);
+UniquePtr<ClientState> client_states::MakeConnecting(Optional<StringView> ip, Optional<HandshakeRequest::FastJoin> fast_join) {
+    return std::make_unique<ConnectingState>(ip, ToRvalue(fast_join));
 }
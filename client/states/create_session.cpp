@@ -2,10 +2,13 @@
 
 #include "client/client.hpp"
 #include "client/config/config.hpp"
-#include "client/graphics/graphics_manager.hpp"
 #include "common/log.hpp"
 #include "server/session.hpp"
 
+#if !HEADLESS
+#include "client/graphics/graphics_manager.hpp"
+#endif
+
 class CreateSessionState : public ClientState {
     void Begin() override {
         this->net_message_handlers.Add(&CreateSessionState::HandleCreateSessionResponse, this);
@@ -14,6 +17,7 @@ class CreateSessionState : public ClientState {
     void End() override {
     }
 
+#if !HEADLESS
     void Input(const SDL_Event &e) override {
 #if defined(DEVELOPMENT) && DEVELOPMENT
         switch (e.type) {
@@ -27,15 +31,18 @@ class CreateSessionState : public ClientState {
         }
 #endif
     }
+#endif
 
     void Tick(f32 dt) override {
     }
 
+#if !HEADLESS
     void Render() override {
         auto &client = GetClient();
         GetGraphicsManager().DrawBackground(client.assets.textures.sessionbrowser_background);
         client.gui.create_session_menu.Show();
     }
+#endif
 
     StringView GetDisplayName() const override { return "CreateSessionState"; }
 
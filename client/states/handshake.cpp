@@ -4,36 +4,64 @@
 #include "common/log.hpp"
 
 class HandshakeState : public ClientState {
+public:
+    explicit HandshakeState(Optional<HandshakeRequest::FastJoin> fast_join)
+        : fast_join(ToRvalue(fast_join)) {
+    }
+
     void Begin() override {
         this->net_message_handlers.Add(&HandshakeState::HandleHandshakeResponse, this);
+        this->net_message_handlers.Add(&HandshakeState::HandleJoinSessionResponse, this);
 
         HandshakeRequest request;
         request.ver_major = VER_MAJOR;
         request.ver_minor = VER_MINOR;
         request.ver_build = VER_BUILD;
+        request.supports_compression = true;
+        request.fast_join = this->fast_join;
         GetClient().Send(request);
     }
 
     void End() override {
     }
 
+#if !HEADLESS
     void Input(const SDL_Event &e) override {
     }
+#endif
 
     void Tick(f32 dt) override {
     }
 
+#if !HEADLESS
     void Render() override {
     }
+#endif
 
     StringView GetDisplayName() const override { return "HandshakeState"; }
 
     void HandleHandshakeResponse(HandshakeResponse &&response) {
         LogInfo("handshake", "Server game version: {}.{}.{}"_format(response.ver_major, response.ver_minor, response.ver_build));
-        GetClient().SetNextState(client_states::MakeSessionbrowser());
+        GetClient().net_io.SetCompression(response.compression);
+
+        // The join response is in the same flight, wait for it instead of showing the session browser
+        if (!this->fast_join.has_value()) {
+            GetClient().SetNextState(client_states::MakeSessionbrowser());
+        }
     }
+
+    void HandleJoinSessionResponse(JoinSessionResponse &&response) {
+        if (response.result == JoinSessionResult::SUCCESS) {
+            GetClient().SetNextState(client_states::MakeLobby(ToRvalue(response.connected_players)));
+        } else {
+            LogWarning("handshake", "Could not join session: {}"_format(ToString(response.result)));
+            GetClient().SetNextState(client_states::MakeSessionbrowser());
+        }
+    }
+
+    Optional<HandshakeRequest::FastJoin> fast_join;
 };
 
-UniquePtr<ClientState> client_states::MakeHandshake() {
-    return std::make_unique<HandshakeState>();
+UniquePtr<ClientState> client_states::MakeHandshake(Optional<HandshakeRequest::FastJoin> fast_join) {
+    return std::make_unique<HandshakeState>(ToRvalue(fast_join));
 }
@@ -1,13 +1,17 @@
 #include "client/client_state.hpp"
 
 #include "client/client.hpp"
-#include "client/graphics/graphics_manager.hpp"
 #include "common/log.hpp"
 #include "client/client_game_state.hpp"
 #include "common/log.hpp"
 #include "common/frame_timer.hpp"
+#include "common/sector.hpp"
 #include <iostream>
 
+#if !HEADLESS
+#include "client/graphics/graphics_manager.hpp"
+#endif
+
 class IngameState : public ClientState {
 public:
     IngameState(Entity my_tank) {
@@ -20,21 +24,41 @@ public:
         this->net_message_handlers.Add(&IngameState::HandleSetTickLengthMessage, this);
         this->net_message_handlers.Add(&IngameState::HandlePauseGameMessage, this);
         this->net_message_handlers.Add(&IngameState::HandlePingMessage, this);
+        this->net_message_handlers.Add(&IngameState::HandleInputAckMessage, this);
+        this->net_message_handlers.Add(&IngameState::HandleClockSyncMessage, this);
         //this->net_message_handlers.add(&Ingame_State::handle_pong_message, this);
 
+#if HEADLESS
+        GetClient().driver.game_state = &this->game_state;
+#else
         auto &graphics_manager = GetGraphicsManager();
         //SDL_CaptureMouse(SDL_TRUE);
         //SDL_SetWindowGrab(graphics_manager.win, SDL_TRUE);
         auto window_size = graphics_manager.GetWindowSize();
+#endif
     }
 
     void End() override {
+        GetClient().clock_estimate.reset();
+
+#if HEADLESS
+        GetClient().driver.game_state = nullptr;
+#endif
         //SDL_CaptureMouse(SDL_FALSE);
     }
 
+#if !HEADLESS
     void Input(const SDL_Event &e) override {
+        if (!this->level_loaded) {
+            return;
+        }
+
         this->game_state.HandleInput(this->game_state.my_tank.value(), e);
 
+        if (!this->game_state.input_changed_at.has_value() && !this->game_state.input.HasSameState(this->game_state.last_sent_input)) {
+            this->game_state.input_changed_at = InputLatencyTracer::Clock::now();
+        }
+
 #if defined(DEVELOPMENT) && DEVELOPMENT
         switch (e.type) {
             case SDL_KEYDOWN: {
@@ -63,30 +87,106 @@ public:
         }
 #endif
     }
+#endif
 
     void Tick(f32 dt) override {
+        if (!this->level_loaded) {
+            return;
+        }
+
+        this->game_state.SendInput();
+
+        // The input did not change, so there was no bundle to carry the timestamp back
+        if (this->game_state.pending_echo.has_value()) {
+            PongMessage pong;
+            pong.echo = this->game_state.pending_echo.value();
+            pong.echo.hold_time = this->game_state.time - pong.echo.client_time;
+            GetClient().Send(pong);
+            this->game_state.pending_echo.reset();
+        }
+
         this->game_state.Tick(dt);
+
+        // Tell the server when the camera moves to another sector so it replicates the entities there
+        auto view_center = this->game_state.cam.position + this->game_state.GetViewSize() / 2.0f;
+        auto view_sector = GetSector(view_center);
+
+        if (!this->view_sector.has_value() || this->view_sector.value() != view_sector) {
+            this->view_sector = view_sector;
+
+            SetViewCommand set_view;
+            set_view.position = view_center;
+            GetClient().SendGameCommand(set_view);
+        }
     }
 
+#if !HEADLESS
     void Render() override {
+        if (!this->level_loaded) {
+            return;
+        }
+
         this->game_state.Render();
     }
+#endif
 
     StringView GetDisplayName() const override { return "IngameState"; }
 
     void HandleLoadLevelMessage(Packet &&packet) {
         LoadLevelMessage message;
-        if (!message.Deserialize(packet) || !this->game_state.Deserialize(packet) || !packet.IsValidAndFinished()) {
+        if (!message.Deserialize(packet)) {
             GetClient().ProtocolError();
             return;
         }
 
+        if (message.has_snapshot) {
+            this->game_state.entities = EntityRegistry{};
+
+            if (!this->game_state.Deserialize(packet) || !packet.IsValidAndFinished()) {
+                GetClient().ProtocolError();
+                return;
+            }
+        } else {
+            if (!packet.IsValidAndFinished()) {
+                GetClient().ProtocolError();
+                return;
+            }
+
+            Array<Entity> tanks;
+            auto generated = this->game_state.GenerateLevel(message.level, tanks);
+
+            if (!generated || this->game_state.ComputeChecksum() != message.checksum) {
+                // Commands are dropped until the complete state arrives, it already contains their effects
+                LogWarning("ingame", "Could not generate the level (generator version {}), requesting the complete state"_format(
+                    message.level.generator_version));
+                this->game_state.entities = EntityRegistry{};
+                GetClient().Send(RequestLevelMessage{});
+                return;
+            }
+        }
+
+        if (!this->game_state.my_tank.has_value() || !this->game_state.entities.IsValid(this->game_state.my_tank.value())) {
+            GetClient().ProtocolError();
+            return;
+        }
+
+        this->level_loaded = true;
+
         this->game_state.cam.position =
             this->game_state.GetTankWorldPosition(this->game_state.my_tank.value()) -
-            GetGraphicsManager().GetWindowSize() / 2.0f;
+            this->game_state.GetViewSize() / 2.0f;
+
+        // The input is only sent if it differs from the tank's initial state
+        const auto &tank = this->game_state.entities.Get<CTank>(this->game_state.my_tank.value());
+        this->game_state.input.weapon = static_cast<u8>(tank.weapon_type);
+        this->game_state.last_sent_input = this->game_state.input;
     }
 
     void HandleGameCommandMessage(Packet &&packet) {
+        if (!this->level_loaded) {
+            return;
+        }
+
         GameCommandMessage message;
         if (!message.Deserialize(packet)) {
             GetClient().ProtocolError();
@@ -116,13 +216,33 @@ public:
     }
 
     void HandlePingMessage(PingMessage &&message) {
+        // The time the ping arrived, the server takes the wait for the tick off the round trip
         PongMessage response;
-        response.my_time = this->game_state.time;
-        response.your_time = message.my_time;
+        response.echo.server_time = message.my_time;
+        response.echo.client_time = this->game_state.time - GetClient().GetTicksSinceReceived();
+        response.echo.hold_time = this->game_state.time - response.echo.client_time;
         GetClient().Send(response);
     }
 
+    void HandleInputAckMessage(InputAckMessage &&message) {
+        this->game_state.AcknowledgeInput(message.sequence);
+        GetClient().input_latency.OnInputAcked(message.sequence, message.timing, GetClient().net_io);
+
+        if (message.server_time.has_value()) {
+            TimeEcho echo;
+            echo.server_time = message.server_time.value();
+            echo.client_time = this->game_state.time - GetClient().GetTicksSinceReceived();
+            this->game_state.pending_echo = echo;
+        }
+    }
+
+    void HandleClockSyncMessage(ClockSyncMessage &&message) {
+        GetClient().clock_estimate = message;
+    }
+
     ClientGameState game_state;
+    Optional<Vec2i> view_sector;
+    bool level_loaded = false; // Input, ticks and game commands wait for the level
 };
 
 UniquePtr<ClientState> client_states::MakeIngame(Entity my_tank) {
@@ -1,10 +1,13 @@
 #include "client/client_state.hpp"
 
 #include "client/client.hpp"
-#include "client/graphics/graphics_manager.hpp"
 #include "common/log.hpp"
 #include "common/player_info.hpp"
 
+#if !HEADLESS
+#include "client/graphics/graphics_manager.hpp"
+#endif
+
 class LobbyState : public ClientState {
 public:
     explicit LobbyState(Array<PlayerInfo> player_info) {
@@ -16,13 +19,22 @@ public:
         this->net_message_handlers.Add(&LobbyState::handle_leave_session_message, this);
         this->net_message_handlers.Add(&LobbyState::handle_lobby_update_message, this);
 
+#if HEADLESS
+        GetClient().driver.player_info = &this->player_info;
+#else
         GetClient().gui.session_lobby_menu.player_info = &this->player_info;
+#endif
     }
 
     void End() override {
+#if HEADLESS
+        GetClient().driver.player_info = nullptr;
+#else
         GetClient().gui.session_lobby_menu.player_info = nullptr;
+#endif
     }
 
+#if !HEADLESS
     void Input(const SDL_Event &e) override {
 #if defined(DEVELOPMENT) && DEVELOPMENT
         switch (e.type) {
@@ -44,15 +56,18 @@ public:
         }
 #endif
     }
+#endif
 
     void Tick(f32 dt) override {
     }
 
+#if !HEADLESS
     void Render() override {
         auto &client = GetClient();
         GetGraphicsManager().DrawBackground(client.assets.textures.lobby_background);
         client.gui.session_lobby_menu.Show();
     }
+#endif
 
     StringView GetDisplayName() const override { return "LobbyState"; }
 
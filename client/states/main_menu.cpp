@@ -1,9 +1,12 @@
 #include "client/client_state.hpp"
 
 #include "client/client.hpp"
-#include "client/graphics/graphics_manager.hpp"
 #include "common/log.hpp"
 
+#if !HEADLESS
+#include "client/graphics/graphics_manager.hpp"
+#endif
+
 class MenuState : public ClientState {
     void Begin() override {
     }
@@ -11,6 +14,7 @@ class MenuState : public ClientState {
     void End() override {
     }
 
+#if !HEADLESS
     void Input(const SDL_Event &e) override {
 #if defined(DEVELOPMENT) && DEVELOPMENT
         switch (e.type) {
@@ -29,15 +33,18 @@ class MenuState : public ClientState {
         }
 #endif
     }
+#endif
 
     void Tick(f32 dt) override {
     }
 
+#if !HEADLESS
     void Render() override {
         auto &client = GetClient();
         GetGraphicsManager().DrawBackground(client.assets.textures.main_menu_background);
         client.gui.main_menu.Show();
     }
+#endif
 
     StringView GetDisplayName() const override { return "MenuState"; }
 };
@@ -2,10 +2,14 @@
 
 #include "client/client.hpp"
 #include "client/config/config.hpp"
-#include "client/graphics/graphics_manager.hpp"
+#include "client/session_list.hpp"
 #include "common/log.hpp"
 #include "server/session.hpp"
 
+#if !HEADLESS
+#include "client/graphics/graphics_manager.hpp"
+#endif
+
 class SessionBrowserState : public ClientState {
 public:
     explicit SessionBrowserState(bool show_error_message)
@@ -14,19 +18,28 @@ public:
 
     void Begin() override {
         this->net_message_handlers.Add(&SessionBrowserState::HandleGetSessoinInfoResponse, this);
+        this->net_message_handlers.Add(&SessionBrowserState::HandleSessionListUpdateMessage, this);
         this->net_message_handlers.Add(&SessionBrowserState::HandleJoinSessionResponse, this);
 
         auto &client = GetClient();
-        client.gui.session_browser_menu.session_infos = &this->session_infos;
+#if HEADLESS
+        client.driver.session_list = &this->session_list;
+#else
+        client.gui.session_browser_menu.session_list = &this->session_list;
+#endif
 
-        GetSessionInfoRequest request;
-        client.Send(request);
+        this->session_list.Request();
     }
 
     void End() override {
-        GetClient().gui.session_browser_menu.session_infos = nullptr;
+#if HEADLESS
+        GetClient().driver.session_list = nullptr;
+#else
+        GetClient().gui.session_browser_menu.session_list = nullptr;
+#endif
     }
 
+#if !HEADLESS
     void Input(const SDL_Event &e) override {
 #if defined(DEVELOPMENT) && DEVELOPMENT
         switch (e.type) {
@@ -34,8 +47,8 @@ public:
                 switch (e.key.keysym.sym) {
                     case SDLK_RETURN:
                     case SDLK_SPACE: { // Join the first session in the session list
-                        if (!this->session_infos.empty()) {
-                            auto &info = this->session_infos.front();
+                        if (!this->session_list.sessions.empty()) {
+                            auto &info = this->session_list.sessions.front();
                             JoinSessionRequest request;
                             request.session_id = info.id;
                             request.player_name = GetConfig().values.player_name;
@@ -52,10 +65,12 @@ public:
         }
 #endif
     }
+#endif
 
     void Tick(f32 dt) override {
     }
 
+#if !HEADLESS
     void Render() override {
         auto &client = GetClient();
         GetGraphicsManager().DrawBackground(client.assets.textures.sessionbrowser_background);
@@ -65,11 +80,16 @@ public:
             client.gui.ShowError();
         }
     }
+#endif
 
     StringView GetDisplayName() const override { return "SessionBrowserState"; }
 
-    void HandleGetSessoinInfoResponse(GetSessionInfoResponse &&response) {
-        this->session_infos = ToRvalue(response.sessions);
+    void HandleGetSessoinInfoResponse(const GetSessionInfoResponseView &response) {
+        this->session_list.Apply(response);
+    }
+
+    void HandleSessionListUpdateMessage(SessionListUpdateMessage &&update) {
+        this->session_list.Apply(update);
     }
 
     void HandleJoinSessionResponse(JoinSessionResponse &&response) {
@@ -80,7 +100,7 @@ public:
         }
     }
 
-    Array<SessionInfo> session_infos;
+    SessionList session_list;
     bool show_error_message;
 };
 
@@ -23,7 +23,7 @@ bool GetArg(const Array<String> &args, size_t i, T &out) {
         out = arg;
         return true;
     } else {
-        auto [p, ec] = std::from_chars(arg.begin(), arg.end(), out);
+        auto [p, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), out);
         return ec == std::errc{};
     }
 }
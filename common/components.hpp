@@ -64,6 +64,7 @@ struct CTank {
     constexpr static f32 BASE_HEIGHT = 30.0f;
     constexpr static f32 TURRET_HEIGHT = 40.0f;
     constexpr static f32 MAX_FUEL = 1000.0f;
+    constexpr static f32 MOVE_SPEED = 0.5f;
     constexpr static u32 ROTATE_TURRET_LEFT  = 1 << 0;
     constexpr static u32 ROTATE_TURRET_RIGHT = 1 << 1;
     f32 turret_rotation;
@@ -88,6 +89,7 @@ struct CProjectile {
     Entity firing_entity;
     Color color; // TODO only for debugging purposes
     f32 impact_damage = 0.0f;
+    Weapon::Type weapon_type = Weapon::Type::MACHINEGUN;
     f32 hit_radius = 40.0f;
     f32 radius = 7.0f;
 };
@@ -0,0 +1,211 @@
+#include "common/compression.hpp"
+
+constexpr size_t lz4_min_match = 4;
+constexpr size_t lz4_last_literals = 5; // The last 5 bytes of a block are always literals
+constexpr size_t lz4_match_find_limit = 12; // No match may start within the last 12 bytes
+constexpr size_t lz4_max_distance = 65535;
+constexpr u32 lz4_hash_log = 12;
+constexpr u32 lz4_skip_trigger = 6; // Search gets faster the longer we do not find a match
+
+static inline u32 Read32(const u8 *p) {
+    u32 value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline u32 Hash(u32 sequence) {
+    return (sequence * 2654435761u) >> (32 - lz4_hash_log);
+}
+
+static inline size_t GetLengthSize(size_t length) {
+    return length >= 15 ? (length - 15) / 255 + 1 : 0;
+}
+
+static inline void WriteLength(u8 *&out, size_t length) {
+    length -= 15;
+
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+
+    *out++ = static_cast<u8>(length);
+}
+
+static bool WriteSequence(
+    u8 *&out,
+    const u8 *out_end,
+    const u8 *literals,
+    size_t num_literals,
+    Optional<std::pair<size_t, size_t>> match) {
+    auto needed = 1 + GetLengthSize(num_literals) + num_literals;
+    auto match_length = match.has_value() ? match->second - lz4_min_match : 0;
+
+    if (match.has_value()) {
+        needed += 2 + GetLengthSize(match_length);
+    }
+
+    if (needed > static_cast<size_t>(out_end - out)) {
+        return false;
+    }
+
+    auto &token = *out++;
+    token = static_cast<u8>(std::min<size_t>(num_literals, 15) << 4);
+
+    if (num_literals >= 15) {
+        WriteLength(out, num_literals);
+    }
+
+    std::memcpy(out, literals, num_literals);
+    out += num_literals;
+
+    if (match.has_value()) {
+        auto offset = match->first;
+        *out++ = static_cast<u8>(offset & 0xFF);
+        *out++ = static_cast<u8>(offset >> 8);
+
+        token |= static_cast<u8>(std::min<size_t>(match_length, 15));
+
+        if (match_length >= 15) {
+            WriteLength(out, match_length);
+        }
+    }
+
+    return true;
+}
+
+size_t Lz4GetMaxCompressedSize(size_t input_size) {
+    return input_size + input_size / 255 + 16;
+}
+
+size_t Lz4Compress(const char *input, size_t input_size, char *output, size_t output_capacity) {
+    auto src = reinterpret_cast<const u8 *>(input);
+    auto out = reinterpret_cast<u8 *>(output);
+    auto out_end = out + output_capacity;
+
+    size_t anchor = 0;
+
+    if (input_size > lz4_match_find_limit) {
+        std::array<u32, 1 << lz4_hash_log> table{};
+
+        auto match_find_limit = input_size - lz4_match_find_limit;
+        auto match_extend_limit = input_size - lz4_last_literals;
+        size_t pos = 1;
+
+        while (pos < match_find_limit) {
+            auto sequence = Read32(src + pos);
+            auto hash = Hash(sequence);
+            size_t candidate = table[hash];
+            table[hash] = static_cast<u32>(pos);
+
+            if (pos - candidate > lz4_max_distance || Read32(src + candidate) != sequence) {
+                pos += 1 + ((pos - anchor) >> lz4_skip_trigger);
+                continue;
+            }
+
+            auto match_length = lz4_min_match;
+            while (pos + match_length < match_extend_limit && src[candidate + match_length] == src[pos + match_length]) {
+                ++match_length;
+            }
+
+            while (pos > anchor && candidate > 0 && src[pos - 1] == src[candidate - 1]) {
+                --pos;
+                --candidate;
+                ++match_length;
+            }
+
+            if (!WriteSequence(out, out_end, src + anchor, pos - anchor, std::make_pair(pos - candidate, match_length))) {
+                return 0;
+            }
+
+            pos += match_length;
+            anchor = pos;
+
+            if (pos < match_find_limit) {
+                table[Hash(Read32(src + pos - 2))] = static_cast<u32>(pos - 2);
+            }
+        }
+    }
+
+    if (!WriteSequence(out, out_end, src + anchor, input_size - anchor, std::nullopt)) {
+        return 0;
+    }
+
+    return out - reinterpret_cast<u8 *>(output);
+}
+
+bool Lz4Decompress(const char *input, size_t input_size, char *output, size_t output_size) {
+    auto in = reinterpret_cast<const u8 *>(input);
+    auto in_end = in + input_size;
+    auto out_begin = reinterpret_cast<u8 *>(output);
+    auto out = out_begin;
+    auto out_end = out + output_size;
+
+    auto read_length = [&](size_t &length) {
+        u8 value;
+
+        do {
+            if (in == in_end) {
+                return false;
+            }
+
+            value = *in++;
+            length += value;
+        } while (value == 255);
+
+        return true;
+    };
+
+    while (in < in_end) {
+        auto token = *in++;
+
+        size_t num_literals = token >> 4;
+        if (num_literals == 15 && !read_length(num_literals)) {
+            return false;
+        }
+
+        if (num_literals > static_cast<size_t>(in_end - in) || num_literals > static_cast<size_t>(out_end - out)) {
+            return false;
+        }
+
+        std::memcpy(out, in, num_literals);
+        in += num_literals;
+        out += num_literals;
+
+        if (in == in_end) {
+            break; // The last sequence has no match
+        }
+
+        if (in_end - in < 2) {
+            return false;
+        }
+
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+
+        if (offset == 0 || offset > static_cast<size_t>(out - out_begin)) {
+            return false;
+        }
+
+        size_t match_length = token & 0x0F;
+        if (match_length == 15 && !read_length(match_length)) {
+            return false;
+        }
+
+        match_length += lz4_min_match;
+
+        if (match_length > static_cast<size_t>(out_end - out)) {
+            return false;
+        }
+
+        // Byte-wise copy because the match may overlap with the output (offset < match_length)
+        auto match = out - offset;
+        for (size_t i = 0; i < match_length; ++i) {
+            out[i] = match[i];
+        }
+
+        out += match_length;
+    }
+
+    return out == out_end;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "common/common.hpp"
+
+// Fast byte-oriented LZ77 codec that produces the LZ4 block format
+// (token, literals, 16 bit offset, match length). Used for large messages
+// like the level snapshot and the session list, see TcpSocket::Push.
+
+size_t Lz4GetMaxCompressedSize(size_t input_size);
+
+// Returns the number of bytes written to output or 0 if the output did not fit.
+size_t Lz4Compress(const char *input, size_t input_size, char *output, size_t output_capacity);
+
+// Fails if the input is malformed or does not decompress to exactly output_size bytes.
+bool Lz4Decompress(const char *input, size_t input_size, char *output, size_t output_size);
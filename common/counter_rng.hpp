@@ -0,0 +1,63 @@
+#pragma once
+
+#include "common/common.hpp"
+
+// Counter based random number generator: the n-th number of a seed is a hash of the seed and
+// n, so the whole state is 12 bytes and anyone with the seed can reproduce a sequence (e.g.
+// the spread of a volley, see FireVolleyCommand) without having seen the numbers before it.
+//
+// The float helpers do not go through the standard distributions because their output is
+// implementation defined and the server and the clients have to agree on every bit.
+// Satisfies UniformRandomBitGenerator, so it can still be used with them where that does
+// not matter (e.g. for the level layout, which is only generated on the server).
+struct CounterRng {
+    using result_type = u32;
+
+    inline CounterRng() = default;
+
+    inline explicit CounterRng(u64 seed)
+        : seed(seed) {
+    }
+
+    inline void Seed(u64 seed) {
+        this->seed = seed;
+        this->counter = 0;
+    }
+
+    inline static u64 Hash(u64 seed, u64 counter) {
+        // NOTE(janh): SplitMix64 finalizer over the seed and the golden ratio scaled counter
+        auto x = seed + (counter + 1) * 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    inline u32 Next() {
+        return static_cast<u32>(Hash(this->seed, this->counter++) >> 32);
+    }
+
+    // In [0, 1)
+    inline f32 NextF32() {
+        return static_cast<f32>(this->Next() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // In [min, max)
+    inline f32 NextF32(f32 min, f32 max) {
+        return min + (max - min) * this->NextF32();
+    }
+
+    // In [min, max]
+    inline i32 NextI32(i32 min, i32 max) {
+        return min + static_cast<i32>(this->Next() % static_cast<u32>(max - min + 1));
+    }
+
+    constexpr static result_type min() { return 0; }
+    constexpr static result_type max() { return std::numeric_limits<u32>::max(); }
+
+    inline result_type operator()() {
+        return this->Next();
+    }
+
+    u64 seed = 0;
+    u32 counter = 0;
+};
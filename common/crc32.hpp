@@ -26,10 +26,14 @@ struct Crc32 {
 
     template<typename T>
     void Add(const T& data) {
+        this->AddData(&data, sizeof(T));
+    }
+
+    void AddData(const void *data, size_t size) {
         u32 c = this->value ^ 0xFFFFFFFF;
 
-        for (size_t i = 0; i < sizeof(T); ++i) {
-            c = Crc32::table[(c ^ reinterpret_cast<const u8 *>(&data)[i]) & 0xFF] ^ (c >> 8);
+        for (size_t i = 0; i < size; ++i) {
+            c = Crc32::table[(c ^ reinterpret_cast<const u8 *>(data)[i]) & 0xFF] ^ (c >> 8);
         }
 
         this->value = c ^ 0xFFFFFFFF;
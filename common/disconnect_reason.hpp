@@ -6,6 +6,7 @@ enum class DisconnectReason {
     INVALID,
     PROTO_ERR,
     KICK,
+    TOO_SLOW,
 };
 
 inline String ToString(DisconnectReason reason) {
@@ -14,6 +15,7 @@ inline String ToString(DisconnectReason reason) {
         case DisconnectReason::INVALID:   return "Invalid parameter";
         case DisconnectReason::PROTO_ERR: return "Protocol error";
         case DisconnectReason::KICK:      return "You were kicked";
+        case DisconnectReason::TOO_SLOW:  return "The connection was too slow";
         case DisconnectReason::NONE:
         default:                           return "(unknown)";
     }
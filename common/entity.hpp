@@ -36,6 +36,34 @@ struct EntityRegistry {
 #undef DECLARE_ALIAS_NOTEMPLATE
 #undef DECLARE_ALIAS_TEMPLATE
 
+    // Id of the first of count consecutive unused slots, the others are GetConsecutiveEntity(first, i).
+    // They all get the highest version any of the slots had, so none of them matches a stale
+    // reference to an entity that was destroyed.
+    inline Entity FindConsecutiveFreeEntities(u32 count) const {
+        using Traits = entt::entt_traits<Entity>;
+
+        auto num_slots = static_cast<u32>(this->impl.size());
+        u32 first = 0;
+        EntityId version = 0;
+
+        for (u32 index = 0; index < num_slots && index - first < count; ++index) {
+            auto current = static_cast<EntityId>(this->impl.current(Entity{index}));
+
+            if (this->impl.valid(Entity{(current << Traits::entity_shift) | index})) {
+                first = index + 1;
+                version = 0;
+            } else {
+                version = std::max(version, current);
+            }
+        }
+
+        return Entity{(version << Traits::entity_shift) | first};
+    }
+
+    inline static Entity GetConsecutiveEntity(Entity first, u32 offset) {
+        return Entity{entt::to_integral(first) + offset};
+    }
+
     entt::registry impl;
 };
 
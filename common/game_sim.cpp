@@ -7,8 +7,6 @@
 #if CLIENT
 #include "client/client.hpp"
 #include "client/client_game_state.hpp"
-#include "client/graphics/graphics_manager.hpp"
-#include <SDL.h>
 #endif // CLIENT
 
 #ifdef SERVER
@@ -22,12 +20,14 @@ void GameState::Tick(f32 dt) {
 
 #if CLIENT
     auto client_game_state = static_cast<ClientGameState *>(this);
+#if !HEADLESS
     client_game_state->cam.Update();
+#endif
 
     if (client_game_state->is_camera_locked) {
         client_game_state->cam.position =
             client_game_state->GetTankWorldPosition(client_game_state->my_tank.value()) -
-            GetGraphicsManager().GetWindowSize() / 2.0f;
+            client_game_state->GetViewSize() / 2.0f;
     }
 #endif // CLIENT
 
@@ -155,12 +155,7 @@ void GameState::Tick(f32 dt) {
                     command.target = entt::to_integral(tank_entity);
                     command.health = health.value;
                     command.max = health.max;
-
-                    GameCommandMessage message;
-                    Packet packet;
-                    message.Serialize(packet);
-                    this->SerializeCommand(command, packet);
-                    static_cast<ServerGameState *>(this)->session->BroadcastPacket(ToRvalue(packet));
+                    static_cast<ServerGameState *>(this)->BroadcastEntityCommand(tank_entity, command);
                 }
             });
 
@@ -204,26 +199,7 @@ void GameState::Tick(f32 dt) {
             }
         });
 
-#if 0
-    // Replicate entities
-    this->entities.view<Net_Replication_Component, Position_Component>().each([&](
-        Entity entity,
-        Net_Replication_Component &replication,
-        Position_Component &position) {
-            if (replication.last_replication + 30.0f < this->time) {
-                Set_Position_Command command;
-                command.target = entt::to_integral(entity);
-                command.position = position.value;
-                Game_Command_Message message;
-                Packet packet;
-                message.serialize(packet);
-                this->serialize_command(command, packet);
-                static_cast<Server_Game_State *>(this)->session->broadcast_packet(ToRvalue(packet));
-
-                replication.last_replication = this->time;
-            }
-        });
-#endif
+    // Entities are replicated per client by ServerGameState::ReplicateEntities
 
 #endif // SERVER
 }
@@ -4,174 +4,97 @@
 #include "common/log.hpp"
 #include <glm/glm.hpp>
 #include <algorithm>
-#include <random>
 
-void MoveTankCommand::Serialize(Packet &packet) const {
-    packet.WriteU32(this->entity);
-    packet.WriteF32(this->planet_position);
-    packet.WriteF32(this->velocity);
+void GameState::Serialize(Packet &packet) const {
+    packet.WriteU8(this->background_color.r);
+    packet.WriteU8(this->background_color.g);
+    packet.WriteU8(this->background_color.b);
+    packet.WriteU8(this->background_color.a);
+    packet.WriteF32(this->size.x);
+    packet.WriteF32(this->size.y);
+    SerializeEntities(this->entities, packet);
 }
 
-bool MoveTankCommand::Deserialize(Packet &packet) {
-    return
-        packet.ReadU32(this->entity) &&
-        packet.ReadF32(this->planet_position) &&
-        packet.ReadF32(this->velocity);
-}
-
-void RotateTurretCommand::Serialize(Packet &packet) const {
-    packet.WriteB8(this->is_absolute);
-    packet.WriteU32(this->entity);
-    packet.WriteF32(this->target_rotation);
-    packet.WriteU32(this->flags);
-}
-
-bool RotateTurretCommand::Deserialize(Packet &packet) {
-    return
-        packet.ReadB8(this->is_absolute) &&
-        packet.ReadU32(this->entity) &&
-        packet.ReadF32(this->target_rotation) &&
-        packet.ReadU32(this->flags);
-}
+u32 GameState::ComputeChecksum() const {
+    Packet packet;
+    this->Serialize(packet);
 
-void ChargeCommand::Serialize(Packet &packet) const {
-    packet.WriteU32(this->entity);
-    packet.WriteB8(this->fire);
+    Crc32 crc;
+    crc.AddData(packet.buffer.data() + sizeof(Packet_Header), packet.buffer.size() - sizeof(Packet_Header));
+    return crc.value;
 }
 
-bool ChargeCommand::Deserialize(Packet &packet) {
-    return
-        packet.ReadU32(this->entity) &&
-        packet.ReadB8(this->fire);
-}
-
-void SpawnProjectileCommand::Serialize(Packet &packet) const {
-    packet.WriteU32(this->target);
-    packet.WriteU32(this->firing_entity);
-    packet.WriteF32(this->position.x);
-    packet.WriteF32(this->position.y);
-    packet.WriteF32(this->velocity.x);
-    packet.WriteF32(this->velocity.y);
-    packet.WriteEnum(this->weapon_type);
-}
-
-bool SpawnProjectileCommand::Deserialize(Packet &packet) {
-    return
-        packet.ReadU32(this->target) &&
-        packet.ReadU32(this->firing_entity) &&
-        packet.ReadF32(this->position.x) &&
-        packet.ReadF32(this->position.y) &&
-        packet.ReadF32(this->velocity.x) &&
-        packet.ReadF32(this->velocity.y) &&
-        packet.ReadEnum(this->weapon_type);
-}
+void GameState::SerializeCommand(const GameCommand &command, Packet &packet) {
+    using Serializer = void (*)(const GameCommand &, Packet &);
 
-void DestroyEntityCommand::Serialize(Packet &packet) const {
-    packet.WriteU32(this->target);
-}
+    constexpr static auto serializers = GameCommands::MakeTable<Serializer>(
+        []<typename Command>() -> Serializer {
+            return [](const GameCommand &command, Packet &packet) {
+                static_cast<const Command &>(command).Serialize(packet);
+            };
+        });
 
-bool DestroyEntityCommand::Deserialize(Packet &packet) {
-    return
-        packet.ReadU32(this->target);
-}
+    packet.buffer.reserve(packet.buffer.size() + GameCommands::max_serialized_size);
+    packet.WriteEnum(command.type);
 
-void SetHealthCommand::Serialize(Packet &packet) const {
-    packet.WriteU32(this->target);
-    packet.WriteF32(this->health);
-    packet.WriteF32(this->max);
+    auto index = static_cast<size_t>(command.type);
+    assert(index < serializers.size() && serializers[index] != nullptr);
+    serializers[index](command, packet);
 }
 
-bool SetHealthCommand::Deserialize(Packet &packet) {
-    return
-        packet.ReadU32(this->target) &&
-        packet.ReadF32(this->health) &&
-        packet.ReadF32(this->max);
-}
+SendPolicy GameState::GetSendPolicy(const GameCommand &command) {
+    using PolicyGetter = SendPolicy (*)(const GameCommand &);
 
-void PlaySfxCommand::Serialize(Packet &packet) const {
-    packet.WriteEnum(this->sfx);
-}
+    constexpr static auto getters = GameCommands::MakeTable<PolicyGetter>(
+        []<typename Command>() -> PolicyGetter {
+            if constexpr (requires(const Command &command) { { command.GetSendPolicy() } -> std::same_as<SendPolicy>; }) {
+                return [](const GameCommand &command) {
+                    return static_cast<const Command &>(command).GetSendPolicy();
+                };
+            } else {
+                return nullptr;
+            }
+        });
 
-bool PlaySfxCommand::Deserialize(Packet &packet) {
-    return
-        packet.ReadEnum(this->sfx);
-}
+    auto index = static_cast<size_t>(command.type);
+    if (index >= getters.size() || getters[index] == nullptr) {
+        return SendPolicy{};
+    }
 
-void SetPositionCommand::Serialize(Packet &packet) const {
-    packet.WriteU32(this->target);
-    packet.WriteF32(this->position.x);
-    packet.WriteF32(this->position.y);
+    return getters[index](command);
 }
 
-bool SetPositionCommand::Deserialize(Packet &packet) {
-    return
-        packet.ReadU32(this->target) &&
-        packet.ReadF32(this->position.x) &&
-        packet.ReadF32(this->position.y);
-}
+// Validates the command at the read position of the packet without consuming it
+bool GameState::PeekCommand(Packet &packet, GameCommand::Type &type, SendPolicy &policy) {
+    using Peeker = bool (*)(Packet &, SendPolicy &);
 
-void SwitchWeaponCommand::Serialize(Packet &packet) const {
-    packet.WriteEnum(this->weapon_type);
-}
+    constexpr static auto peekers = GameCommands::MakeTable<Peeker>(
+        []<typename Command>() -> Peeker {
+            return [](Packet &packet, SendPolicy &policy) {
+                Command command;
+                if (!command.Deserialize(packet)) {
+                    return false;
+                }
 
-bool SwitchWeaponCommand::Deserialize(Packet &packet) {
-    return
-        packet.ReadEnum(this->weapon_type);
-}
+                policy = GameState::GetSendPolicy(command);
+                return true;
+            };
+        });
 
-bool GameState::HandleCommandPacket(const CommandContext &context, Packet &packet) {
-    GameCommand::Type type;
+    auto position = packet.position;
 
     if (!packet.ReadEnum(type)) {
         return false;
     }
 
-#define DO_COMMAND(type_id, command_type) \
-    case GameCommand::Type::type_id: { \
-        command_type command; \
-        if (!command.Deserialize(packet)) { \
-            return false; \
-        } \
-        return this->HandleCommand(context, command); \
-    } break; \
-
-    switch (type) {
-        DO_COMMAND(MOVE_TANK,        MoveTankCommand)
-        DO_COMMAND(ROTATE_TURRET,    RotateTurretCommand)
-        DO_COMMAND(CHARGE,           ChargeCommand)
-        DO_COMMAND(SPAWN_PROJECTILE, SpawnProjectileCommand)
-        DO_COMMAND(DESTROY_ENTITY,   DestroyEntityCommand)
-        DO_COMMAND(SET_HEALTH,       SetHealthCommand)
-        DO_COMMAND(PLAY_SFX,         PlaySfxCommand)
-        DO_COMMAND(SET_POSITION,     SetPositionCommand)
-        DO_COMMAND(SWITCH_WEAPON,    SwitchWeaponCommand)
-        default:
-            return false;
-    }
-#undef DO_COMMAND
-}
-
-void GameState::SerializeCommand(const GameCommand &command, Packet &packet) {
-    packet.WriteEnum(command.type);
+    auto index = static_cast<size_t>(type);
 
-#define DO_COMMAND(type_id, command_type) \
-    case GameCommand::Type::type_id: { \
-        auto cmd = static_cast<const command_type &>(command); \
-        cmd.Serialize(packet); \
-    } break; \
-
-    switch (command.type) {
-        DO_COMMAND(MOVE_TANK,        MoveTankCommand)
-        DO_COMMAND(ROTATE_TURRET,    RotateTurretCommand)
-        DO_COMMAND(CHARGE,           ChargeCommand)
-        DO_COMMAND(SPAWN_PROJECTILE, SpawnProjectileCommand)
-        DO_COMMAND(DESTROY_ENTITY,   DestroyEntityCommand)
-        DO_COMMAND(SET_HEALTH,       SetHealthCommand)
-        DO_COMMAND(PLAY_SFX,         PlaySfxCommand)
-        DO_COMMAND(SET_POSITION,     SetPositionCommand)
-        DO_COMMAND(SWITCH_WEAPON,    SwitchWeaponCommand)
+    if (index >= peekers.size() || peekers[index] == nullptr || !peekers[index](packet, policy)) {
+        return false;
     }
-#undef DO_COMMAND
+
+    packet.position = position;
+    return true;
 }
 
 Vec2 GameState::GetTankWorldPosition(Entity entity) const {
@@ -187,9 +110,8 @@ Vec2 GameState::GetTankWorldPosition(Entity entity) const {
                   glm::sin(glm::radians(planet_position.value))};
 }
 
-Array<Entity> GameState::Fire(Entity firing_tank, bool force) {
-    Array<Entity> res;
-
+// Spawns the projectiles right away, the returned volley lets the clients do the same
+Optional<FireVolleyCommand> GameState::Fire(Entity firing_tank, bool force) {
     auto &tank = this->entities.Get<CTank>(firing_tank);
     auto &weapon = g_weapons[static_cast<size_t>(tank.weapon_type)];
 
@@ -199,45 +121,65 @@ Array<Entity> GameState::Fire(Entity firing_tank, bool force) {
         charge = std::min(this->time - charging->start_time, weapon.MAX_CHARGE);
     } else if (!force) {
         //log_debug("wtf", "not charging");
-        return res;
+        return std::nullopt;
     }
 
     if (tank.last_fire_time + weapon.cooldown > this->time && !force) {
         //log_debug("wtf", "cooldown {}"_format(this->time - tank.last_fire_time + weapon.cooldown));
-        return res;
+        return std::nullopt;
     }
 
     tank.last_fire_time = this->time;
 
-    std::uniform_real_distribution dist_spread{-weapon.spread, weapon.spread};
-    std::uniform_real_distribution dist_speed_spread{-weapon.speed_spread, weapon.speed_spread};
-    std::uniform_real_distribution dist_bounce{0.0f, 1.0f};
+    FireVolleyCommand volley;
+    volley.firing_entity = entt::to_integral(firing_tank);
+    volley.first_projectile = entt::to_integral(this->entities.FindConsecutiveFreeEntities(weapon.burst));
+    volley.position = this->GetTankWorldPosition(firing_tank);
+    volley.turret_rotation = tank.turret_rotation;
+    volley.charge = charge;
+    volley.weapon_type = tank.weapon_type;
+    volley.seed = this->rng.Next();
+    this->SpawnVolley(volley);
 
-    for (size_t i = 0; i < weapon.burst; ++i) {
-        auto direction = glm::rotate(Vec2{0.0f, 1.0f}, -glm::radians(tank.turret_rotation + dist_spread(this->rng)));
+    //log_debug("wtf", "fire");
+
+    return volley;
+}
+
+Array<Entity> GameState::SpawnVolley(const FireVolleyCommand &volley) {
+    Array<Entity> res;
 
-        auto projectile = CreateEntity(this->entities, EntityPrefabId::PROJECTILE);
+    auto &weapon = g_weapons[static_cast<size_t>(volley.weapon_type)];
+    CounterRng rng{volley.seed};
 
-        if (dist_bounce(this->rng) >= 0.95) {
+    for (u32 i = 0; i < weapon.burst; ++i) {
+        auto spread = rng.NextF32(-weapon.spread, weapon.spread);
+        auto bounce = rng.NextF32();
+        auto speed_spread = rng.NextF32(-weapon.speed_spread, weapon.speed_spread);
+
+        auto direction = glm::rotate(Vec2{0.0f, 1.0f}, -glm::radians(volley.turret_rotation + spread));
+
+        auto id = EntityRegistry::GetConsecutiveEntity(Entity{volley.first_projectile}, i);
+        auto projectile = CreateEntity(this->entities, EntityPrefabId::PROJECTILE, id);
+
+        if (bounce >= 0.95f) {
             this->entities.Add<CProjectileBounce>(projectile);
         }
 
-        auto velocity = direction * (charge / weapon.MAX_CHARGE + 0.3f) / 1.3f * (weapon.speed + dist_speed_spread(this->rng));
-        auto position = this->GetTankWorldPosition(firing_tank);
+        auto velocity = direction * (volley.charge / weapon.MAX_CHARGE + 0.3f) / 1.3f * (weapon.speed + speed_spread);
 
-        this->entities.Get<CPosition>(projectile).value = position;
+        this->entities.Get<CPosition>(projectile).value = volley.position;
         this->entities.Get<CVelocity>(projectile).value = velocity;
         this->entities.Get<CMass>(projectile).value = weapon.projectile_mass;
         this->entities.Get<CTimeToLiveBeforeExplosion>(projectile).value = weapon.projectile_ttl;
         auto &projectile_component = this->entities.Get<CProjectile>(projectile);
-        projectile_component.firing_entity = firing_tank;
+        projectile_component.firing_entity = Entity{volley.firing_entity};
         projectile_component.impact_damage = weapon.damage;
+        projectile_component.weapon_type = volley.weapon_type;
 
         res.emplace_back(projectile);
     }
 
-    //log_debug("wtf", "fire");
-
     return res;
 }
 
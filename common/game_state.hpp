@@ -3,6 +3,13 @@
 #include "common/packet.hpp"
 #include "common/entity.hpp"
 #include "common/crc32.hpp"
+#include "common/counter_rng.hpp"
+#include "common/level.hpp"
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <tuple>
 
 struct ClientConnection;
 
@@ -18,6 +25,9 @@ public:
         PLAY_SFX         = 7,
         SET_POSITION     = 8,
         SWITCH_WEAPON    = 9,
+        SET_VIEW         = 10,
+        SPAWN_TANK       = 11,
+        FIRE_VOLLEY      = 12,
     };
 
     Type type;
@@ -25,22 +35,117 @@ public:
     inline explicit GameCommand(Type type) : type(type) {}
 };
 
-struct MoveTankCommand : public GameCommand {
-    inline MoveTankCommand() : GameCommand(GameCommand::Type::MOVE_TANK) {}
+inline StringView ToString(GameCommand::Type type) {
+    switch (type) {
+        case GameCommand::Type::MOVE_TANK:        return "MOVE_TANK";
+        case GameCommand::Type::ROTATE_TURRET:    return "ROTATE_TURRET";
+        case GameCommand::Type::CHARGE:           return "CHARGE";
+        case GameCommand::Type::SPAWN_PROJECTILE: return "SPAWN_PROJECTILE";
+        case GameCommand::Type::DESTROY_ENTITY:   return "DESTROY_ENTITY";
+        case GameCommand::Type::SET_HEALTH:       return "SET_HEALTH";
+        case GameCommand::Type::PLAY_SFX:         return "PLAY_SFX";
+        case GameCommand::Type::SET_POSITION:     return "SET_POSITION";
+        case GameCommand::Type::SWITCH_WEAPON:    return "SWITCH_WEAPON";
+        case GameCommand::Type::SET_VIEW:         return "SET_VIEW";
+        case GameCommand::Type::SPAWN_TANK:       return "SPAWN_TANK";
+        case GameCommand::Type::FIRE_VOLLEY:      return "FIRE_VOLLEY";
+        default:                                  return "(unknown)";
+    }
+}
+
+// Number of bytes a command field takes on the wire
+template<typename T>
+constexpr u32 GetSerializedFieldSize() {
+    if constexpr (std::is_same_v<T, Vec2>) {
+        return 2 * sizeof(f32);
+    } else {
+        static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>);
+        return sizeof(T);
+    }
+}
+
+template<typename T>
+void WriteCommandField(Packet &packet, const T &value) {
+    if constexpr (std::is_same_v<T, Vec2>) {
+        packet.WriteF32(value.x);
+        packet.WriteF32(value.y);
+    } else {
+        packet.WriteData(&value, sizeof(value));
+    }
+}
+
+template<typename T>
+bool ReadCommandField(Packet &packet, T &value) {
+    if constexpr (std::is_same_v<T, Vec2>) {
+        return packet.ReadF32(value.x) && packet.ReadF32(value.y);
+    } else {
+        return packet.ReadData(&value, sizeof(value));
+    }
+}
+
+// For commands that carry the complete state of one aspect of an entity, so a newer one makes an
+// older one that was not sent yet worthless
+inline SendPolicy MakeStatePolicy(GameCommand::Type type, EntityId entity) {
+    return SendPolicy{
+        .send_class = SendClass::STATE,
+        .key = (static_cast<u64>(type) << 32) | entity
+    };
+}
+
+// Base of all commands. The command lists its fields in a static Fields(self) function,
+// the serialization and the serialized size are generated from that list.
+// Commands that are not RELIABLE have a GetSendPolicy() const function.
+template<typename Derived, GameCommand::Type TypeId>
+struct GameCommandBase : public GameCommand {
+    constexpr static Type type_id = TypeId;
+
+    inline GameCommandBase() : GameCommand(TypeId) {}
+
+    void Serialize(Packet &packet) const {
+        std::apply(
+            [&](const auto &...fields) {
+                (WriteCommandField(packet, fields), ...);
+            },
+            Derived::Fields(static_cast<const Derived &>(*this)));
+    }
+
+    bool Deserialize(Packet &packet) {
+        return std::apply(
+            [&](auto &...fields) {
+                return (ReadCommandField(packet, fields) && ...);
+            },
+            Derived::Fields(static_cast<Derived &>(*this)));
+    }
+
+    constexpr static u32 GetSerializedSize() {
+        using FieldTypes = decltype(Derived::Fields(std::declval<Derived &>()));
+        return []<size_t... Indices>(std::index_sequence<Indices...>) {
+            return (0u + ... + GetSerializedFieldSize<std::remove_cvref_t<std::tuple_element_t<Indices, FieldTypes>>>());
+        }(std::make_index_sequence<std::tuple_size_v<FieldTypes>>{});
+    }
+};
 
-    void Serialize(Packet &packet) const;
-    bool Deserialize(Packet &packet);
+struct MoveTankCommand : public GameCommandBase<MoveTankCommand, GameCommand::Type::MOVE_TANK> {
+    template<typename Self>
+    static auto Fields(Self &self) { return std::tie(self.entity, self.planet_position, self.velocity); }
+
+    inline SendPolicy GetSendPolicy() const {
+        return MakeStatePolicy(type_id, this->entity);
+    }
 
     EntityId entity = 0;
     f32 planet_position = 0.0f;
     f32 velocity = 0.0f;
 };
 
-struct RotateTurretCommand : public GameCommand {
-    inline RotateTurretCommand() : GameCommand(GameCommand::Type::ROTATE_TURRET) {}
+struct RotateTurretCommand : public GameCommandBase<RotateTurretCommand, GameCommand::Type::ROTATE_TURRET> {
+    template<typename Self>
+    static auto Fields(Self &self) { return std::tie(self.is_absolute, self.entity, self.target_rotation, self.flags); }
 
-    void Serialize(Packet &packet) const;
-    bool Deserialize(Packet &packet);
+    // Relative rotations add up, only absolute ones can be superseded
+    inline SendPolicy GetSendPolicy() const {
+        return this->is_absolute ? MakeStatePolicy(type_id, this->entity) : SendPolicy{};
+    }
 
     bool is_absolute = true;
     EntityId entity = 0;
@@ -48,21 +153,17 @@ struct RotateTurretCommand : public GameCommand {
     u32 flags = 0;
 };
 
-struct ChargeCommand : public GameCommand {
-    inline ChargeCommand() : GameCommand(GameCommand::Type::CHARGE) {}
-
-    void Serialize(Packet &packet) const;
-    bool Deserialize(Packet &packet);
+struct ChargeCommand : public GameCommandBase<ChargeCommand, GameCommand::Type::CHARGE> {
+    template<typename Self>
+    static auto Fields(Self &self) { return std::tie(self.entity, self.fire); }
 
     EntityId entity = 0;
     bool fire = false;
 };
 
-struct SpawnProjectileCommand : public GameCommand {
-    inline SpawnProjectileCommand() : GameCommand(GameCommand::Type::SPAWN_PROJECTILE) {}
-
-    void Serialize(Packet &packet) const;
-    bool Deserialize(Packet &packet);
+struct SpawnProjectileCommand : public GameCommandBase<SpawnProjectileCommand, GameCommand::Type::SPAWN_PROJECTILE> {
+    template<typename Self>
+    static auto Fields(Self &self) { return std::tie(self.target, self.firing_entity, self.position, self.velocity, self.weapon_type); }
 
     EntityId target = 0;
     EntityId firing_entity = 0;
@@ -71,71 +172,172 @@ struct SpawnProjectileCommand : public GameCommand {
     Weapon::Type weapon_type;
 };
 
-struct DestroyEntityCommand : public GameCommand {
-    inline DestroyEntityCommand() : GameCommand(GameCommand::Type::DESTROY_ENTITY) {}
+// All projectiles of one shot. The receiver spawns them itself from the seed (see
+// GameState::SpawnVolley), projectile i gets the id GetConsecutiveEntity(first_projectile, i).
+struct FireVolleyCommand : public GameCommandBase<FireVolleyCommand, GameCommand::Type::FIRE_VOLLEY> {
+    template<typename Self>
+    static auto Fields(Self &self) {
+        return std::tie(self.firing_entity, self.first_projectile, self.position, self.turret_rotation, self.charge, self.weapon_type, self.seed);
+    }
 
-    void Serialize(Packet &packet) const;
-    bool Deserialize(Packet &packet);
+    EntityId firing_entity = 0;
+    EntityId first_projectile = 0;
+    Vec2 position{};
+    f32 turret_rotation = 0.0f;
+    f32 charge = 0.0f;
+    Weapon::Type weapon_type = Weapon::Type::MACHINEGUN;
+    u32 seed = 0;
+};
+
+struct DestroyEntityCommand : public GameCommandBase<DestroyEntityCommand, GameCommand::Type::DESTROY_ENTITY> {
+    template<typename Self>
+    static auto Fields(Self &self) { return std::tie(self.target); }
 
     EntityId target = 0;
 };
 
-struct SetHealthCommand : public GameCommand {
-    inline SetHealthCommand() : GameCommand(GameCommand::Type::SET_HEALTH) {}
+struct SetHealthCommand : public GameCommandBase<SetHealthCommand, GameCommand::Type::SET_HEALTH> {
+    template<typename Self>
+    static auto Fields(Self &self) { return std::tie(self.target, self.health, self.max); }
 
-    void Serialize(Packet &packet) const;
-    bool Deserialize(Packet &packet);
+    inline SendPolicy GetSendPolicy() const {
+        return MakeStatePolicy(type_id, this->target);
+    }
 
     EntityId target = 0;
     f32 health = 0.0f;
     f32 max = 0.0f;
 };
 
-struct PlaySfxCommand : public GameCommand {
+struct PlaySfxCommand : public GameCommandBase<PlaySfxCommand, GameCommand::Type::PLAY_SFX> {
     enum class Sfx {
         NONE,
         TANK_EXPLOSION,
         TANK_FIRE,
     };
 
-    inline PlaySfxCommand() : GameCommand(GameCommand::Type::PLAY_SFX) {}
+    template<typename Self>
+    static auto Fields(Self &self) { return std::tie(self.sfx); }
 
-    void Serialize(Packet &packet) const;
-    bool Deserialize(Packet &packet);
+    inline SendPolicy GetSendPolicy() const {
+        return SendPolicy{.send_class = SendClass::TRANSIENT};
+    }
 
     Sfx sfx = Sfx::NONE;
 };
 
-struct SetPositionCommand : public GameCommand {
-    inline SetPositionCommand() : GameCommand(GameCommand::Type::SET_POSITION) {}
+struct SetPositionCommand : public GameCommandBase<SetPositionCommand, GameCommand::Type::SET_POSITION> {
+    template<typename Self>
+    static auto Fields(Self &self) { return std::tie(self.target, self.position); }
 
-    void Serialize(Packet &packet) const;
-    bool Deserialize(Packet &packet);
+    inline SendPolicy GetSendPolicy() const {
+        return MakeStatePolicy(type_id, this->target);
+    }
 
     EntityId target = 0;
     Vec2 position{};
 };
 
-struct SwitchWeaponCommand : public GameCommand {
-    inline SwitchWeaponCommand() : GameCommand(GameCommand::Type::SWITCH_WEAPON) {}
+struct SwitchWeaponCommand : public GameCommandBase<SwitchWeaponCommand, GameCommand::Type::SWITCH_WEAPON> {
+    template<typename Self>
+    static auto Fields(Self &self) { return std::tie(self.weapon_type); }
 
-    void Serialize(Packet &packet) const;
-    bool Deserialize(Packet &packet);
+    inline SendPolicy GetSendPolicy() const {
+        return MakeStatePolicy(type_id, 0);
+    }
 
     Weapon::Type weapon_type = Weapon::Type::MACHINEGUN;
 };
 
+// Sent by the client when its camera moves to another sector
+struct SetViewCommand : public GameCommandBase<SetViewCommand, GameCommand::Type::SET_VIEW> {
+    template<typename Self>
+    static auto Fields(Self &self) { return std::tie(self.position); }
+
+    inline SendPolicy GetSendPolicy() const {
+        return MakeStatePolicy(type_id, 0);
+    }
+
+    Vec2 position{};
+};
+
+// Sent by the server when a tank enters the interest area of a client
+struct SpawnTankCommand : public GameCommandBase<SpawnTankCommand, GameCommand::Type::SPAWN_TANK> {
+    template<typename Self>
+    static auto Fields(Self &self) {
+        return std::tie(
+            self.target,
+            self.planet,
+            self.planet_position,
+            self.velocity,
+            self.turret_rotation,
+            self.target_turret_rotation,
+            self.flags,
+            self.fuel,
+            self.health,
+            self.max_health,
+            self.weapon_type);
+    }
+
+    EntityId target = 0;
+    EntityId planet = 0;
+    f32 planet_position = 0.0f;
+    f32 velocity = 0.0f;
+    f32 turret_rotation = 0.0f;
+    f32 target_turret_rotation = 0.0f;
+    u32 flags = 0;
+    f32 fuel = 0.0f;
+    f32 health = 0.0f;
+    f32 max_health = 0.0f;
+    Weapon::Type weapon_type = Weapon::Type::MACHINEGUN;
+};
+
+template<typename... Commands>
+struct GameCommandList {
+    constexpr static size_t table_size = std::max({static_cast<size_t>(Commands::type_id)...}) + 1;
+    constexpr static u32 max_serialized_size = sizeof(GameCommand::Type) + std::max({Commands::GetSerializedSize()...});
+
+    // A table indexed by GameCommand::Type with one entry per command, made by MakeEntry<Command>()
+    template<typename Entry, typename MakeEntry>
+    constexpr static std::array<Entry, table_size> MakeTable(MakeEntry make_entry) {
+        std::array<Entry, table_size> table{};
+        ((table[static_cast<size_t>(Commands::type_id)] = make_entry.template operator()<Commands>()), ...);
+        return table;
+    }
+};
+
+// Every command that can be sent. Adding a command here is enough to (de)serialize and dispatch it.
+using GameCommands = GameCommandList<
+    MoveTankCommand,
+    RotateTurretCommand,
+    ChargeCommand,
+    SpawnProjectileCommand,
+    DestroyEntityCommand,
+    SetHealthCommand,
+    PlaySfxCommand,
+    SetPositionCommand,
+    SwitchWeaponCommand,
+    SetViewCommand,
+    SpawnTankCommand,
+    FireVolleyCommand>;
+
 struct GameState {
     struct CommandContext {
         ClientConnection *con = nullptr;
     };
 
     void Tick(f32 dt);
-    void SerializeCommand(const GameCommand &command, Packet &packet);
-    bool HandleCommandPacket(const CommandContext &context, Packet &packet);
-    virtual bool HandleCommand(const CommandContext &context, GameCommand &command) = 0;
+    void Serialize(Packet &packet) const; // Everything but the time, see ClientGameState::Deserialize
+    u32 ComputeChecksum() const;
+    bool GenerateLevel(const LevelDescriptor &level, Array<Entity> &tanks);
+    static void SerializeCommand(const GameCommand &command, Packet &packet);
+    static SendPolicy GetSendPolicy(const GameCommand &command);
+    static bool PeekCommand(Packet &packet, GameCommand::Type &type, SendPolicy &policy);
+    template<typename State>
+    static bool DispatchCommandPacket(State &state, const CommandContext &context, Packet &packet);
     Vec2 GetTankWorldPosition(Entity entity) const;
-    Array<Entity> Fire(Entity firing_tank, bool force);
+    Optional<FireVolleyCommand> Fire(Entity firing_tank, bool force);
+    Array<Entity> SpawnVolley(const FireVolleyCommand &volley);
     Vec2 GetSunPosition() const;
     virtual void DestroyEntity(Entity entity) = 0;
     void Clone(GameState &target) const;
@@ -144,5 +346,39 @@ struct GameState {
     Color background_color;
     Vec2 size;
     f32 time = 0.0f;
-    std::mt19937 rng{std::random_device{}()};
+    CounterRng rng;
 };
+
+// A game state handles a command type if it has an OnCommand overload for it
+template<typename State, typename Command>
+concept HandlesCommand = requires(State &state, const GameState::CommandContext &context, Command &command) {
+    { state.OnCommand(context, command) } -> std::same_as<bool>;
+};
+
+// Calls State::HandleCommand with the concrete command type through a table that is built at compile time
+template<typename State>
+bool GameState::DispatchCommandPacket(State &state, const CommandContext &context, Packet &packet) {
+    using Handler = bool (*)(State &, const CommandContext &, Packet &);
+
+    constexpr static auto handlers = GameCommands::MakeTable<Handler>(
+        []<typename Command>() -> Handler {
+            return [](State &state, const CommandContext &context, Packet &packet) {
+                Command command;
+                return command.Deserialize(packet) && state.HandleCommand(context, command);
+            };
+        });
+
+    GameCommand::Type type;
+
+    if (!packet.ReadEnum(type)) {
+        return false;
+    }
+
+    auto index = static_cast<size_t>(type);
+
+    if (index >= handlers.size() || handlers[index] == nullptr) {
+        return false;
+    }
+
+    return handlers[index](state, context, packet);
+}
@@ -0,0 +1,98 @@
+#include "common/level.hpp"
+
+#include "common/game_state.hpp"
+#include "common/counter_rng.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+// Generator version 1
+constexpr static f32 planet_max_displacement = 170.0f;
+constexpr static f32 planet_min_mass = 17.0f;
+constexpr static f32 planet_max_mass = 32.0f;
+constexpr static f32 planet_min_radius = 70.0f;
+constexpr static f32 planet_max_radius = 120.0f;
+constexpr static f32 tank_health = 100.0f;
+
+LevelDescriptor MakeLevelDescriptor(u32 seed, size_t num_planets, size_t num_tanks) {
+    assert(num_tanks <= num_planets && num_planets <= LevelDescriptor::max_planets);
+
+    LevelDescriptor level;
+    level.seed = seed;
+    level.num_planets = static_cast<u16>(num_planets);
+    level.planet_grid_width = static_cast<u16>(std::ceil(std::sqrt(static_cast<f32>(num_planets))));
+    level.planet_padding = Vec2{300.0f, 300.0f};
+    level.planet_spacing = Vec2{480.0f, 480.0f};
+
+    Array<u16> planets(num_planets);
+    std::iota(planets.begin(), planets.end(), u16{0});
+
+    // NOTE(janh): Another stream than the one the generator uses, the spawns must not correlate with the planets
+    CounterRng rng{(u64{seed} << 32) | 0x5a5a5a5au};
+    std::shuffle(planets.begin(), planets.end(), rng);
+
+    level.tank_planets.assign(planets.begin(), planets.begin() + num_tanks);
+    return level;
+}
+
+// Fills an empty game state. Entities get consecutive ids starting with 0, planets first, then
+// the tanks in the order of the descriptor. Only CounterRng's own helpers are used so the
+// clients get the same numbers on every platform.
+bool GameState::GenerateLevel(const LevelDescriptor &level, Array<Entity> &tanks) {
+    if (level.generator_version != LevelDescriptor::current_generator_version ||
+        level.num_planets == 0 ||
+        level.num_planets > LevelDescriptor::max_planets ||
+        level.planet_grid_width == 0 ||
+        level.tank_planets.size() > level.num_planets) {
+        return false;
+    }
+
+    for (auto planet : level.tank_planets) {
+        if (planet >= level.num_planets) {
+            return false;
+        }
+    }
+
+    CounterRng rng{level.seed};
+
+    this->background_color = Color{
+        static_cast<u8>(rng.NextI32(4, 10)),
+        static_cast<u8>(rng.NextI32(4, 20)),
+        static_cast<u8>(rng.NextI32(20, 40)),
+        255
+    };
+
+    auto grid_width = static_cast<u32>(level.planet_grid_width);
+    Vec2 grid_size{grid_width, (level.num_planets + grid_width - 1) / grid_width};
+    this->size = 2.0f * level.planet_padding + grid_size * level.planet_spacing;
+
+    EntityId next_id = 0;
+    Array<Entity> planets;
+
+    for (u32 i = 0; i < level.num_planets; ++i) {
+        auto planet = CreateEntity(this->entities, EntityPrefabId::PLANET, Entity{next_id++});
+        planets.emplace_back(planet);
+
+        auto displacement = Vec2{
+            rng.NextF32(-planet_max_displacement, planet_max_displacement),
+            rng.NextF32(-planet_max_displacement, planet_max_displacement)
+        };
+        auto position = level.planet_padding + Vec2{i % grid_width, i / grid_width} * level.planet_spacing + displacement;
+        this->entities.Get<CPosition>(planet).value = position;
+        this->entities.Get<CMass>(planet).value = rng.NextF32(planet_min_mass, planet_max_mass);
+        this->entities.Get<CPlanet>(planet).radius = rng.NextF32(planet_min_radius, planet_max_radius);
+        this->entities.Get<CPlanet>(planet).initial_position = position;
+    }
+
+    for (auto planet : level.tank_planets) {
+        auto tank = CreateEntity(this->entities, EntityPrefabId::TANK, Entity{next_id++});
+        this->entities.Get<CTank>(tank).planet_id = planets[planet];
+        this->entities.Get<CPlanetPosition>(tank).value = rng.NextF32(0.0f, 360.0f);
+        auto &health = this->entities.Get<CHealth>(tank);
+        health.value = tank_health;
+        health.max = tank_health;
+        tanks.emplace_back(tank);
+    }
+
+    return true;
+}
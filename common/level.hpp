@@ -0,0 +1,65 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/packet.hpp"
+
+// Everything a level is generated from. The server sends this instead of the entities of the
+// level and the clients generate the same level from it (see GameState::GenerateLevel). The
+// generator must not change its output without a new generator version, old clients would
+// generate something else than the server.
+struct LevelDescriptor {
+    constexpr static u16 current_generator_version = 1;
+    constexpr static u16 max_planets = 1024;
+
+    inline void Serialize(Packet &packet) const {
+        packet.WriteU16(this->generator_version);
+        packet.WriteU32(this->seed);
+        packet.WriteU16(this->num_planets);
+        packet.WriteU16(this->planet_grid_width);
+        packet.WriteF32(this->planet_padding.x);
+        packet.WriteF32(this->planet_padding.y);
+        packet.WriteF32(this->planet_spacing.x);
+        packet.WriteF32(this->planet_spacing.y);
+        packet.WriteU16(static_cast<u16>(this->tank_planets.size()));
+
+        for (auto planet : this->tank_planets) {
+            packet.WriteU16(planet);
+        }
+    }
+
+    inline bool Deserialize(Packet &packet) {
+        u16 num_tanks;
+
+        if (!packet.ReadU16(this->generator_version) ||
+            !packet.ReadU32(this->seed) ||
+            !packet.ReadU16(this->num_planets) ||
+            !packet.ReadU16(this->planet_grid_width) ||
+            !packet.ReadF32(this->planet_padding.x) ||
+            !packet.ReadF32(this->planet_padding.y) ||
+            !packet.ReadF32(this->planet_spacing.x) ||
+            !packet.ReadF32(this->planet_spacing.y) ||
+            !packet.ReadU16(num_tanks)) {
+            return false;
+        }
+
+        this->tank_planets.resize(num_tanks);
+        for (auto &planet : this->tank_planets) {
+            if (!packet.ReadU16(planet)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    u16 generator_version = current_generator_version;
+    u32 seed = 0;
+    u16 num_planets = 0;
+    u16 planet_grid_width = 0;
+    Vec2 planet_padding{};
+    Vec2 planet_spacing{};
+    Array<u16> tank_planets; // Spawn planet of each tank, the tanks are created in this order
+};
+
+// A new level for the given number of tanks with every tank on another planet
+LevelDescriptor MakeLevelDescriptor(u32 seed, size_t num_planets, size_t num_tanks);
@@ -2,7 +2,7 @@
 
 #include <chrono>
 
-#ifdef CLIENT
+#if defined(CLIENT) && !HEADLESS
 #include "client/client.hpp"
 #include "client/console.hpp"
 #endif
@@ -22,7 +22,7 @@ static void DoLog(
     auto time = chrono::system_clock::to_time_t(chrono::system_clock::now());
     auto time_string = fmt::format(
         "{:%H:%M:%S}.{:#03}",
-        *std::localtime(&time),
+        fmt::localtime(time), // Unlike std::localtime safe to call from the network thread
         (chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()) % 1000).count());
 
 #if 0
@@ -30,12 +30,11 @@ static void DoLog(
     fmt::print(tag_style, "{} [{}] "_format(label, tag));
     fmt::print(message_style, "{}\n"_format(fmt_escape(message)));
 #else
-    fmt::print("{} "_format(time_string));
-    fmt::print("{} [{}] "_format(label, tag));
-    fmt::print("{}\n"_format(FmtEscape(message)));
+    // One call per line, the client's network thread logs too
+    fmt::print("{} {} [{}] {}\n"_format(time_string, label, tag, FmtEscape(message)));
 #endif
 
-#ifdef CLIENT
+#if defined(CLIENT) && !HEADLESS
     auto full_text = "{} {} [{}] {}"_format(time_string, label, tag, message);
 
     Color default_color{150, 150, 250, 255};
@@ -0,0 +1,140 @@
+#include "common/mapped_file.hpp"
+
+#include "common/log.hpp"
+
+#ifdef WINDOWS
+#	include <Windows.h>
+#else
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    this->Close();
+}
+
+#ifdef WINDOWS
+bool MappedFile::Open(StringView filename) {
+    this->Close();
+
+    this->file = CreateFileA(String{filename}.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (this->file == INVALID_HANDLE_VALUE) {
+        this->file = nullptr;
+        LogError("mapped_file", "Cannot open {}"_format(filename));
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(this->file, &file_size)) {
+        LogError("mapped_file", "Cannot get the size of {}"_format(filename));
+        this->Close();
+        return false;
+    }
+
+    this->size = static_cast<size_t>(file_size.QuadPart);
+    if (this->size == 0) {
+        return true;
+    }
+
+    this->mapping = CreateFileMappingA(this->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (this->mapping == nullptr) {
+        LogError("mapped_file", "Cannot map {}"_format(filename));
+        this->Close();
+        return false;
+    }
+
+    this->data = static_cast<const char *>(MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0));
+    if (this->data == nullptr) {
+        LogError("mapped_file", "Cannot map {}"_format(filename));
+        this->Close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::Close() {
+    if (this->data != nullptr) {
+        UnmapViewOfFile(this->data);
+    }
+
+    if (this->mapping != nullptr) {
+        CloseHandle(this->mapping);
+    }
+
+    if (this->file != nullptr) {
+        CloseHandle(this->file);
+    }
+
+    this->data = nullptr;
+    this->mapping = nullptr;
+    this->file = nullptr;
+    this->size = 0;
+}
+
+void MappedFile::ReleaseBefore(size_t offset) {
+    // Windows trims the working set of mapped files by itself
+}
+#else
+bool MappedFile::Open(StringView filename) {
+    this->Close();
+
+    this->fd = ::open(String{filename}.c_str(), O_RDONLY);
+    if (this->fd == -1) {
+        LogError("mapped_file", "Cannot open {}: {}"_format(filename, strerror(errno)));
+        return false;
+    }
+
+    struct stat file_stat;
+    if (::fstat(this->fd, &file_stat) == -1) {
+        LogError("mapped_file", "Cannot stat {}: {}"_format(filename, strerror(errno)));
+        this->Close();
+        return false;
+    }
+
+    this->size = static_cast<size_t>(file_stat.st_size);
+    if (this->size == 0) {
+        return true;
+    }
+
+    auto address = ::mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, this->fd, 0);
+    if (address == MAP_FAILED) {
+        LogError("mapped_file", "Cannot map {}: {}"_format(filename, strerror(errno)));
+        this->Close();
+        return false;
+    }
+
+    this->data = static_cast<const char *>(address);
+    ::madvise(address, this->size, MADV_SEQUENTIAL);
+    return true;
+}
+
+void MappedFile::Close() {
+    if (this->data != nullptr) {
+        ::munmap(const_cast<char *>(this->data), this->size);
+    }
+
+    if (this->fd != -1) {
+        ::close(this->fd);
+    }
+
+    this->data = nullptr;
+    this->fd = -1;
+    this->size = 0;
+}
+
+void MappedFile::ReleaseBefore(size_t offset) {
+    if (this->data == nullptr) {
+        return;
+    }
+
+    auto page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    auto length = std::min(offset, this->size) / page_size * page_size;
+
+    if (length > 0) {
+        ::madvise(const_cast<char *>(this->data), length, MADV_DONTNEED);
+    }
+}
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "common/common.hpp"
+
+// Read-only memory mapping of a whole file. Pages are loaded on demand, so files that
+// are much larger than the available memory can be streamed from front to back.
+struct MappedFile {
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    bool Open(StringView filename);
+    void Close();
+    void ReleaseBefore(size_t offset); // Hint that the pages before offset will not be read again
+
+    const char *data = nullptr;
+    size_t size = 0;
+
+#ifdef WINDOWS
+    void *file = nullptr;
+    void *mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
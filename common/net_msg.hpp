@@ -5,6 +5,8 @@
 #include "common/packet.hpp"
 #include "common/player_info.hpp"
 #include "common/disconnect_reason.hpp"
+#include "common/player_input.hpp"
+#include "common/level.hpp"
 
 #include <variant>
 
@@ -25,9 +27,81 @@ enum class NetMessageType : u8 {
     PAUSE_GAME           = 14,
     LOBBY_UPDATE         = 15,
     DISCONNECT           = 16,
+    INPUT_BUNDLE         = 17,
+    INPUT_ACK            = 18,
+    SESSION_LIST_UPDATE  = 19,
+    REQUEST_LEVEL        = 20,
+    CLOCK_SYNC           = 21,
     COUNT
 };
 
+inline StringView ToString(NetMessageType type) {
+    switch (type) {
+        case NetMessageType::HANDSHAKE:           return "HANDSHAKE";
+        case NetMessageType::PING:                return "PING";
+        case NetMessageType::PONG:                return "PONG";
+        case NetMessageType::GET_SESSION_INFO:    return "GET_SESSION_INFO";
+        case NetMessageType::CREATE_SESSION:      return "CREATE_SESSION";
+        case NetMessageType::JOIN_SESSION:        return "JOIN_SESSION";
+        case NetMessageType::LEAVE_SESSION:       return "LEAVE_SESSION";
+        case NetMessageType::READY:               return "READY";
+        case NetMessageType::GAME_STARTED:        return "GAME_STARTED";
+        case NetMessageType::LOAD_LEVEL:          return "LOAD_LEVEL";
+        case NetMessageType::GAME_COMMAND:        return "GAME_COMMAND";
+        case NetMessageType::SHUTDOWN:            return "SHUTDOWN";
+        case NetMessageType::SET_TICK_LENGTH:     return "SET_TICK_LENGTH";
+        case NetMessageType::PAUSE_GAME:          return "PAUSE_GAME";
+        case NetMessageType::LOBBY_UPDATE:        return "LOBBY_UPDATE";
+        case NetMessageType::DISCONNECT:          return "DISCONNECT";
+        case NetMessageType::INPUT_BUNDLE:        return "INPUT_BUNDLE";
+        case NetMessageType::INPUT_ACK:           return "INPUT_ACK";
+        case NetMessageType::SESSION_LIST_UPDATE: return "SESSION_LIST_UPDATE";
+        case NetMessageType::REQUEST_LEVEL:       return "REQUEST_LEVEL";
+        case NetMessageType::CLOCK_SYNC:          return "CLOCK_SYNC";
+        default:                                  return "(unknown)";
+    }
+}
+
+// A client's answer to a server timestamp, used by the server to estimate the round trip
+// time and the client's clock offset (see ClockSync). The timestamps arrive with input acks
+// or pings and the answer rides along with the next input bundle if there is one.
+struct TimeEcho {
+    f32 server_time = 0.0f; // The server time that is echoed
+    f32 client_time = 0.0f; // The client's time when it received the server time
+    f32 hold_time = 0.0f; // How long the client held the echo back before sending it
+
+    inline void Serialize(Packet &packet) const {
+        packet.WriteF32(this->server_time);
+        packet.WriteF32(this->client_time);
+        packet.WriteF32(this->hold_time);
+    }
+
+    inline bool Deserialize(Packet &packet) {
+        return
+            packet.ReadF32(this->server_time) &&
+            packet.ReadF32(this->client_time) &&
+            packet.ReadF32(this->hold_time);
+    }
+};
+
+// What the server did with a traced input, sent back with its InputAckMessage. The client
+// has the other timestamps of the input's way to the screen (see InputLatencyTracer).
+struct InputLatencyTiming {
+    u32 tick = 0; // The session tick that applied the input
+    u32 queued_us = 0; // From receiving the input until that tick applied it
+
+    inline void Serialize(Packet &packet) const {
+        packet.WriteU32(this->tick);
+        packet.WriteU32(this->queued_us);
+    }
+
+    inline bool Deserialize(Packet &packet) {
+        return
+            packet.ReadU32(this->tick) &&
+            packet.ReadU32(this->queued_us);
+    }
+};
+
 template<NetMessageType TheType>
 struct NetMessage {
     constexpr static NetMessageType Type = TheType;
@@ -38,9 +112,35 @@ struct NetMessage {
 };
 
 struct HandshakeRequest : public NetMessage<NetMessageType::HANDSHAKE> {
+    // Joins a lobby in the same round trip as the handshake. The server answers with the
+    // HandshakeResponse and the JoinSessionResponse back to back, the client skips the
+    // session browser if the join succeeded.
+    struct FastJoin {
+        constexpr static u16 any_session = 0xffff; // The fullest open lobby with the given password (none for public lobbies)
+
+        u16 session_id = any_session;
+        String player_name;
+        String password;
+
+        inline void Serialize(Packet &packet) const {
+            packet.WriteU16(this->session_id);
+            packet.WriteString(this->player_name);
+            packet.WriteString(this->password);
+        }
+
+        inline bool Deserialize(Packet &packet) {
+            return
+                packet.ReadU16(this->session_id) &&
+                packet.ReadString(this->player_name) &&
+                packet.ReadString(this->password);
+        }
+    };
+
     u16 ver_major;
     u16 ver_minor;
     u16 ver_build;
+    bool supports_compression = false;
+    Optional<FastJoin> fast_join;
 
     inline void Serialize(Packet &packet) const {
         NetMessage::Serialize(packet);
@@ -48,13 +148,30 @@ struct HandshakeRequest : public NetMessage<NetMessageType::HANDSHAKE> {
         packet.WriteU16(this->ver_major);
         packet.WriteU16(this->ver_minor);
         packet.WriteU16(this->ver_build);
+        packet.WriteB8(this->supports_compression);
+        packet.WriteB8(this->fast_join.has_value());
+
+        if (this->fast_join.has_value()) {
+            this->fast_join->Serialize(packet);
+        }
     }
 
     inline bool Deserialize(Packet &packet) {
-        return
-            packet.ReadU16(this->ver_major) &&
-            packet.ReadU16(this->ver_minor) &&
-            packet.ReadU16(this->ver_build);
+        b8 has_fast_join;
+
+        if (!packet.ReadU16(this->ver_major) ||
+            !packet.ReadU16(this->ver_minor) ||
+            !packet.ReadU16(this->ver_build) ||
+            !packet.ReadB8(this->supports_compression) ||
+            !packet.ReadB8(has_fast_join)) {
+            return false;
+        }
+
+        if (has_fast_join) {
+            return this->fast_join.emplace().Deserialize(packet);
+        }
+
+        return true;
     }
 };
 
@@ -63,6 +180,7 @@ struct HandshakeResponse : public NetMessage<NetMessageType::HANDSHAKE> {
     u16 ver_minor;
     u16 ver_build;
     bool ok;
+    bool compression = false; // Both sides compress large packets from now on
 
     inline void Serialize(Packet &packet) const {
         NetMessage::Serialize(packet);
@@ -71,6 +189,7 @@ struct HandshakeResponse : public NetMessage<NetMessageType::HANDSHAKE> {
         packet.WriteU16(this->ver_minor);
         packet.WriteU16(this->ver_build);
         packet.WriteB8(this->ok);
+        packet.WriteB8(this->compression);
     }
 
     inline bool Deserialize(Packet &packet) {
@@ -78,7 +197,8 @@ struct HandshakeResponse : public NetMessage<NetMessageType::HANDSHAKE> {
             packet.ReadU16(this->ver_major) &&
             packet.ReadU16(this->ver_minor) &&
             packet.ReadU16(this->ver_build) &&
-            packet.ReadB8(this->ok);
+            packet.ReadB8(this->ok) &&
+            packet.ReadB8(this->compression);
     }
 };
 
@@ -96,67 +216,149 @@ struct PingMessage : public NetMessage<NetMessageType::PING> {
     }
 };
 
+// Only sent if there is no input bundle that could carry the echo
 struct PongMessage : public NetMessage<NetMessageType::PONG> {
-    f32 my_time = -123.45f; // The recipient time at the arrival of the corresponding ping message (The client's time when receiving the ping)
-    f32 your_time = -123.45f; // The time that was sent with the ping message (The server's time when sending the ping)
+    TimeEcho echo;
 
     inline void Serialize(Packet& packet) const {
         NetMessage::Serialize(packet);
 
-        packet.WriteF32(this->my_time);
-        packet.WriteF32(this->your_time);
+        this->echo.Serialize(packet);
     }
 
     inline bool Deserialize(Packet& packet) {
-        return
-            packet.ReadF32(this->my_time) &&
-            packet.ReadF32(this->your_time);
+        return this->echo.Deserialize(packet);
     }
 };
 
+// Lists one page of the sessions that match the filter. The response to a request without
+// page and filter is cached by the server, so that is the cheapest way to get everything.
 struct GetSessionInfoRequest : public NetMessage<NetMessageType::GET_SESSION_INFO> {
+    u16 first = 0; // Index of the first matching session on the page
+    u16 max_sessions = 0; // Page size, 0 for all matching sessions
+    SessionFilter filter;
+    b8 subscribe = false; // Receive a SessionListUpdateMessage whenever sessions change until leaving the session browser
+
+    inline bool IsUnfiltered() const {
+        return this->first == 0 && this->max_sessions == 0 && this->filter.IsEmpty();
+    }
+
     inline void Serialize(Packet &packet) const {
         NetMessage::Serialize(packet);
+
+        packet.WriteU16(this->first);
+        packet.WriteU16(this->max_sessions);
+        packet.WriteU8(this->filter.flags);
+        packet.WriteString(this->filter.name_prefix);
+        packet.WriteB8(this->subscribe);
     }
 
     inline bool Deserialize(Packet &packet) {
-        return true;
+        return
+            packet.ReadU16(this->first) &&
+            packet.ReadU16(this->max_sessions) &&
+            packet.ReadU8(this->filter.flags) &&
+            packet.ReadString(this->filter.name_prefix) &&
+            packet.ReadB8(this->subscribe);
     }
 };
 
 struct GetSessionInfoResponse : public NetMessage<NetMessageType::GET_SESSION_INFO> {
+    u16 num_matching = 0; // Matching sessions on all pages
+    u16 first = 0;
     Array<SessionInfo> sessions;
 
+    static inline void SerializeEntry(Packet &packet, const SessionInfo &info) {
+        packet.WriteString(info.name);
+        packet.WriteU16(info.id);
+        packet.WriteU16(info.nplayers);
+        packet.WriteU16(info.nplayers_connected);
+        packet.WriteEnum(info.state);
+        packet.WriteB8(info.haspw);
+    }
+
+    static inline bool DeserializeEntry(Packet &packet, SessionInfo &info) {
+        return
+            packet.ReadString(info.name) &&
+            packet.ReadU16(info.id) &&
+            packet.ReadU16(info.nplayers) &&
+            packet.ReadU16(info.nplayers_connected) &&
+            packet.ReadEnum(info.state) &&
+            packet.ReadB8(info.haspw);
+    }
+
     inline void Serialize(Packet &packet) const {
         NetMessage::Serialize(packet);
 
+        packet.WriteU16(this->num_matching);
+        packet.WriteU16(this->first);
         packet.WriteU16(this->sessions.size());
 
         for (const auto &info : this->sessions) {
-            packet.WriteString(info.name);
-            packet.WriteU16(info.id);
-            packet.WriteU16(info.nplayers);
-            packet.WriteU16(info.nplayers_connected);
-            packet.WriteEnum(info.state);
-            packet.WriteB8(info.haspw);
+            SerializeEntry(packet, info);
         }
     }
 
     inline bool Deserialize(Packet &packet) {
         u16 num_sessions;
-        if (!packet.ReadU16(num_sessions)) {
+        if (!packet.ReadU16(this->num_matching) ||
+            !packet.ReadU16(this->first) ||
+            !packet.ReadU16(num_sessions)) {
             return false;
         }
 
         this->sessions.resize(num_sessions);
 
         for (auto &info : this->sessions) {
-            if (!packet.ReadString(info.name) ||
-                !packet.ReadU16(info.id) ||
-                !packet.ReadU16(info.nplayers) ||
-                !packet.ReadU16(info.nplayers_connected) ||
-                !packet.ReadEnum(info.state) ||
-                !packet.ReadB8(info.haspw)) {
+            if (!DeserializeEntry(packet, info)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+
+// Pushed to subscribed session browsers, contains every session that changed since the last update
+struct SessionListUpdateMessage : public NetMessage<NetMessageType::SESSION_LIST_UPDATE> {
+    Array<SessionInfo> updated; // Created or changed
+    Array<u16> removed;
+
+    inline void Serialize(Packet &packet) const {
+        NetMessage::Serialize(packet);
+
+        packet.WriteU16(this->updated.size());
+        for (const auto &info : this->updated) {
+            GetSessionInfoResponse::SerializeEntry(packet, info);
+        }
+
+        packet.WriteU16(this->removed.size());
+        for (auto id : this->removed) {
+            packet.WriteU16(id);
+        }
+    }
+
+    inline bool Deserialize(Packet &packet) {
+        u16 num_updated;
+        if (!packet.ReadU16(num_updated)) {
+            return false;
+        }
+
+        this->updated.resize(num_updated);
+        for (auto &info : this->updated) {
+            if (!GetSessionInfoResponse::DeserializeEntry(packet, info)) {
+                return false;
+            }
+        }
+
+        u16 num_removed;
+        if (!packet.ReadU16(num_removed)) {
+            return false;
+        }
+
+        this->removed.resize(num_removed);
+        for (auto &id : this->removed) {
+            if (!packet.ReadU16(id)) {
                 return false;
             }
         }
@@ -298,7 +500,31 @@ struct GameStartedMessage : public NetMessage<NetMessageType::GAME_STARTED> {
     }
 };
 
+// The clients generate the level from the descriptor and compare the checksum of the result.
+// If it does not match they send a RequestLevelMessage and get the complete state, which
+// follows the message if has_snapshot is set (see GameState::Serialize).
 struct LoadLevelMessage : public NetMessage<NetMessageType::LOAD_LEVEL> {
+    LevelDescriptor level;
+    u32 checksum = 0;
+    b8 has_snapshot = false;
+
+    inline void Serialize(Packet &packet) const {
+        NetMessage::Serialize(packet);
+
+        this->level.Serialize(packet);
+        packet.WriteU32(this->checksum);
+        packet.WriteB8(this->has_snapshot);
+    }
+
+    inline bool Deserialize(Packet &packet) {
+        return
+            this->level.Deserialize(packet) &&
+            packet.ReadU32(this->checksum) &&
+            packet.ReadB8(this->has_snapshot);
+    }
+};
+
+struct RequestLevelMessage : public NetMessage<NetMessageType::REQUEST_LEVEL> {
     inline void Serialize(Packet &packet) const {
         NetMessage::Serialize(packet);
     }
@@ -346,6 +572,28 @@ struct SetTickLengthMessage: public NetMessage<NetMessageType::SET_TICK_LENGTH>
     }
 };
 
+// The server's estimate after every clock sample, only shown to the player (see NetGraph)
+struct ClockSyncMessage : public NetMessage<NetMessageType::CLOCK_SYNC> {
+    f32 rtt = 0.0f; // Ticks, see ClockSync
+    f32 last_rtt = 0.0f;
+    f32 offset = 0.0f;
+
+    inline void Serialize(Packet &packet) const {
+        NetMessage::Serialize(packet);
+
+        packet.WriteF32(this->rtt);
+        packet.WriteF32(this->last_rtt);
+        packet.WriteF32(this->offset);
+    }
+
+    inline bool Deserialize(Packet &packet) {
+        return
+            packet.ReadF32(this->rtt) &&
+            packet.ReadF32(this->last_rtt) &&
+            packet.ReadF32(this->offset);
+    }
+};
+
 struct PauseGameMessage : public NetMessage<NetMessageType::PAUSE_GAME> {
     bool paused;
 
@@ -467,3 +715,114 @@ struct DisconnectMessage : public NetMessage<NetMessageType::DISCONNECT> {
             packet.ReadString(this->message);
     }
 };
+
+// Sent by the client once per tick if its input changed. Contains the newest input and
+// the last few inputs that have not been acknowledged yet, oldest first.
+struct InputBundleMessage : public NetMessage<NetMessageType::INPUT_BUNDLE> {
+    constexpr static size_t max_inputs = 4;
+
+    Array<PlayerInput> inputs;
+    Optional<TimeEcho> echo;
+    b8 trace_latency = false; // The ack of the newest input should carry an InputLatencyTiming
+
+    inline void Serialize(Packet &packet) const {
+        NetMessage::Serialize(packet);
+
+        packet.WriteU8(this->inputs.size());
+
+        for (const auto &input : this->inputs) {
+            input.Serialize(packet);
+        }
+
+        packet.WriteB8(this->echo.has_value());
+
+        if (this->echo.has_value()) {
+            this->echo.value().Serialize(packet);
+        }
+
+        packet.WriteB8(this->trace_latency);
+    }
+
+    inline bool Deserialize(Packet &packet) {
+        u8 num_inputs;
+        if (!packet.ReadU8(num_inputs) || num_inputs > max_inputs) {
+            return false;
+        }
+
+        this->inputs.resize(num_inputs);
+
+        for (auto &input : this->inputs) {
+            if (!input.Deserialize(packet)) {
+                return false;
+            }
+        }
+
+        b8 has_echo;
+        if (!packet.ReadB8(has_echo)) {
+            return false;
+        }
+
+        if (has_echo) {
+            if (!this->echo.emplace().Deserialize(packet)) {
+                return false;
+            }
+        } else {
+            this->echo.reset();
+        }
+
+        return packet.ReadB8(this->trace_latency);
+    }
+};
+
+// Sent by the server after it applied the inputs of a client. The game commands the inputs
+// caused were queued before it, so the client has their effects once the ack arrives.
+struct InputAckMessage : public NetMessage<NetMessageType::INPUT_ACK> {
+    u32 sequence = 0; // The sequence number of the last applied input
+    Optional<f32> server_time; // Only set if the server wants a clock sample (see TimeEcho)
+    Optional<InputLatencyTiming> timing; // Only set if the bundle asked for it
+
+    inline void Serialize(Packet &packet) const {
+        NetMessage::Serialize(packet);
+
+        packet.WriteU32(this->sequence);
+        packet.WriteB8(this->server_time.has_value());
+
+        if (this->server_time.has_value()) {
+            packet.WriteF32(this->server_time.value());
+        }
+
+        packet.WriteB8(this->timing.has_value());
+
+        if (this->timing.has_value()) {
+            this->timing.value().Serialize(packet);
+        }
+    }
+
+    inline bool Deserialize(Packet &packet) {
+        b8 has_server_time;
+
+        if (!packet.ReadU32(this->sequence) || !packet.ReadB8(has_server_time)) {
+            return false;
+        }
+
+        if (has_server_time) {
+            if (!packet.ReadF32(this->server_time.emplace())) {
+                return false;
+            }
+        } else {
+            this->server_time.reset();
+        }
+
+        b8 has_timing;
+        if (!packet.ReadB8(has_timing)) {
+            return false;
+        }
+
+        if (has_timing) {
+            return this->timing.emplace().Deserialize(packet);
+        }
+
+        this->timing.reset();
+        return true;
+    }
+};
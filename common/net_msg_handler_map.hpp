@@ -3,6 +3,7 @@
 #include "common/common.hpp"
 #include "common/packet.hpp"
 #include "common/net_msg.hpp"
+#include "common/net_msg_view.hpp"
 
 struct NetMessageHandlerMap {
     bool HandlePacket(Packet &&client_packet);
@@ -22,6 +23,23 @@ struct NetMessageHandlerMap {
             });
     }
 
+    // Handlers that take a view get the message without it being copied out of the packet
+    template<typename View, typename That>
+    void Add(void (That::*callback)(const View &), That *that) {
+        this->net_message_handlers.emplace(
+            View::Type,
+            [callback, that](Packet &&packet) {
+                View view;
+
+                if (!view.Parse(packet)) {
+                    packet.valid = false; // Makes HandlePacket fail
+                    return;
+                }
+
+                (that->*callback)(view);
+            });
+    }
+
     template<NetMessageType Type, typename That>
     void Add(void (That::*callback)(Packet &&), That *that) {
         this->net_message_handlers.emplace(
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/net_msg.hpp"
+
+// Read-only views over received messages. Parse validates the whole message once and
+// remembers where the fields are, the getters then read straight from the packet buffer.
+// Strings are StringViews into the buffer, so a view and everything it returns is only
+// valid while the packet is alive. Handlers that need to keep something have to copy it.
+//
+// Only the messages that would otherwise allocate on every receive have a view.
+template<typename Message>
+struct NetMessageView {
+    constexpr static NetMessageType Type = Message::Type;
+
+    const Packet *packet = nullptr;
+};
+
+struct CreateSessionRequestView : public NetMessageView<CreateSessionRequest> {
+    inline bool Parse(Packet &packet) {
+        this->packet = &packet;
+        this->offset = packet.position;
+
+        return
+            packet.SkipData(sizeof(u16) + sizeof(u16)) &&
+            packet.ReadStringView(this->name) &&
+            packet.ReadStringView(this->password) &&
+            packet.ReadStringView(this->player_name);
+    }
+
+    inline u16 GetNumPlayers() const { return this->packet->ReadAt<u16>(this->offset); }
+    inline u16 GetNumBots() const    { return this->packet->ReadAt<u16>(this->offset + sizeof(u16)); }
+
+    u32 offset = 0;
+    StringView name;
+    StringView password;
+    StringView player_name;
+};
+
+struct JoinSessionRequestView : public NetMessageView<JoinSessionRequest> {
+    inline bool Parse(Packet &packet) {
+        this->packet = &packet;
+        this->offset = packet.position;
+
+        return
+            packet.SkipData(sizeof(u16)) &&
+            packet.ReadStringView(this->player_name) &&
+            packet.ReadStringView(this->password);
+    }
+
+    inline u16 GetSessionId() const { return this->packet->ReadAt<u16>(this->offset); }
+
+    u32 offset = 0;
+    StringView player_name;
+    StringView password;
+};
+
+struct GetSessionInfoResponseView : public NetMessageView<GetSessionInfoResponse> {
+    struct Entry {
+        StringView name;
+        u16 id;
+        u16 nplayers;
+        u16 nplayers_connected;
+        SessionState state;
+        b8 haspw;
+    };
+
+    constexpr static u32 entry_fixed_size = 3 * sizeof(u16) + sizeof(SessionState) + sizeof(b8);
+
+    inline bool Parse(Packet &packet) {
+        this->packet = &packet;
+
+        if (!packet.ReadU16(this->num_matching) ||
+            !packet.ReadU16(this->first) ||
+            !packet.ReadU16(this->num_sessions)) {
+            return false;
+        }
+
+        this->offset = packet.position;
+
+        for (u16 i = 0; i < this->num_sessions; ++i) {
+            StringView name;
+
+            if (!packet.ReadStringView(name) || !packet.SkipData(entry_fixed_size)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    inline u16 GetNumSessions() const { return this->num_sessions; }
+
+    template<typename Callback>
+    void ForEachSession(Callback &&callback) const {
+        auto position = this->offset;
+
+        for (u16 i = 0; i < this->num_sessions; ++i) {
+            auto name_length = this->packet->ReadAt<u32>(position);
+            position += sizeof(u32);
+
+            Entry entry;
+            entry.name = StringView{this->packet->buffer.data() + position, name_length};
+            position += name_length;
+            entry.id = this->packet->ReadAt<u16>(position);
+            entry.nplayers = this->packet->ReadAt<u16>(position + 2);
+            entry.nplayers_connected = this->packet->ReadAt<u16>(position + 4);
+            entry.state = this->packet->ReadAt<SessionState>(position + 6);
+            entry.haspw = this->packet->ReadAt<b8>(position + 6 + sizeof(SessionState));
+            position += entry_fixed_size;
+
+            callback(entry);
+        }
+    }
+
+    u32 offset = 0;
+    u16 num_matching = 0; // On all pages
+    u16 first = 0;
+    u16 num_sessions = 0;
+};
+
+struct DisconnectMessageView : public NetMessageView<DisconnectMessage> {
+    inline bool Parse(Packet &packet) {
+        this->packet = &packet;
+
+        return
+            packet.ReadEnum(this->reason) &&
+            packet.ReadStringView(this->message);
+    }
+
+    DisconnectReason reason = DisconnectReason::NONE;
+    StringView message;
+};
+
+struct InputBundleView : public NetMessageView<InputBundleMessage> {
+    inline bool Parse(Packet &packet) {
+        this->packet = &packet;
+
+        if (!packet.ReadU8(this->num_inputs) || this->num_inputs > InputBundleMessage::max_inputs) {
+            return false;
+        }
+
+        this->offset = packet.position;
+
+        b8 has_echo;
+        if (!packet.SkipData(this->num_inputs * PlayerInput::serialized_size) || !packet.ReadB8(has_echo)) {
+            return false;
+        }
+
+        if (has_echo && !this->echo.emplace().Deserialize(packet)) {
+            return false;
+        }
+
+        return packet.ReadB8(this->trace_latency);
+    }
+
+    inline u8 GetNumInputs() const {
+        return this->num_inputs;
+    }
+
+    inline PlayerInput GetInput(size_t index) const {
+        assert(index < this->num_inputs);
+        return PlayerInput::ReadAt(*this->packet, this->offset + static_cast<u32>(index) * PlayerInput::serialized_size);
+    }
+
+    u32 offset = 0;
+    u8 num_inputs = 0;
+    Optional<TimeEcho> echo;
+    b8 trace_latency = false;
+};
@@ -0,0 +1,132 @@
+#include "common/net_stats.hpp"
+
+#include "common/log.hpp"
+#include "common/net_msg.hpp"
+#include "common/game_state.hpp"
+
+static_assert(static_cast<size_t>(NetMessageType::COUNT) <= NetTrafficStats::max_message_types);
+
+void NetTrafficStats::Record(NetDirection direction, const char *packet, size_t size) {
+    auto direction_index = static_cast<size_t>(direction);
+    this->total[direction_index].Add(size);
+
+    size_t message_index = 0;
+    if (size > sizeof(Packet_Header)) {
+        message_index = static_cast<u8>(packet[sizeof(Packet_Header)]);
+        if (message_index >= static_cast<size_t>(NetMessageType::COUNT)) {
+            message_index = 0;
+        }
+    }
+
+    this->messages[message_index][direction_index].Add(size);
+
+    if (message_index == static_cast<size_t>(NetMessageType::GAME_COMMAND) && size > sizeof(Packet_Header) + 1) {
+        size_t command_index = static_cast<u8>(packet[sizeof(Packet_Header) + 1]);
+        if (command_index >= NetTrafficStats::max_command_types) {
+            command_index = 0;
+        }
+
+        this->commands[command_index][direction_index].Add(size);
+    }
+}
+
+void NetTrafficStats::Merge(const NetTrafficStats &other) {
+    for (size_t direction = 0; direction < static_cast<size_t>(NetDirection::COUNT); ++direction) {
+        this->total[direction].Merge(other.total[direction]);
+
+        for (size_t i = 0; i < NetTrafficStats::max_message_types; ++i) {
+            this->messages[i][direction].Merge(other.messages[i][direction]);
+        }
+
+        for (size_t i = 0; i < NetTrafficStats::max_command_types; ++i) {
+            this->commands[i][direction].Merge(other.commands[i][direction]);
+        }
+    }
+}
+
+const NetTrafficCounter &NetTrafficStats::GetTotal(NetDirection direction) const {
+    return this->total[static_cast<size_t>(direction)];
+}
+
+static void LogCounter(StringView scope, StringView direction, StringView message, StringView command, const NetTrafficCounter &counter) {
+    if (counter.messages == 0) {
+        return;
+    }
+
+    LogInfo("net_stats", "scope={} dir={} msg={} cmd={} count={} bytes={} avg={} hist=[{}]"_format(
+        scope,
+        direction,
+        message,
+        command,
+        counter.messages,
+        counter.bytes,
+        counter.bytes / counter.messages,
+        fmt::join(counter.size_histogram, ",")));
+}
+
+void LogNetTrafficStats(StringView scope, const NetTrafficStats &stats) {
+    for (size_t direction = 0; direction < static_cast<size_t>(NetDirection::COUNT); ++direction) {
+        auto direction_name = static_cast<NetDirection>(direction) == NetDirection::INBOUND ? "in" : "out";
+
+        for (size_t i = 0; i < static_cast<size_t>(NetMessageType::COUNT); ++i) {
+            auto message_name = ToString(static_cast<NetMessageType>(i));
+            LogCounter(scope, direction_name, message_name, "-", stats.messages[i][direction]);
+
+            if (static_cast<NetMessageType>(i) == NetMessageType::GAME_COMMAND) {
+                for (size_t j = 0; j < NetTrafficStats::max_command_types; ++j) {
+                    LogCounter(scope, direction_name, message_name, ToString(static_cast<GameCommand::Type>(j)), stats.commands[j][direction]);
+                }
+            }
+        }
+    }
+}
+
+void LogNetTrafficSummary(StringView scope, const NetTrafficStats &stats, NetTrafficRate &rate, u64 tick, size_t send_queue_depth) {
+    auto ticks = static_cast<f32>(std::max<u64>(tick - rate.last_tick, 1));
+    const auto &inbound = stats.GetTotal(NetDirection::INBOUND);
+    const auto &outbound = stats.GetTotal(NetDirection::OUTBOUND);
+    auto &last_inbound = rate.last_bytes[static_cast<size_t>(NetDirection::INBOUND)];
+    auto &last_outbound = rate.last_bytes[static_cast<size_t>(NetDirection::OUTBOUND)];
+
+    LogInfo("net_stats", "scope={} in_per_tick={:.1f} out_per_tick={:.1f} in_total={} out_total={} send_queue={}"_format(
+        scope,
+        (inbound.bytes - last_inbound) / ticks,
+        (outbound.bytes - last_outbound) / ticks,
+        inbound.bytes,
+        outbound.bytes,
+        send_queue_depth));
+
+    last_inbound = inbound.bytes;
+    last_outbound = outbound.bytes;
+    rate.last_tick = tick;
+}
+
+f32 LatencyHistogram::GetPercentile(f32 percentile) const {
+    auto target = static_cast<u64>(std::ceil(percentile / 100.0f * this->count));
+    u64 seen = 0;
+
+    for (size_t i = 0; i + 1 < LatencyHistogram::num_buckets; ++i) {
+        seen += this->buckets[i];
+        if (seen >= target) {
+            return std::min(LatencyHistogram::GetBucketLimit(i), this->max_ms);
+        }
+    }
+
+    return this->max_ms;
+}
+
+void LogLatencyHistogram(StringView scope, StringView hop, const LatencyHistogram &histogram) {
+    if (histogram.count == 0) {
+        return;
+    }
+
+    LogInfo("latency", "scope={} hop={} count={} avg={:.1f} p50={:.1f} p99={:.1f} max={:.1f} hist=[{}]"_format(
+        scope,
+        hop,
+        histogram.count,
+        histogram.sum_ms / histogram.count,
+        histogram.GetPercentile(50.0f),
+        histogram.GetPercentile(99.0f),
+        histogram.max_ms,
+        fmt::join(histogram.buckets, ",")));
+}
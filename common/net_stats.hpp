@@ -0,0 +1,101 @@
+#pragma once
+
+#include "common/common.hpp"
+
+enum class NetDirection : u8 {
+    INBOUND,
+    OUTBOUND,
+    COUNT
+};
+
+struct NetTrafficCounter {
+    // Bucket i counts the messages smaller than 16 << i bytes, the last bucket all larger ones
+    constexpr static size_t num_size_buckets = 10;
+
+    inline void Add(size_t size) {
+        size_t bucket = 0;
+        while (bucket + 1 < num_size_buckets && size >= (16u << bucket)) {
+            ++bucket;
+        }
+
+        ++this->messages;
+        this->bytes += size;
+        ++this->size_histogram[bucket];
+    }
+
+    inline void Merge(const NetTrafficCounter &other) {
+        this->messages += other.messages;
+        this->bytes += other.bytes;
+
+        for (size_t i = 0; i < num_size_buckets; ++i) {
+            this->size_histogram[i] += other.size_histogram[i];
+        }
+    }
+
+    u64 messages = 0;
+    u64 bytes = 0;
+    std::array<u64, num_size_buckets> size_histogram{};
+};
+
+// Message counts and sizes per NetMessageType and GameCommand::Type. Index 0 counts
+// unknown types since both enums start at 1.
+struct NetTrafficStats {
+    constexpr static size_t max_message_types = 32;
+    constexpr static size_t max_command_types = 32;
+
+    void Record(NetDirection direction, const char *packet, size_t size);
+    void Merge(const NetTrafficStats &other);
+    const NetTrafficCounter &GetTotal(NetDirection direction) const;
+
+    using Counters = std::array<NetTrafficCounter, static_cast<size_t>(NetDirection::COUNT)>;
+    std::array<Counters, max_message_types> messages{};
+    std::array<Counters, max_command_types> commands{};
+    Counters total{};
+};
+
+// Latencies of one hop in milliseconds. Bucket i counts the values below 0.5 << i ms, the
+// last bucket all larger ones. Percentiles are the upper bound of their bucket.
+struct LatencyHistogram {
+    constexpr static size_t num_buckets = 12;
+
+    inline void Add(f32 ms) {
+        size_t bucket = 0;
+        while (bucket + 1 < num_buckets && ms >= GetBucketLimit(bucket)) {
+            ++bucket;
+        }
+
+        ++this->count;
+        this->sum_ms += ms;
+        this->max_ms = std::max(this->max_ms, ms);
+        ++this->buckets[bucket];
+    }
+
+    inline static f32 GetBucketLimit(size_t bucket) {
+        return 0.5f * static_cast<f32>(1u << bucket);
+    }
+
+    f32 GetPercentile(f32 percentile) const;
+
+    u64 count = 0;
+    f64 sum_ms = 0.0;
+    f32 max_ms = 0.0f;
+    std::array<u64, num_buckets> buckets{};
+};
+
+// Remembers the totals at the last report to compute the bandwidth per tick in between
+struct NetTrafficRate {
+    std::array<u64, static_cast<size_t>(NetDirection::COUNT)> last_bytes{};
+    u64 last_tick = 0;
+};
+
+// Writes the bandwidth per tick since the last report and the send queue depth, e.g.
+// "scope=connection:3 in_per_tick=41.2 out_per_tick=930.5 in_total=... out_total=... send_queue=2"
+void LogNetTrafficSummary(StringView scope, const NetTrafficStats &stats, NetTrafficRate &rate, u64 tick, size_t send_queue_depth);
+
+// Writes one structured log line per message type and command type that was used, e.g.
+// "scope=session:1 dir=out msg=GAME_COMMAND cmd=MOVE_TANK count=12 bytes=216 hist=[0,12,0,...]"
+void LogNetTrafficStats(StringView scope, const NetTrafficStats &stats);
+
+// Writes one structured log line per histogram, e.g.
+// "scope=client hop=network count=120 avg=31.2 p50=32 p99=64 max=58.1 hist=[0,0,2,...]"
+void LogLatencyHistogram(StringView scope, StringView hop, const LatencyHistogram &histogram);
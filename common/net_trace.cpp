@@ -0,0 +1,224 @@
+#include "common/net_trace.hpp"
+
+#include "common/log.hpp"
+#include "common/socket.hpp"
+
+constexpr size_t net_trace_header_size = 2 * sizeof(u32) + sizeof(NetTraceRole) + sizeof(i64);
+constexpr size_t net_trace_record_header_size = sizeof(u64) + sizeof(u32) + sizeof(NetDirection) + sizeof(u32);
+
+template<typename T>
+static void Append(Array<char> &buffer, const T &value) {
+    auto offset = buffer.size();
+    buffer.resize(offset + sizeof(value));
+    std::memcpy(&buffer[offset], &value, sizeof(value));
+}
+
+NetTraceWriter::~NetTraceWriter() {
+    this->Close();
+}
+
+bool NetTraceWriter::Open(StringView filename, NetTraceRole role) {
+    this->Close();
+
+    this->file.open(String{filename}, std::ios::binary | std::ios::trunc);
+    if (!this->file.is_open()) {
+        LogError("net trace", "Cannot open {} for writing"_format(filename));
+        return false;
+    }
+
+    this->filename = filename;
+    this->bytes_written = net_trace_header_size;
+
+    i64 started_unix_ms = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    this->file.write(reinterpret_cast<const char *>(&net_trace_magic), sizeof(net_trace_magic));
+    this->file.write(reinterpret_cast<const char *>(&net_trace_version), sizeof(net_trace_version));
+    this->file.write(reinterpret_cast<const char *>(&role), sizeof(role));
+    this->file.write(reinterpret_cast<const char *>(&started_unix_ms), sizeof(started_unix_ms));
+
+    {
+        // Records that were written while the writer was closed must not end up in this file
+        std::lock_guard lock{this->mutex};
+        this->pending.clear();
+        this->started = Clock::now();
+        this->num_records = 0;
+        this->num_dropped = 0;
+        this->quit = false;
+        this->open = true;
+    }
+
+    this->thread = std::thread{&NetTraceWriter::Run, this};
+
+    LogInfo("net trace", "Tracing to {}"_format(filename));
+    return true;
+}
+
+void NetTraceWriter::Close() {
+    if (!this->IsOpen()) {
+        return;
+    }
+
+    u64 num_records;
+    u64 num_dropped;
+
+    {
+        std::lock_guard lock{this->mutex};
+        this->open = false;
+        this->quit = true;
+        num_records = this->num_records;
+        num_dropped = this->num_dropped;
+    }
+
+    this->wake.notify_one();
+    this->thread.join();
+    this->file.close();
+
+    LogInfo("net trace", "Traced {} packets ({} bytes) to {}, dropped {}"_format(
+        num_records,
+        this->bytes_written,
+        this->filename,
+        num_dropped));
+}
+
+void NetTraceWriter::Write(u32 connection_id, NetDirection direction, const char *data, u32 size) {
+    auto now = Clock::now();
+    auto notify = false;
+
+    {
+        std::lock_guard lock{this->mutex};
+
+        // A socket may still hold the pointer when the trace is stopped
+        if (!this->open) {
+            return;
+        }
+
+        u64 time_ns = chrono::duration_cast<chrono::nanoseconds>(now - this->started).count();
+
+        if (this->pending.size() + net_trace_record_header_size + size > NetTraceWriter::max_pending) {
+            ++this->num_dropped;
+            return;
+        }
+
+        Append(this->pending, time_ns);
+        Append(this->pending, connection_id);
+        Append(this->pending, direction);
+        Append(this->pending, size);
+        this->pending.insert(this->pending.end(), data, data + size);
+        ++this->num_records;
+
+        notify = this->pending.size() >= NetTraceWriter::write_threshold;
+    }
+
+    if (notify) {
+        this->wake.notify_one();
+    }
+}
+
+void NetTraceWriter::Run() {
+    std::unique_lock lock{this->mutex};
+
+    while (true) {
+        this->wake.wait_for(lock, NetTraceWriter::write_interval, [this] {
+            return this->quit || this->pending.size() >= NetTraceWriter::write_threshold;
+        });
+
+        auto quit = this->quit;
+        std::swap(this->pending, this->writing);
+        lock.unlock();
+
+        if (!this->writing.empty()) {
+            this->file.write(this->writing.data(), this->writing.size());
+            this->file.flush();
+            this->bytes_written += this->writing.size();
+            this->writing.clear();
+
+            if (this->file.fail()) {
+                LogError("net trace", "Cannot write to {}"_format(this->filename));
+            }
+        }
+
+        lock.lock();
+
+        // Everything written before Close was called is in the file
+        if (quit && this->pending.empty()) {
+            return;
+        }
+    }
+}
+
+bool StartNetTrace(NetTraceWriter &writer, StringView filename, NetTraceRole role) {
+    StopNetTrace(writer);
+
+    if (!writer.Open(filename, role)) {
+        return false;
+    }
+
+    TcpSocket::trace = &writer;
+    return true;
+}
+
+void StopNetTrace(NetTraceWriter &writer) {
+    if (TcpSocket::trace == &writer) {
+        TcpSocket::trace = nullptr;
+    }
+
+    writer.Close();
+}
+
+bool NetTraceReader::Open(StringView filename) {
+    if (!this->file.Open(filename)) {
+        return false;
+    }
+
+    u32 magic = 0;
+    u32 version = 0;
+
+    if (this->file.size >= net_trace_header_size) {
+        auto data = this->file.data;
+        std::memcpy(&magic, data, sizeof(magic));
+        std::memcpy(&version, data + sizeof(magic), sizeof(version));
+        std::memcpy(&this->role, data + 2 * sizeof(u32), sizeof(this->role));
+        std::memcpy(&this->started_unix_ms, data + 2 * sizeof(u32) + sizeof(NetTraceRole), sizeof(this->started_unix_ms));
+    }
+
+    if (magic != net_trace_magic) {
+        LogError("net trace", "{} is not a trace file"_format(filename));
+        return false;
+    }
+
+    if (version != net_trace_version) {
+        LogError("net trace", "{} has version {}, expected {}"_format(filename, version, net_trace_version));
+        return false;
+    }
+
+    this->position = net_trace_header_size;
+    this->released = 0;
+    return true;
+}
+
+bool NetTraceReader::Next(NetTraceRecord &out) {
+    if (this->position + net_trace_record_header_size > this->file.size) {
+        return false;
+    }
+
+    auto header = this->file.data + this->position;
+    std::memcpy(&out.time_ns, header, sizeof(out.time_ns));
+    std::memcpy(&out.connection_id, header + 8, sizeof(out.connection_id));
+    std::memcpy(&out.direction, header + 12, sizeof(out.direction));
+    std::memcpy(&out.size, header + 13, sizeof(out.size));
+
+    if (this->position + net_trace_record_header_size + out.size > this->file.size) {
+        // The process was probably killed before the writer caught up
+        LogWarning("net trace", "Truncated record at offset {}"_format(this->position));
+        return false;
+    }
+
+    out.data = header + net_trace_record_header_size;
+    this->position += net_trace_record_header_size + out.size;
+
+    if (this->position - this->released >= NetTraceReader::release_interval) {
+        this->file.ReleaseBefore(this->position);
+        this->released = this->position;
+    }
+
+    return true;
+}
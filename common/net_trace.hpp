@@ -0,0 +1,83 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/net_stats.hpp"
+#include "common/mapped_file.hpp"
+
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// A trace file has every packet a process sent or received, as framed on the wire but
+// uncompressed: a header followed by records of
+// [time u64 (nanoseconds since the trace started)][connection u32][direction u8][size u32][packet].
+// tankgame-tracedump decodes it.
+enum class NetTraceRole : u8 {
+    RECORDED_BY_CLIENT = 1,
+    RECORDED_BY_SERVER = 2,
+};
+
+constexpr u32 net_trace_magic = 0x52544754; // "TGTR"
+constexpr u32 net_trace_version = 1;
+
+// Records are appended to a buffer that a background thread writes out, so tracing does
+// not put file I/O on the tick. If the thread falls behind by more than max_pending bytes,
+// records are dropped (whole records, the file stays readable). Write may be called from
+// any thread, also while another one opens or closes the writer.
+struct NetTraceWriter {
+    using Clock = chrono::steady_clock;
+
+    constexpr static size_t max_pending = 64 * 1024 * 1024;
+    constexpr static size_t write_threshold = 256 * 1024; // The thread wakes up earlier if this much is pending
+    constexpr static auto write_interval = 100ms;
+
+    ~NetTraceWriter();
+    bool Open(StringView filename, NetTraceRole role);
+    void Close();
+    void Write(u32 connection_id, NetDirection direction, const char *data, u32 size);
+    void Run();
+
+    inline bool IsOpen() const {
+        return this->thread.joinable();
+    }
+
+    String filename;
+    std::ofstream file;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    Array<char> pending; // Guarded by mutex
+    Array<char> writing; // Only touched by the thread
+    bool open = false; // Guarded by mutex, Write does nothing while it is false
+    bool quit = false; // Guarded by mutex
+    Clock::time_point started; // Guarded by mutex
+    u64 num_records = 0; // Guarded by mutex
+    u64 num_dropped = 0; // Guarded by mutex
+    u64 bytes_written = 0; // By the thread, read after it finished
+};
+
+// Opens the trace and makes every socket of the process record into it
+bool StartNetTrace(NetTraceWriter &writer, StringView filename, NetTraceRole role);
+void StopNetTrace(NetTraceWriter &writer);
+
+struct NetTraceRecord {
+    u64 time_ns = 0;
+    u32 connection_id = 0;
+    NetDirection direction = NetDirection::INBOUND;
+    const char *data = nullptr; // The packet including its Packet_Header, points into the mapped file
+    u32 size = 0;
+};
+
+struct NetTraceReader {
+    bool Open(StringView filename);
+    bool Next(NetTraceRecord &out); // Returns false at the end of the file or at a truncated record
+
+    constexpr static size_t release_interval = 64 * 1024 * 1024;
+
+    MappedFile file;
+    NetTraceRole role = NetTraceRole::RECORDED_BY_CLIENT;
+    i64 started_unix_ms = 0; // Wall clock time of the first record's time 0
+    size_t position = 0;
+    size_t released = 0;
+};
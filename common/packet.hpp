@@ -3,9 +3,30 @@
 #include "common.hpp"
 
 struct Packet_Header {
+    // The highest bit of size marks a compressed payload (see TcpSocket::Push), the one below
+    // it a chunk of a streamed packet (see SendQueue). Packets are limited to TcpSocket::max_packet_size,
+    // so the bits are never part of a real size.
+    constexpr static u32 FLAG_COMPRESSED = 1u << 31;
+    constexpr static u32 FLAG_CHUNK = 1u << 30;
+    constexpr static u32 SIZE_MASK = ~(FLAG_COMPRESSED | FLAG_CHUNK);
+
     u32 size;
 };
 
+// How a packet is treated while it waits in a send queue that the receiver does not drain
+// fast enough, see TcpSocket::Push
+enum class SendClass : u8 {
+    RELIABLE,  // Always sent
+    STATE,     // Only carries the latest state of something, supersedes a queued packet with the same key
+    TRANSIENT, // Not worth sending late (e.g. sound effects), dropped while the queue is over its soft limit
+    URGENT,    // Does not depend on anything queued before it (e.g. clock sync), overtakes a streamed packet
+};
+
+struct SendPolicy {
+    SendClass send_class = SendClass::RELIABLE;
+    u64 key = 0; // Identifies what a STATE packet is the state of
+};
+
 #if 0
 template<typename T>
 inline T zigzag_e(T value) {
@@ -180,6 +201,50 @@ struct Packet {
         return true;
     }
 
+    // Like ReadString, but the result points into the buffer instead of being copied
+    inline bool ReadStringView(StringView &out) {
+        u32 len = 0;
+
+        if (!this->ReadU32(len)) {
+            return false;
+        }
+
+        if (len > 100000 || static_cast<size_t>(this->position) + len > this->buffer.size()) {
+            this->valid = false;
+            return false;
+        }
+
+        out = StringView{this->buffer.data() + this->position, len};
+        this->position += len;
+
+        return true;
+    }
+
+    inline bool SkipData(u32 size) {
+        if (!this->valid) {
+            return false;
+        }
+
+        if (static_cast<size_t>(this->position) + size > this->buffer.size()) {
+            this->valid = false;
+            return false;
+        }
+
+        this->position += size;
+        return true;
+    }
+
+    // Reads at an offset that was already validated, without moving the position
+    template<typename T>
+    T ReadAt(u32 offset) const {
+        static_assert(std::is_trivially_copyable_v<T>);
+        assert(static_cast<size_t>(offset) + sizeof(T) <= this->buffer.size());
+
+        T result;
+        std::memcpy(&result, &this->buffer[offset], sizeof(result));
+        return result;
+    }
+
     inline bool IsValidAndFinished() const {
         return this->valid && this->position == this->buffer.size();
     }
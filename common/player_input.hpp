@@ -0,0 +1,59 @@
+#pragma once
+
+#include "common/packet.hpp"
+
+// The input state of a player, sampled once per client tick. The server turns the
+// differences between consecutive inputs into game commands (see ServerGameState::ApplyInput).
+struct PlayerInput {
+    constexpr static u8 ROTATE_TURRET_LEFT  = 1 << 0; // Same as CTank::ROTATE_TURRET_LEFT
+    constexpr static u8 ROTATE_TURRET_RIGHT = 1 << 1; // Same as CTank::ROTATE_TURRET_RIGHT
+
+    inline bool HasSameState(const PlayerInput &other) const {
+        return
+            this->move == other.move &&
+            this->turret_flags == other.turret_flags &&
+            this->target_turret_rotation == other.target_turret_rotation &&
+            this->fire == other.fire &&
+            this->weapon == other.weapon;
+    }
+
+    void Serialize(Packet &packet) const {
+        packet.WriteU32(this->sequence);
+        packet.WriteI8(this->move);
+        packet.WriteU8(this->turret_flags);
+        packet.WriteF32(this->target_turret_rotation);
+        packet.WriteB8(this->fire);
+        packet.WriteU8(this->weapon);
+    }
+
+    // Reads an input that was already validated (see InputBundleView)
+    static PlayerInput ReadAt(const Packet &packet, u32 offset) {
+        PlayerInput input;
+        input.sequence               = packet.ReadAt<u32>(offset);
+        input.move                   = packet.ReadAt<i8>(offset + 4);
+        input.turret_flags           = packet.ReadAt<u8>(offset + 5);
+        input.target_turret_rotation = packet.ReadAt<f32>(offset + 6);
+        input.fire                   = packet.ReadAt<b8>(offset + 10);
+        input.weapon                 = packet.ReadAt<u8>(offset + 11);
+        return input;
+    }
+
+    bool Deserialize(Packet &packet) {
+        return
+            packet.ReadU32(this->sequence) &&
+            packet.ReadI8(this->move) &&
+            packet.ReadU8(this->turret_flags) &&
+            packet.ReadF32(this->target_turret_rotation) &&
+            packet.ReadB8(this->fire) &&
+            packet.ReadU8(this->weapon);
+    }
+
+    constexpr static u32 serialized_size = 12; // Must match Serialize
+
+    u32 sequence = 0;
+    i8 move = 0; // -1, 0 or 1
+    u8 turret_flags = 0;
+    f32 target_turret_rotation = 0.0f;
+    bool fire = false; // Fire button held down
+    u8 weapon = 0; // Weapon::Type
+};
@@ -0,0 +1,134 @@
+#include "common/replay.hpp"
+
+#include "common/log.hpp"
+
+constexpr size_t replay_header_size = 2 * sizeof(u32);
+constexpr size_t replay_record_header_size = sizeof(u8) + sizeof(u32);
+
+ReplayWriter::~ReplayWriter() {
+    this->Close();
+}
+
+bool ReplayWriter::Open(StringView filename) {
+    this->Close();
+
+    this->file.open(String{filename}, std::ios::binary | std::ios::trunc);
+    if (!this->file.is_open()) {
+        LogError("replay", "Cannot open {} for writing"_format(filename));
+        return false;
+    }
+
+    this->filename = filename;
+    this->file.write(reinterpret_cast<const char *>(&replay_magic), sizeof(replay_magic));
+    this->file.write(reinterpret_cast<const char *>(&replay_version), sizeof(replay_version));
+    this->bytes_written = replay_header_size;
+
+    LogInfo("replay", "Recording to {}"_format(filename));
+    return true;
+}
+
+void ReplayWriter::Close() {
+    if (!this->file.is_open()) {
+        return;
+    }
+
+    this->file.close();
+    LogInfo("replay", "Recorded {} bytes to {}"_format(this->bytes_written, this->filename));
+}
+
+void ReplayWriter::Write(ReplayRecordType type, const Packet &payload) {
+    if (!this->file.is_open()) {
+        return;
+    }
+
+    auto size = static_cast<u32>(payload.buffer.size() - sizeof(Packet_Header));
+    this->file.write(reinterpret_cast<const char *>(&type), sizeof(type));
+    this->file.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    this->file.write(&payload.buffer[sizeof(Packet_Header)], size);
+    this->bytes_written += replay_record_header_size + size;
+
+    if (this->file.fail()) {
+        LogError("replay", "Cannot write to {}, stopping the recording"_format(this->filename));
+        this->file.close();
+    }
+}
+
+void ReplayWriter::Flush() {
+    if (this->file.is_open()) {
+        this->file.flush();
+    }
+}
+
+Packet ReplayRecord::ToPacket() const {
+    Packet packet;
+    packet.WriteData(this->data, this->size);
+    packet.position = sizeof(Packet_Header);
+    return packet;
+}
+
+bool ReplayReader::Open(StringView filename) {
+    if (!this->file.Open(filename)) {
+        return false;
+    }
+
+    u32 magic = 0;
+    u32 version = 0;
+
+    if (this->file.size >= replay_header_size) {
+        std::memcpy(&magic, this->file.data, sizeof(magic));
+        std::memcpy(&version, this->file.data + sizeof(magic), sizeof(version));
+    }
+
+    if (magic != replay_magic) {
+        LogError("replay", "{} is not a replay file"_format(filename));
+        return false;
+    }
+
+    if (version != replay_version) {
+        LogError("replay", "{} has version {}, expected {}"_format(filename, version, replay_version));
+        return false;
+    }
+
+    this->position = replay_header_size;
+    this->released = 0;
+    return true;
+}
+
+bool ReplayReader::Next(ReplayRecord &out) {
+    if (this->position + replay_record_header_size > this->file.size) {
+        return false;
+    }
+
+    std::memcpy(&out.type, this->file.data + this->position, sizeof(out.type));
+    std::memcpy(&out.size, this->file.data + this->position + sizeof(out.type), sizeof(out.size));
+
+    if (this->position + replay_record_header_size + out.size > this->file.size) {
+        // The server was probably killed while writing
+        LogWarning("replay", "Truncated record at offset {}"_format(this->position));
+        return false;
+    }
+
+    out.data = this->file.data + this->position + replay_record_header_size;
+    this->position += replay_record_header_size + out.size;
+
+    // Keep the resident memory flat for recordings of many hours
+    if (this->position - this->released >= ReplayReader::release_interval) {
+        this->file.ReleaseBefore(this->position);
+        this->released = this->position;
+    }
+
+    return true;
+}
+
+const char *ToString(ReplayRecordType type) {
+    switch (type) {
+        case ReplayRecordType::SESSION:  return "SESSION";
+        case ReplayRecordType::LEVEL:    return "LEVEL";
+        case ReplayRecordType::COMMAND:  return "COMMAND";
+        case ReplayRecordType::LEAVE:    return "LEAVE";
+        case ReplayRecordType::TICK:     return "TICK";
+        case ReplayRecordType::CHECKSUM: return "CHECKSUM";
+    }
+
+    return "<invalid>";
+}
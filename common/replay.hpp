@@ -0,0 +1,55 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/packet.hpp"
+#include "common/mapped_file.hpp"
+
+#include <fstream>
+
+// A replay file is append-only: a header followed by records of [type u8][payload size u32][payload].
+// The server records one file per game (see Server::replay_directory), tankgame-replay plays it back.
+enum class ReplayRecordType : u8 {
+    SESSION = 1, // seed u32, name, num_players i32, num_npcs i32, num_slots u32, per player slot: occupied b8, name
+    LEVEL,       // checksum u32 of the prepared level
+    COMMAND,     // tick u32, player slot i32, serialized game command
+    LEAVE,       // tick u32, player slot i32
+    TICK,        // tick u32, dt f32, duration of the session tick on the server in microseconds u32
+    CHECKSUM,    // tick u32, checksum u32 of the game state after the tick
+};
+
+constexpr u32 replay_magic = 0x50524754; // "TGRP"
+constexpr u32 replay_version = 1;
+constexpr u32 replay_checksum_interval = 60; // Ticks
+
+struct ReplayWriter {
+    ~ReplayWriter();
+    bool Open(StringView filename);
+    void Close();
+    void Write(ReplayRecordType type, const Packet &payload);
+    void Flush();
+
+    std::ofstream file;
+    String filename;
+    u64 bytes_written = 0;
+};
+
+struct ReplayRecord {
+    Packet ToPacket() const; // Copies the payload so it can be read with the usual packet functions
+
+    ReplayRecordType type;
+    const char *data = nullptr; // Points into the mapped file
+    u32 size = 0;
+};
+
+struct ReplayReader {
+    bool Open(StringView filename);
+    bool Next(ReplayRecord &out); // Returns false at the end of the file or at a truncated record
+
+    constexpr static size_t release_interval = 64 * 1024 * 1024;
+
+    MappedFile file;
+    size_t position = 0;
+    size_t released = 0;
+};
+
+const char *ToString(ReplayRecordType type);
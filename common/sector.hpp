@@ -0,0 +1,26 @@
+#pragma once
+
+#include "common/common.hpp"
+
+// The world is partitioned into square sectors. The server only replicates tanks and
+// projectiles to a client if they are within the interest radius around the client's
+// tank or camera sector (see ServerGameState::UpdateInterest).
+constexpr f32 sector_size = 1200.0f;
+constexpr i32 sector_interest_radius = 1;
+
+inline Vec2i GetSector(Vec2 position) {
+    return Vec2i{
+        static_cast<i32>(std::floor(position.x / sector_size)),
+        static_cast<i32>(std::floor(position.y / sector_size))
+    };
+}
+
+inline u64 GetSectorKey(Vec2i sector) {
+    return (static_cast<u64>(static_cast<u32>(sector.x)) << 32) | static_cast<u32>(sector.y);
+}
+
+inline bool IsSectorInInterestRadius(Vec2i center, Vec2i sector) {
+    return
+        std::abs(sector.x - center.x) <= sector_interest_radius &&
+        std::abs(sector.y - center.y) <= sector_interest_radius;
+}
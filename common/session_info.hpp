@@ -52,3 +52,26 @@ struct SessionInfo {
     SessionState state;
     b8 haspw;
 };
+
+// Which sessions the session browser wants to see, applied by the server to the listing
+// and by the client to the pushed updates
+struct SessionFilter {
+    constexpr static u8 NOT_FULL    = 1 << 0;
+    constexpr static u8 NO_PASSWORD = 1 << 1;
+    constexpr static u8 LOBBY_ONLY  = 1 << 2;
+
+    inline bool IsEmpty() const {
+        return this->flags == 0 && this->name_prefix.empty();
+    }
+
+    inline bool Matches(const SessionInfo &info) const {
+        return
+            (!(this->flags & NOT_FULL) || info.nplayers_connected < info.nplayers) &&
+            (!(this->flags & NO_PASSWORD) || !info.haspw) &&
+            (!(this->flags & LOBBY_ONLY) || info.state == SessionState::LOBBY) &&
+            StringView{info.name}.starts_with(this->name_prefix);
+    }
+
+    u8 flags = 0;
+    String name_prefix;
+};
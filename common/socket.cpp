@@ -1,10 +1,115 @@
 #include "common/socket.hpp"
 
 #include "common/log.hpp"
+#include "common/compression.hpp"
+#include "common/net_trace.hpp"
 
-constexpr u32 max_packet_size = 1'000'000;
+constexpr u32 lz4_max_ratio = 255; // A byte of an LZ4 block expands to at most this many bytes
+
+// Chunk layout: [Packet_Header with FLAG_CHUNK][u32 size of the streamed packet][u32 offset of the part][part of the streamed packet]
+constexpr size_t chunk_header_size = sizeof(Packet_Header) + 2 * sizeof(u32);
+
+// Compressed packet layout: [Packet_Header with FLAG_COMPRESSED][u32 uncompressed payload size][LZ4 block]
+static bool CompressPacket(const Array<char> &packet, Array<char> &output, SocketStats &stats) {
+    auto started = chrono::high_resolution_clock::now();
+    auto payload_size = static_cast<u32>(packet.size() - sizeof(Packet_Header));
+    auto compressed_offset = sizeof(Packet_Header) + sizeof(u32);
+
+    output.resize(compressed_offset + Lz4GetMaxCompressedSize(payload_size));
+    auto compressed_size = Lz4Compress(
+        &packet[sizeof(Packet_Header)],
+        payload_size,
+        &output[compressed_offset],
+        output.size() - compressed_offset);
+
+    if (compressed_size == 0 || compressed_offset + compressed_size >= packet.size()) {
+        return false;
+    }
+
+    output.resize(compressed_offset + compressed_size);
+
+    Packet_Header hdr;
+    hdr.size = static_cast<u32>(output.size()) | Packet_Header::FLAG_COMPRESSED;
+    std::memcpy(&output[0], &hdr, sizeof(hdr));
+    std::memcpy(&output[sizeof(Packet_Header)], &payload_size, sizeof(payload_size));
+
+    auto elapsed = chrono::high_resolution_clock::now() - started;
+    stats.compress_time += elapsed;
+    TcpSocket::global_stats.compress_time += elapsed;
+    ++stats.packets_compressed;
+    ++TcpSocket::global_stats.packets_compressed;
+    stats.bytes_before_compression += packet.size();
+    TcpSocket::global_stats.bytes_before_compression += packet.size();
+    stats.bytes_after_compression += output.size();
+    TcpSocket::global_stats.bytes_after_compression += output.size();
+
+    LogDebug("socket", "Compressed packet {} -> {} bytes ({:.1f}%) in {}"_format(
+        packet.size(),
+        output.size(),
+        100.0f * output.size() / packet.size(),
+        chrono::duration_cast<chrono::microseconds>(elapsed)));
+
+    return true;
+}
+
+// The claimed size is checked before anything is allocated, it comes from the peer
+static bool DecompressPacket(Array<char> &buffer, SocketStats &stats, u32 max_size) {
+    auto started = chrono::high_resolution_clock::now();
+    auto compressed_offset = sizeof(Packet_Header) + sizeof(u32);
+
+    if (buffer.size() < compressed_offset) {
+        return false;
+    }
+
+    u32 payload_size;
+    std::memcpy(&payload_size, &buffer[sizeof(Packet_Header)], sizeof(payload_size));
+
+    auto compressed_size = buffer.size() - compressed_offset;
+
+    if (payload_size == 0 ||
+        payload_size > max_size - sizeof(Packet_Header) ||
+        static_cast<u64>(payload_size) > static_cast<u64>(compressed_size) * lz4_max_ratio) {
+        return false;
+    }
+
+    Array<char> output(sizeof(Packet_Header) + payload_size);
+    if (!Lz4Decompress(&buffer[compressed_offset], compressed_size, &output[sizeof(Packet_Header)], payload_size)) {
+        return false;
+    }
+
+    Packet_Header hdr;
+    hdr.size = static_cast<u32>(output.size());
+    std::memcpy(&output[0], &hdr, sizeof(hdr));
+
+    auto elapsed = chrono::high_resolution_clock::now() - started;
+    stats.decompress_time += elapsed;
+    TcpSocket::global_stats.decompress_time += elapsed;
+    ++stats.packets_decompressed;
+    ++TcpSocket::global_stats.packets_decompressed;
+
+    LogDebug("socket", "Decompressed packet {} -> {} bytes in {}"_format(
+        buffer.size(),
+        output.size(),
+        chrono::duration_cast<chrono::microseconds>(elapsed)));
+
+    buffer = ToRvalue(output);
+    return true;
+}
+
+static void RecordTraffic(SocketStats &stats, NetDirection direction, const Array<char> &packet, size_t size) {
+    stats.traffic.Record(direction, packet.data(), size);
+    TcpSocket::global_stats.traffic.Record(direction, packet.data(), size);
+}
 
 SocketStats TcpSocket::global_stats;
+std::atomic<NetTraceWriter *> TcpSocket::trace{nullptr};
+u32 TcpSocket::next_trace_id = 1;
+
+static void Trace(const TcpSocket &socket, NetDirection direction, const Array<char> &packet, size_t size) {
+    if (auto writer = TcpSocket::trace.load(); writer != nullptr) {
+        writer->Write(socket.trace_id, direction, packet.data(), static_cast<u32>(size));
+    }
+}
 
 TcpSocket::~TcpSocket() {
     this->Close(false);
@@ -17,6 +122,7 @@ void TcpSocket::Close(bool error) {
     }
 
     this->state = error ? SocketState::ERROR : SocketState::NONE;
+    this->compression_enabled = false;
     this->remote_address = {};
     this->send.Reset();
     this->recv.Reset();
@@ -29,6 +135,7 @@ void TcpSocket::Connect(sockaddr_in remote_address) {
 
     this->remote_address = remote_address;
     this->sd = net::CreateNonBlockingSocket();
+    this->trace_id = TcpSocket::next_trace_id++;
 
     if (this->sd == -1) {
         LogInfo("socket", "Cannot create socket: {}"_format(net::GetErrorString()));
@@ -58,18 +165,206 @@ void TcpSocket::SetConnectedSocket(net::SocketDescriptor sd) {
     this->Close(false);
     this->sd = sd;
     this->state = SocketState::CONNECTED;
+    this->trace_id = TcpSocket::next_trace_id++;
+}
+
+static bool ShouldDrop(TcpSocket &socket, SendPolicy policy) {
+    if (policy.send_class != SendClass::TRANSIENT || socket.send_soft_limit == 0 || socket.send.num_bytes <= socket.send_soft_limit) {
+        return false;
+    }
+
+    ++socket.stats.packets_dropped;
+    ++TcpSocket::global_stats.packets_dropped;
+    return true;
 }
 
-void TcpSocket::Push(const Packet &pkt) {
+void TcpSocket::Push(const Packet &pkt, SendPolicy policy) {
     assert(pkt.position > sizeof(Packet_Header));
     assert((reinterpret_cast<const Packet_Header *>(&pkt.buffer[0]))->size == pkt.position);
-    this->send.queue.emplace_back(pkt.buffer);
+
+    if (ShouldDrop(*this, policy)) {
+        return;
+    }
+
+    RecordTraffic(this->stats, NetDirection::OUTBOUND, pkt.buffer, pkt.position);
+    Trace(*this, NetDirection::OUTBOUND, pkt.buffer, pkt.position);
+
+    if (this->TryPushCompressed(pkt, policy)) {
+        return;
+    }
+
+    this->Enqueue(Array<char>{pkt.buffer}, policy);
 }
 
-void TcpSocket::Push(Packet &&pkt) {
+void TcpSocket::Push(Packet &&pkt, SendPolicy policy) {
     assert(pkt.position > sizeof(Packet_Header));
     assert((reinterpret_cast<const Packet_Header *>(&pkt.buffer[0]))->size == pkt.position);
-    this->send.queue.emplace_back(ToRvalue(pkt.buffer));
+
+    if (ShouldDrop(*this, policy)) {
+        return;
+    }
+
+    RecordTraffic(this->stats, NetDirection::OUTBOUND, pkt.buffer, pkt.position);
+    Trace(*this, NetDirection::OUTBOUND, pkt.buffer, pkt.position);
+
+    if (this->TryPushCompressed(pkt, policy)) {
+        return;
+    }
+
+    this->Enqueue(ToRvalue(pkt.buffer), policy);
+}
+
+bool TcpSocket::TryPushCompressed(const Packet &pkt, SendPolicy policy) {
+    if (!this->compression_enabled || pkt.position < TcpSocket::compression_threshold) {
+        return false;
+    }
+
+    Array<char> compressed;
+    if (!CompressPacket(pkt.buffer, compressed, this->stats)) {
+        return false;
+    }
+
+    this->Enqueue(ToRvalue(compressed), policy);
+    return true;
+}
+
+// A STATE packet does not take the place of the one it supersedes but goes to the back of the
+// queue like any other packet, so it is never sent before something that was queued before it
+void TcpSocket::Enqueue(Array<char> &&data, SendPolicy policy) {
+    auto &send = this->send;
+    u64 key = 0;
+
+    if (policy.send_class == SendClass::URGENT && !send.stream.empty()) {
+        send.num_bytes += data.size();
+        send.peak_bytes = std::max(send.peak_bytes, send.num_bytes);
+        send.urgent.emplace_back(ToRvalue(data));
+        return;
+    }
+
+    if (policy.send_class == SendClass::STATE) {
+        key = policy.key;
+        auto sequence = send.first_sequence + send.queue.size();
+        auto [it, inserted] = send.keyed.try_emplace(key, sequence);
+
+        if (!inserted) {
+            auto &superseded = send.queue[it->second - send.first_sequence];
+            send.num_bytes -= superseded.data.size();
+            if (superseded.data.size() > TcpSocket::chunk_size) {
+                send.stream_bytes -= superseded.data.size();
+            }
+            superseded.data = {};
+            superseded.key = 0;
+            it->second = sequence;
+
+            ++this->stats.packets_superseded;
+            ++TcpSocket::global_stats.packets_superseded;
+        }
+    }
+
+    if (data.size() > TcpSocket::chunk_size) {
+        send.stream_bytes += data.size();
+    }
+
+    send.num_bytes += data.size();
+    send.peak_bytes = std::max(send.peak_bytes, send.num_bytes);
+    send.queue.emplace_back(SendQueue::Entry{
+        .data = ToRvalue(data),
+        .key = key,
+        .urgent = policy.send_class == SendClass::URGENT,
+    });
+}
+
+// The receiver throws away the part of a stream it got when the disconnect message arrives
+void TcpSocket::DiscardQueuedPackets() {
+    auto &send = this->send;
+    send.first_sequence += send.queue.size();
+    send.queue.clear();
+    send.urgent.clear();
+    send.keyed.clear();
+    send.stream = {};
+    send.stream_pos = 0;
+    send.stream_bytes = 0;
+    send.current_ends_packet = true;
+    send.num_bytes = send.current.size() - send.pos;
+}
+
+// URGENT packets that were queued behind the packet that starts streaming now go out between
+// its chunks. Their entries stay in the queue, empty like superseded ones, so the sequence
+// numbers of the STATE packets remain valid.
+static void StartStream(SendQueue &send, Array<char> &&data) {
+    send.stream = ToRvalue(data);
+    send.stream_pos = 0;
+
+    for (auto &entry : send.queue) {
+        if (entry.urgent && !entry.data.empty()) {
+            send.urgent.emplace_back(ToRvalue(entry.data));
+            entry.data = {};
+        }
+    }
+}
+
+// Makes the next packet or chunk the current one, leaves current empty if nothing is left
+static void TakeNextPacket(TcpSocket &socket) {
+    auto &send = socket.send;
+    send.pos = 0;
+    send.current_ends_packet = true;
+
+    while (send.stream.empty() && send.urgent.empty() && !send.queue.empty()) {
+        auto &entry = send.queue.front();
+
+        if (entry.key != 0) {
+            send.keyed.erase(entry.key);
+        }
+
+        auto data = ToRvalue(entry.data); // Stays empty if the packet was superseded
+        send.queue.pop_front();
+        ++send.first_sequence;
+
+        if (data.size() > TcpSocket::chunk_size) {
+            StartStream(send, ToRvalue(data));
+            ++socket.stats.packets_streamed;
+            ++TcpSocket::global_stats.packets_streamed;
+        } else if (!data.empty()) {
+            send.current = ToRvalue(data);
+            return;
+        }
+    }
+
+    if (!send.urgent.empty()) {
+        send.current = ToRvalue(send.urgent.front());
+        send.urgent.pop_front();
+        return;
+    }
+
+    if (send.stream.empty()) {
+        return;
+    }
+
+    // Chunks are not larger than chunk_size themselves, so a proxy that forwards them does not stream them again
+    auto size = std::min<size_t>(TcpSocket::chunk_size - chunk_header_size, send.stream.size() - send.stream_pos);
+    auto stream_size = static_cast<u32>(send.stream.size());
+    auto offset = static_cast<u32>(send.stream_pos);
+
+    Packet_Header hdr;
+    hdr.size = static_cast<u32>(chunk_header_size + size) | Packet_Header::FLAG_CHUNK;
+
+    send.current.resize(chunk_header_size + size);
+    std::memcpy(&send.current[0], &hdr, sizeof(hdr));
+    std::memcpy(&send.current[sizeof(Packet_Header)], &stream_size, sizeof(stream_size));
+    std::memcpy(&send.current[sizeof(Packet_Header) + sizeof(u32)], &offset, sizeof(offset));
+    std::memcpy(&send.current[chunk_header_size], &send.stream[send.stream_pos], size);
+
+    send.stream_pos += size;
+    send.stream_bytes -= size;
+    send.num_bytes += chunk_header_size;
+    send.peak_bytes = std::max(send.peak_bytes, send.num_bytes);
+
+    if (send.stream_pos == send.stream.size()) {
+        send.stream = {};
+        send.stream_pos = 0;
+    } else {
+        send.current_ends_packet = false;
+    }
 }
 
 bool TcpSocket::Pop(Packet &out) {
@@ -130,10 +425,8 @@ SocketResult TcpSocket::DoSend() {
             return SocketResult::DONE;
         }
 
-        if (this->send.current.empty() && !this->send.queue.empty()) {
-            this->send.current = ToRvalue(this->send.queue.front());
-            this->send.queue.pop_front();
-            this->send.pos = 0;
+        if (this->send.current.empty()) {
+            TakeNextPacket(*this);
         }
 
         if (this->send.current.empty()) {
@@ -160,6 +453,7 @@ SocketResult TcpSocket::DoSend() {
         }
 
         this->send.pos += sent;
+        this->send.num_bytes -= sent;
         this->stats.bytes_sent += sent;
         TcpSocket::global_stats.bytes_sent += sent;
 
@@ -167,12 +461,54 @@ SocketResult TcpSocket::DoSend() {
             return SocketResult::NOT_DONE;
         }
 
+        Packet_Header hdr;
+        std::memcpy(&hdr, this->send.current.data(), sizeof(hdr));
         this->send.current.clear();
-        ++this->stats.packets_sent;
-        ++TcpSocket::global_stats.packets_sent;
+
+        if (hdr.size & Packet_Header::FLAG_CHUNK) {
+            ++this->stats.chunks_sent;
+            ++TcpSocket::global_stats.chunks_sent;
+        }
+
+        if (this->send.current_ends_packet) {
+            ++this->stats.packets_sent;
+            ++TcpSocket::global_stats.packets_sent;
+        }
     }
 }
 
+// Returns false if the chunk does not continue the stream it belongs to. Only packets larger
+// than a chunk are streamed and the sender sends a stream's chunks in order, other packets may
+// come in between.
+static bool AddChunk(SocketBuffer &recv, const Array<char> &chunk, u32 max_stream_size) {
+    if (chunk.size() <= chunk_header_size) {
+        return false;
+    }
+
+    u32 stream_size;
+    u32 offset;
+    std::memcpy(&stream_size, &chunk[sizeof(Packet_Header)], sizeof(stream_size));
+    std::memcpy(&offset, &chunk[sizeof(Packet_Header) + sizeof(u32)], sizeof(offset));
+
+    // The buffer grows with the chunks, the size in the first one is not worth allocating for yet
+    if (recv.stream_size == 0) {
+        if (stream_size <= TcpSocket::chunk_size || stream_size > max_stream_size) {
+            return false;
+        }
+
+        recv.stream_size = stream_size;
+    }
+
+    auto size = chunk.size() - chunk_header_size;
+
+    if (stream_size != recv.stream_size || offset != recv.stream.size() || recv.stream.size() + size > recv.stream_size) {
+        return false;
+    }
+
+    recv.stream.insert(recv.stream.end(), chunk.begin() + chunk_header_size, chunk.end());
+    return true;
+}
+
 SocketResult TcpSocket::DoRecv() {
     if (this->state != SocketState::CONNECTED) {
         return SocketResult::DONE;
@@ -222,13 +558,79 @@ SocketResult TcpSocket::DoRecv() {
             Packet_Header hdr;
             memcpy(&hdr, this->recv.current.data(), sizeof(Packet_Header));
 
-            if (hdr.size < sizeof(Packet_Header) || hdr.size > max_packet_size) {
-                assert(!"Invalid packet size");
+            auto size = hdr.size & Packet_Header::SIZE_MASK;
+
+            if (size <= sizeof(Packet_Header) || size > TcpSocket::max_packet_size) {
+                LogError("socket", "Received packet with invalid size {}"_format(size));
+                this->Close(true);
+                return SocketResult::ERROR;
             }
 
-            this->recv.current.resize(hdr.size);
+            this->recv.current.resize(size);
             //memcpy(this->recv.current.data(), &hdr, sizeof(packet_hdr));
         } else {
+            Packet_Header hdr;
+            memcpy(&hdr, this->recv.current.data(), sizeof(Packet_Header));
+
+            auto chunk = (hdr.size & Packet_Header::FLAG_CHUNK) != 0;
+
+            if (chunk) {
+                ++this->stats.chunks_received;
+                ++TcpSocket::global_stats.chunks_received;
+            }
+
+            if (chunk && !this->keep_compressed) {
+                if (!AddChunk(this->recv, this->recv.current, this->max_stream_size)) {
+                    LogError("socket", "Received chunk that does not continue the stream");
+                    this->Close(true);
+                    return SocketResult::ERROR;
+                }
+
+                this->recv.current.clear();
+
+                if (this->recv.stream.size() != this->recv.stream_size) {
+                    continue;
+                }
+
+                // The streamed packet is handled like any other from here on
+                this->recv.current = ToRvalue(this->recv.stream);
+                this->recv.stream = {};
+                this->recv.stream_size = 0;
+
+                memcpy(&hdr, this->recv.current.data(), sizeof(Packet_Header));
+                chunk = false;
+
+                if ((hdr.size & Packet_Header::FLAG_CHUNK) || (hdr.size & Packet_Header::SIZE_MASK) != this->recv.current.size()) {
+                    LogError("socket", "Received malformed streamed packet");
+                    this->Close(true);
+                    return SocketResult::ERROR;
+                }
+            }
+
+            auto compressed = (hdr.size & Packet_Header::FLAG_COMPRESSED) != 0;
+
+            if (compressed && !this->keep_compressed) {
+                if (this->max_decompressed_size == 0) {
+                    LogError("socket", "Received compressed packet, but compression was not negotiated");
+                    this->Close(true);
+                    return SocketResult::ERROR;
+                }
+
+                if (!DecompressPacket(this->recv.current, this->stats, this->max_decompressed_size)) {
+                    LogError("socket", "Received malformed compressed packet");
+                    this->Close(true);
+                    return SocketResult::ERROR;
+                }
+
+                compressed = false;
+            }
+
+            if (!compressed && !chunk) {
+                RecordTraffic(this->stats, NetDirection::INBOUND, this->recv.current, this->recv.current.size());
+            }
+
+            Trace(*this, NetDirection::INBOUND, this->recv.current, this->recv.current.size());
+
             this->recv.queue.emplace_back(ToRvalue(this->recv.current));
             this->recv.current.clear();
             ++this->stats.packets_received;
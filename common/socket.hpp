@@ -2,9 +2,14 @@
 
 #include "packet.hpp"
 #include "net_platform.hpp"
+#include "net_stats.hpp"
 
 #include <queue>
 #include <memory>
+#include <chrono>
+#include <atomic>
+
+struct NetTraceWriter;
 
 enum class SocketState {
     NONE,
@@ -26,6 +31,26 @@ struct SocketStats {
     size_t bytes_received = 0;
     size_t packets_received = 0;
     size_t num_connections = 0;
+    size_t packets_compressed = 0;
+    size_t bytes_before_compression = 0;
+    size_t bytes_after_compression = 0;
+    size_t packets_decompressed = 0;
+    size_t packets_superseded = 0; // STATE packets that were replaced by a newer one before they were sent
+    size_t packets_dropped = 0; // TRANSIENT packets that were not queued because the queue was too long
+    size_t packets_streamed = 0; // Sent in chunks because they were larger than TcpSocket::chunk_size
+    size_t chunks_sent = 0;
+    size_t chunks_received = 0;
+    chrono::nanoseconds compress_time{};
+    chrono::nanoseconds decompress_time{};
+    NetTrafficStats traffic; // Uncompressed packet sizes per message type
+
+    inline f32 GetCompressionRatio() const {
+        if (this->bytes_before_compression == 0) {
+            return 1.0f;
+        }
+
+        return static_cast<f32>(this->bytes_after_compression) / static_cast<f32>(this->bytes_before_compression);
+    }
 };
 
 struct SocketBuffer {
@@ -33,11 +58,56 @@ struct SocketBuffer {
         this->queue.clear();
         this->current.clear();
         this->pos = 0;
+        this->stream = {};
+        this->stream_size = 0;
     }
 
     std::deque<Array<char>> queue;
     Array<char> current;
     size_t pos = 0;
+    Array<char> stream; // The chunks of a streamed packet that arrived so far
+    u32 stream_size = 0; // Of the streamed packet, 0 if no stream has started
+};
+
+// The send side of a socket. Packets wait in the queue until the socket can take them,
+// the number of bytes that wait is tracked so the queue can be bounded.
+//
+// A packet larger than TcpSocket::chunk_size is streamed: when it reaches the front of the
+// queue it is cut into chunks, and URGENT packets are sent in between them. Everything else
+// that was queued after it still waits for its last chunk.
+struct SendQueue {
+    struct Entry {
+        Array<char> data; // Empty if the packet was superseded or sent ahead of a stream
+        u64 key = 0; // Of a STATE packet
+        b8 urgent = false;
+    };
+
+    inline void Reset() {
+        this->queue.clear();
+        this->urgent.clear();
+        this->current.clear();
+        this->pos = 0;
+        this->current_ends_packet = true;
+        this->stream = {};
+        this->stream_pos = 0;
+        this->keyed.clear();
+        this->first_sequence = 0;
+        this->num_bytes = 0;
+        this->stream_bytes = 0;
+    }
+
+    std::deque<Entry> queue;
+    std::deque<Array<char>> urgent; // URGENT packets that go out before the next chunk of the stream
+    Array<char> current;
+    size_t pos = 0;
+    bool current_ends_packet = true; // False while current is a chunk that is not the last one
+    Array<char> stream; // The packet that is being streamed
+    size_t stream_pos = 0; // Bytes of stream that are chunked already
+    HashMap<u64, u64> keyed; // Key of a queued STATE packet -> its sequence number
+    u64 first_sequence = 0; // Sequence number of the packet at the front of the queue
+    size_t num_bytes = 0; // Waiting to be sent, including the rest of current
+    size_t stream_bytes = 0; // Part of num_bytes that belongs to packets that are or will be streamed
+    size_t peak_bytes = 0;
 };
 
 struct TcpSocket {
@@ -46,6 +116,7 @@ struct TcpSocket {
 
     inline TcpSocket(TcpSocket &&other) noexcept {
         this->SetConnectedSocket(other.sd);
+        this->trace_id = other.trace_id;
         other.sd = -1;
         other.state = SocketState::NONE;
         other.remote_address = {};
@@ -56,6 +127,7 @@ struct TcpSocket {
     TcpSocket &operator=(TcpSocket &&other) noexcept {
         if (this != &other) {
             this->SetConnectedSocket(other.sd);
+            this->trace_id = other.trace_id;
             other.sd = -1;
             other.state = SocketState::NONE;
             other.remote_address = {};
@@ -72,18 +144,60 @@ struct TcpSocket {
     void Close(bool error);
     void Connect(sockaddr_in remote_address);
     void SetConnectedSocket(net::SocketDescriptor sd);
-    void Push(const Packet &packet);
-    void Push(Packet &&packet);
+    void Push(const Packet &packet, SendPolicy policy = {});
+    void Push(Packet &&packet, SendPolicy policy = {});
+    bool TryPushCompressed(const Packet &packet, SendPolicy policy);
+    void Enqueue(Array<char> &&data, SendPolicy policy);
+    void DiscardQueuedPackets(); // Everything except the packet that is partially sent
     bool Pop(Packet &out);
     SocketResult DoConnect();
     SocketResult DoSend();
     SocketResult DoRecv();
 
+    // A large payload is queued on purpose and drains like anything else, so only the rest counts
+    inline bool IsSendQueueOverflowing() const {
+        return this->send_hard_limit != 0 && this->send.num_bytes - this->send.stream_bytes > this->send_hard_limit;
+    }
+
+    inline bool IsSendDone() const {
+        return this->send.queue.empty() && this->send.urgent.empty() && this->send.current.empty() && this->send.stream.empty();
+    }
+
+    // A packet pushed now has left the socket once stats.bytes_sent reaches this. Superseded
+    // STATE packets in front of it make this a little late, which is fine for measuring, and
+    // so does a stream that an URGENT packet overtakes.
+    inline size_t GetSendOffset() const {
+        return this->stats.bytes_sent + this->send.num_bytes;
+    }
+
+    // Payloads smaller than this are not worth the compression overhead
+    constexpr static u32 compression_threshold = 1024;
+
+    // Of a frame on the wire, larger packets are streamed
+    constexpr static u32 max_packet_size = 1'000'000;
+
+    // For max_decompressed_size of a client's socket, the level snapshot of a big world is large
+    constexpr static u32 max_decompressed_packet_size = 64'000'000;
+
+    // Packets larger than this (after compression) are streamed, see SendQueue. An URGENT packet
+    // waits for at most one chunk that is not in the kernel's buffer yet, which takes about
+    // 30 ms at 1 MBit/s.
+    constexpr static u32 chunk_size = 4096;
+
     static SocketStats global_stats;
+    static std::atomic<NetTraceWriter *> trace; // Every socket appends the packets it pushes and receives to it if set, atomic for the client's network thread
+    static u32 next_trace_id;
     SocketStats stats;
+    u32 trace_id = 0; // Identifies the connection in the trace, unique within the process
     net::SocketDescriptor sd = -1;
     SocketState state = SocketState::NONE;
+    bool compression_enabled = false; // Negotiated during the handshake
+    bool keep_compressed = false; // Received packets and chunks are queued as they arrived, for forwarding them unchanged
+    size_t send_soft_limit = 0; // Bytes, TRANSIENT packets are dropped above it. 0 for no limit
+    size_t send_hard_limit = 0; // Bytes, see IsSendQueueOverflowing. 0 for no limit
+    u32 max_stream_size = 64'000'000; // Bytes, a larger streamed packet closes the socket. 0 if the peer must not stream
+    u32 max_decompressed_size = 0; // Bytes, a compressed packet that inflates to more closes the socket. 0 until compression is negotiated
     sockaddr_in remote_address;
-    SocketBuffer send;
+    SendQueue send;
     SocketBuffer recv;
 };
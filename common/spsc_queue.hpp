@@ -0,0 +1,63 @@
+#pragma once
+
+#include "common/common.hpp"
+
+#include <atomic>
+
+// A bounded queue between exactly one producer thread and one consumer thread that gets by
+// without locks: the producer only writes tail, the consumer only writes head. Clear may
+// only be called while neither side uses the queue.
+template<typename T, size_t Capacity>
+struct SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    inline SpscQueue()
+        : slots(Capacity) {
+    }
+
+    // Producer
+    inline bool TryPush(T &&value) {
+        auto tail = this->tail.load(std::memory_order_relaxed);
+
+        if (tail - this->head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+
+        this->slots[tail & (Capacity - 1)] = ToRvalue(value);
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer
+    inline bool TryPop(T &out) {
+        auto head = this->head.load(std::memory_order_relaxed);
+
+        if (head == this->tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        out = ToRvalue(this->slots[head & (Capacity - 1)]);
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Either side, the other side may change it right away
+    inline size_t GetSize() const {
+        // head first, it never passes a tail that is loaded after it
+        auto head = this->head.load(std::memory_order_acquire);
+        return this->tail.load(std::memory_order_acquire) - head;
+    }
+
+    inline void Clear() {
+        for (auto &slot : this->slots) {
+            slot = T{};
+        }
+
+        this->head.store(0, std::memory_order_relaxed);
+        this->tail.store(0, std::memory_order_relaxed);
+    }
+
+    Array<T> slots;
+    alignas(64) std::atomic<size_t> head{0}; // Next slot to pop
+    alignas(64) std::atomic<size_t> tail{0}; // Next slot to push
+};
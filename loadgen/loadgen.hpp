@@ -0,0 +1,99 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/socket.hpp"
+#include "common/player_input.hpp"
+#include "common/net_msg.hpp"
+
+#include <random>
+
+struct LoadgenOptions {
+    String host = "127.0.0.1";
+    u16 port = 1303;
+    i32 num_clients = 100;
+    i32 players_per_session = 4;
+    f32 connects_per_second = 50.0f;
+    f32 inputs_per_second = 10.0f;
+    f32 duration_seconds = 60.0f;
+    bool fast_join = false; // Join any open lobby along with the handshake, browse only if there is none
+};
+
+struct LoadgenStats {
+    Array<f32> connect_latencies; // Milliseconds from connect() to the handshake response
+    Array<f32> lobby_latencies; // Milliseconds from connect() to the successful JoinSessionResponse
+    Array<f32> input_round_trips; // Milliseconds from sending an input to its InputAckMessage
+    HashMap<String, i32> disconnects; // By reason
+    i32 num_tick_length_corrections = 0;
+};
+
+// Drives the real protocol (handshake, session browser, lobby, ingame) over one TcpSocket
+struct SimulatedClient {
+    using Clock = chrono::high_resolution_clock;
+
+    enum class Phase {
+        IDLE,
+        CONNECTING,
+        HANDSHAKE,
+        BROWSING,
+        JOINING,
+        LOBBY,
+        INGAME,
+        DISCONNECTED,
+    };
+
+    SimulatedClient(i32 index, const LoadgenOptions &options, LoadgenStats &stats);
+    void Connect(const sockaddr_in &address);
+    void Tick();
+    void HandlePacket(Packet &&packet);
+    void RequestSessions();
+    void SendRandomInput();
+    void OnServerTime(f32 server_time);
+    void Disconnect(StringView reason);
+
+    template<typename T>
+    void Send(const T &data) {
+        Packet packet;
+        data.Serialize(packet);
+        packet.WriteHeader();
+        this->socket.Push(ToRvalue(packet));
+    }
+
+    inline String GetSessionName() const {
+        return "loadgen-{}"_format(this->index / this->options.players_per_session);
+    }
+
+    inline bool IsSessionCreator() const {
+        return this->index % this->options.players_per_session == 0;
+    }
+
+    i32 index;
+    const LoadgenOptions &options;
+    LoadgenStats &stats;
+    Phase phase = Phase::IDLE;
+    TcpSocket socket;
+    std::mt19937 rng;
+    Clock::time_point connect_started;
+    Clock::time_point next_browse{};
+    Clock::time_point next_input{};
+    bool created_session = false;
+    u32 my_tank = 0;
+    f32 time = 0.0f; // Advances by one every tick like GameState::time
+    Optional<f32> first_server_time;
+    Clock::time_point first_server_time_received;
+    f32 server_ticks_per_second = 0.0f;
+    PlayerInput input;
+    Array<PlayerInput> unacked_inputs;
+    HashMap<u32, Clock::time_point> input_sent_at;
+    Optional<TimeEcho> pending_echo;
+};
+
+template<typename T>
+T GetPercentile(Array<T> values, f32 percentile) {
+    if (values.empty()) {
+        return T{};
+    }
+
+    auto index = static_cast<size_t>(percentile / 100.0f * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
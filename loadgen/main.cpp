@@ -0,0 +1,188 @@
+#include "loadgen/loadgen.hpp"
+
+#include "common/log.hpp"
+#include "common/net_platform.hpp"
+#include "common/frame_timer.hpp"
+
+#include <charconv>
+#include <thread>
+
+static void PrintUsage() {
+    fmt::print(
+        "usage: tankgame-loadgen [--host <ip>] [--port <port>] [--clients <n>] [--session-size <n>]\n"
+        "                        [--connect-rate <per second>] [--input-rate <per second>] [--duration <seconds>]\n"
+        "                        [--fast-join <0|1>]\n");
+}
+
+template<typename T>
+static bool ParseNumber(StringView text, T &out) {
+    auto [p, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+    return ec == std::errc{} && p == text.data() + text.size();
+}
+
+static bool ParseOptions(int argc, char **argv, LoadgenOptions &options) {
+    for (int i = 1; i < argc; ++i) {
+        StringView arg = argv[i];
+
+        if (i + 1 >= argc) {
+            return false;
+        }
+
+        StringView value = argv[++i];
+        auto ok = true;
+
+        if (arg == "--host") {
+            options.host = value;
+        } else if (arg == "--port") {
+            ok = ParseNumber(value, options.port);
+        } else if (arg == "--clients") {
+            ok = ParseNumber(value, options.num_clients) && options.num_clients > 0;
+        } else if (arg == "--session-size") {
+            ok = ParseNumber(value, options.players_per_session) && options.players_per_session > 0 && options.players_per_session <= 100;
+        } else if (arg == "--connect-rate") {
+            ok = ParseNumber(value, options.connects_per_second) && options.connects_per_second > 0.0f;
+        } else if (arg == "--input-rate") {
+            ok = ParseNumber(value, options.inputs_per_second) && options.inputs_per_second > 0.0f;
+        } else if (arg == "--duration") {
+            ok = ParseNumber(value, options.duration_seconds);
+        } else if (arg == "--fast-join") {
+            i32 fast_join;
+            ok = ParseNumber(value, fast_join);
+            options.fast_join = fast_join != 0;
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void Report(const Array<UniquePtr<SimulatedClient>> &clients, const LoadgenStats &stats) {
+    i32 num_ingame = 0;
+    i32 num_disconnected = 0;
+    f32 server_ticks_per_second = 0.0f;
+
+    for (const auto &client : clients) {
+        if (client->phase == SimulatedClient::Phase::INGAME) {
+            ++num_ingame;
+            server_ticks_per_second += client->server_ticks_per_second;
+        } else if (client->phase == SimulatedClient::Phase::DISCONNECTED) {
+            ++num_disconnected;
+        }
+    }
+
+    if (num_ingame > 0) {
+        server_ticks_per_second /= num_ingame;
+    }
+
+    auto nominal_ticks_per_second = 1.0f / chrono::duration<f32>{FrameTimer::tick_length}.count();
+
+    LogInfo("loadgen", "clients={} ingame={} disconnected={} server_tps={:.2f} drift={:+.2f}%"_format(
+        clients.size(),
+        num_ingame,
+        num_disconnected,
+        server_ticks_per_second,
+        num_ingame > 0 ? 100.0f * (server_ticks_per_second / nominal_ticks_per_second - 1.0f) : 0.0f));
+
+    LogInfo("loadgen", "connect_ms p50={:.1f} p90={:.1f} p99={:.1f} max={:.1f} (n={})"_format(
+        GetPercentile(stats.connect_latencies, 50.0f),
+        GetPercentile(stats.connect_latencies, 90.0f),
+        GetPercentile(stats.connect_latencies, 99.0f),
+        GetPercentile(stats.connect_latencies, 100.0f),
+        stats.connect_latencies.size()));
+
+    LogInfo("loadgen", "lobby_ms p50={:.1f} p90={:.1f} p99={:.1f} max={:.1f} (n={})"_format(
+        GetPercentile(stats.lobby_latencies, 50.0f),
+        GetPercentile(stats.lobby_latencies, 90.0f),
+        GetPercentile(stats.lobby_latencies, 99.0f),
+        GetPercentile(stats.lobby_latencies, 100.0f),
+        stats.lobby_latencies.size()));
+
+    LogInfo("loadgen", "input_rtt_ms p50={:.1f} p90={:.1f} p99={:.1f} max={:.1f} (n={})"_format(
+        GetPercentile(stats.input_round_trips, 50.0f),
+        GetPercentile(stats.input_round_trips, 90.0f),
+        GetPercentile(stats.input_round_trips, 99.0f),
+        GetPercentile(stats.input_round_trips, 100.0f),
+        stats.input_round_trips.size()));
+
+    LogInfo("loadgen", "tick_length_corrections={}"_format(stats.num_tick_length_corrections));
+
+    for (const auto &[reason, count] : stats.disconnects) {
+        LogInfo("loadgen", "disconnects reason='{}' count={}"_format(reason, count));
+    }
+}
+
+int main(int argc, char **argv) {
+    LoadgenOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 1;
+    }
+
+#ifdef WINDOWS
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        LogError("loadgen", "WSAStartup failed");
+        return 1;
+    }
+#endif
+
+    sockaddr_in server_address{};
+    server_address.sin_family = AF_INET;
+    server_address.sin_port = htons(options.port);
+    if (inet_pton(AF_INET, options.host.c_str(), &server_address.sin_addr) != 1) {
+        LogError("loadgen", "Invalid host {}"_format(options.host));
+        return 1;
+    }
+
+    LogInfo("loadgen", "Starting {} clients against {}:{}"_format(options.num_clients, options.host, options.port));
+
+    LoadgenStats stats;
+    Array<UniquePtr<SimulatedClient>> clients;
+    for (i32 i = 0; i < options.num_clients; ++i) {
+        clients.emplace_back(std::make_unique<SimulatedClient>(i, options, stats));
+    }
+
+    using Clock = SimulatedClient::Clock;
+    auto started = Clock::now();
+    auto next_tick = started;
+    auto next_report = started + 5s;
+    auto connect_interval = chrono::duration_cast<Clock::duration>(chrono::duration<f32>{1.0f / options.connects_per_second});
+    auto next_connect = started;
+    size_t num_started = 0;
+
+    while (options.duration_seconds <= 0.0f ||
+        chrono::duration<f32>{Clock::now() - started}.count() < options.duration_seconds) {
+        auto now = Clock::now();
+
+        while (num_started < clients.size() && now >= next_connect) {
+            clients[num_started++]->Connect(server_address);
+            next_connect += connect_interval;
+        }
+
+        for (auto &client : clients) {
+            client->Tick();
+        }
+
+        if (now >= next_report) {
+            Report(clients, stats);
+            next_report += 5s;
+        }
+
+        next_tick += FrameTimer::tick_length;
+        std::this_thread::sleep_until(next_tick);
+    }
+
+    LogInfo("loadgen", "Done");
+    Report(clients, stats);
+
+#ifdef WINDOWS
+    WSACleanup();
+#endif
+
+    return 0;
+}
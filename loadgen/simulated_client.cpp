@@ -0,0 +1,357 @@
+#include "loadgen/loadgen.hpp"
+
+#include "common/net_msg.hpp"
+#include "common/net_msg_view.hpp"
+#include "common/components.hpp"
+#include "common/log.hpp"
+
+SimulatedClient::SimulatedClient(i32 index, const LoadgenOptions &options, LoadgenStats &stats)
+    : index(index)
+    , options(options)
+    , stats(stats)
+    , rng(static_cast<u32>(index) * 7919u + 1) {
+}
+
+void SimulatedClient::Connect(const sockaddr_in &address) {
+    this->connect_started = Clock::now();
+    this->phase = Phase::CONNECTING;
+    this->socket.Connect(address);
+}
+
+void SimulatedClient::Tick() {
+    auto now = Clock::now();
+
+    switch (this->phase) {
+        case Phase::IDLE:
+        case Phase::DISCONNECTED:
+            return;
+
+        case Phase::CONNECTING: {
+            if (this->socket.state == SocketState::ERROR) {
+                this->Disconnect("connect failed");
+                return;
+            }
+
+            switch (this->socket.DoConnect()) {
+                case SocketResult::DONE: {
+                    HandshakeRequest request;
+                    request.ver_major = VER_MAJOR;
+                    request.ver_minor = VER_MINOR;
+                    request.ver_build = VER_BUILD;
+                    request.supports_compression = true;
+                    this->socket.max_decompressed_size = TcpSocket::max_decompressed_packet_size; // The server may compress right after its response
+
+                    if (this->options.fast_join) {
+                        auto &fast_join = request.fast_join.emplace();
+                        fast_join.session_id = HandshakeRequest::FastJoin::any_session;
+                        fast_join.player_name = "bot{}"_format(this->index);
+                    }
+
+                    this->Send(request);
+                    this->phase = Phase::HANDSHAKE;
+                } break;
+
+                case SocketResult::ERROR:
+                    this->Disconnect("connect failed");
+                    return;
+
+                default:
+                    return;
+            }
+        } break;
+
+        case Phase::BROWSING: {
+            if (now >= this->next_browse) {
+                this->RequestSessions();
+            }
+        } break;
+
+        case Phase::INGAME: {
+            this->time += 1.0f;
+
+            if (now >= this->next_input) {
+                this->SendRandomInput();
+                this->next_input = now + chrono::duration_cast<Clock::duration>(chrono::duration<f32>{1.0f / this->options.inputs_per_second});
+            }
+
+            if (this->pending_echo.has_value()) {
+                PongMessage pong;
+                pong.echo = this->pending_echo.value();
+                pong.echo.hold_time = this->time - pong.echo.client_time;
+                this->Send(pong);
+                this->pending_echo.reset();
+            }
+        } break;
+
+        default:
+            break;
+    }
+
+    this->socket.DoRecv();
+
+    Packet packet;
+    while (this->phase != Phase::DISCONNECTED && this->socket.Pop(packet)) {
+        this->HandlePacket(ToRvalue(packet));
+    }
+
+    this->socket.DoSend();
+
+    if (this->socket.state == SocketState::ERROR && this->phase != Phase::DISCONNECTED) {
+        this->Disconnect("socket error");
+    }
+}
+
+void SimulatedClient::HandlePacket(Packet &&packet) {
+    NetMessageType type;
+    if (!packet.ReadEnum(type)) {
+        this->Disconnect("protocol error");
+        return;
+    }
+
+    switch (type) {
+        case NetMessageType::HANDSHAKE: {
+            HandshakeResponse response;
+            if (!response.Deserialize(packet) || !response.ok) {
+                this->Disconnect("handshake failed");
+                return;
+            }
+
+            auto latency = chrono::duration<f32, std::milli>{Clock::now() - this->connect_started};
+            this->stats.connect_latencies.emplace_back(latency.count());
+            this->socket.compression_enabled = response.compression;
+
+            if (this->options.fast_join) {
+                // The JoinSessionResponse follows, a failed join falls back to browsing
+                this->phase = Phase::JOINING;
+            } else {
+                this->RequestSessions();
+            }
+        } break;
+
+        case NetMessageType::GET_SESSION_INFO: {
+            GetSessionInfoResponseView response;
+            if (!response.Parse(packet)) {
+                this->Disconnect("protocol error");
+                return;
+            }
+
+            auto session_name = this->GetSessionName();
+            Optional<u16> join_session_id;
+
+            response.ForEachSession(
+                [&](const GetSessionInfoResponseView::Entry &info) {
+                    if (!join_session_id.has_value() &&
+                        info.name == session_name &&
+                        info.state == SessionState::LOBBY &&
+                        info.nplayers_connected < info.nplayers) {
+                        join_session_id = info.id;
+                    }
+                });
+
+            if (join_session_id.has_value()) {
+                JoinSessionRequest request;
+                request.session_id = join_session_id.value();
+                request.player_name = "bot{}"_format(this->index);
+                this->Send(request);
+                this->phase = Phase::JOINING;
+                return;
+            }
+
+            if (this->IsSessionCreator() && !this->created_session) {
+                CreateSessionRequest request;
+                request.num_players = this->options.players_per_session;
+                request.num_bots = 0;
+                request.name = session_name;
+                request.player_name = "bot{}"_format(this->index);
+                this->Send(request);
+                this->created_session = true;
+                this->phase = Phase::JOINING;
+                return;
+            }
+
+            // Wait for the creator of our session
+            this->next_browse = Clock::now() + 500ms;
+        } break;
+
+        case NetMessageType::CREATE_SESSION: {
+            CreateSessionResponse response;
+            if (!response.Deserialize(packet) || !response.success) {
+                this->Disconnect("create session failed");
+                return;
+            }
+
+            JoinSessionRequest request;
+            request.session_id = response.created_session_id;
+            request.player_name = "bot{}"_format(this->index);
+            this->Send(request);
+        } break;
+
+        case NetMessageType::JOIN_SESSION: {
+            JoinSessionResponse response;
+            if (!response.Deserialize(packet)) {
+                this->Disconnect("protocol error");
+                return;
+            }
+
+            if (response.result != JoinSessionResult::SUCCESS) {
+                LogWarning("loadgen", "Client {} could not join: {}"_format(this->index, ToString(response.result)));
+                this->phase = Phase::BROWSING;
+                this->next_browse = Clock::now() + 500ms;
+                return;
+            }
+
+            auto latency = chrono::duration<f32, std::milli>{Clock::now() - this->connect_started};
+            this->stats.lobby_latencies.emplace_back(latency.count());
+            this->Send(ReadyMessage{});
+            this->phase = Phase::LOBBY;
+        } break;
+
+        case NetMessageType::GAME_STARTED: {
+            GameStartedMessage message;
+            if (!message.Deserialize(packet)) {
+                this->Disconnect("protocol error");
+                return;
+            }
+
+            this->my_tank = message.player_tank;
+            this->input.weapon = static_cast<u8>(CTank{}.weapon_type);
+            this->phase = Phase::INGAME;
+        } break;
+
+        case NetMessageType::PING: {
+            PingMessage ping;
+            if (!ping.Deserialize(packet)) {
+                this->Disconnect("protocol error");
+                return;
+            }
+
+            this->OnServerTime(ping.my_time);
+
+            PongMessage pong;
+            pong.echo.server_time = ping.my_time;
+            pong.echo.client_time = this->time;
+            this->Send(pong);
+        } break;
+
+        case NetMessageType::SET_TICK_LENGTH: {
+            ++this->stats.num_tick_length_corrections;
+        } break;
+
+        case NetMessageType::INPUT_ACK: {
+            InputAckMessage ack;
+            if (!ack.Deserialize(packet)) {
+                this->Disconnect("protocol error");
+                return;
+            }
+
+            auto now = Clock::now();
+
+            if (ack.server_time.has_value()) {
+                this->OnServerTime(ack.server_time.value());
+
+                TimeEcho echo;
+                echo.server_time = ack.server_time.value();
+                echo.client_time = this->time;
+                this->pending_echo = echo;
+            }
+
+            std::erase_if(this->unacked_inputs,
+                [&](const PlayerInput &input) {
+                    return input.sequence <= ack.sequence;
+                });
+
+            std::erase_if(this->input_sent_at,
+                [&](const auto &entry) {
+                    if (entry.first > ack.sequence) {
+                        return false;
+                    }
+
+                    this->stats.input_round_trips.emplace_back(chrono::duration<f32, std::milli>{now - entry.second}.count());
+                    return true;
+                });
+        } break;
+
+        case NetMessageType::DISCONNECT: {
+            DisconnectMessage message;
+            message.Deserialize(packet);
+            this->Disconnect("server: {}"_format(ToString(message.reason)));
+        } break;
+
+        default:
+            // Lobby updates, the level, game commands etc. are not interesting for the load generator
+            break;
+    }
+}
+
+// Only asks for the sessions with our name, so thousands of other sessions on the server do not matter
+void SimulatedClient::RequestSessions() {
+    GetSessionInfoRequest request;
+    request.filter.flags = SessionFilter::NOT_FULL | SessionFilter::LOBBY_ONLY;
+    request.filter.name_prefix = this->GetSessionName();
+    this->Send(request);
+    this->phase = Phase::BROWSING;
+    this->next_browse = Clock::time_point::max();
+}
+
+void SimulatedClient::SendRandomInput() {
+    std::uniform_int_distribution dist_move{-1, 1};
+    std::uniform_real_distribution dist_rotation{0.0f, 360.0f};
+    std::uniform_real_distribution dist_chance{0.0f, 1.0f};
+
+    // Roughly what a player does: walk around, aim, click every now and then and rarely switch the weapon
+    this->input.move = static_cast<i8>(dist_move(this->rng));
+    this->input.target_turret_rotation = dist_rotation(this->rng);
+
+    if (dist_chance(this->rng) < 0.3f) {
+        this->input.fire = !this->input.fire;
+    }
+
+    if (dist_chance(this->rng) < 0.02f) {
+        this->input.weapon = (this->input.weapon + 1) % static_cast<u8>(Weapon::Type::COUNT);
+    }
+
+    this->input.sequence = this->input.sequence + 1;
+    this->unacked_inputs.emplace_back(this->input);
+    this->input_sent_at[this->input.sequence] = Clock::now();
+
+    if (this->unacked_inputs.size() > InputBundleMessage::max_inputs) {
+        this->unacked_inputs.erase(this->unacked_inputs.begin());
+    }
+
+    InputBundleMessage bundle;
+    bundle.inputs = this->unacked_inputs;
+
+    if (this->pending_echo.has_value()) {
+        bundle.echo = this->pending_echo.value();
+        bundle.echo->hold_time = this->time - bundle.echo->client_time;
+        this->pending_echo.reset();
+    }
+
+    this->Send(bundle);
+}
+
+// Server timestamps arrive with pings and input acks, both are used to measure the server's tick rate
+void SimulatedClient::OnServerTime(f32 server_time) {
+    auto now = Clock::now();
+
+    if (!this->first_server_time.has_value()) {
+        this->first_server_time = server_time;
+        this->first_server_time_received = now;
+    } else {
+        auto elapsed = chrono::duration<f32>{now - this->first_server_time_received}.count();
+        if (elapsed > 0.0f) {
+            this->server_ticks_per_second = (server_time - this->first_server_time.value()) / elapsed;
+        }
+    }
+}
+
+void SimulatedClient::Disconnect(StringView reason) {
+    if (this->phase == Phase::DISCONNECTED) {
+        return;
+    }
+
+    LogWarning("loadgen", "Client {} disconnected: {}"_format(this->index, reason));
+    ++this->stats.disconnects[String{reason}];
+    this->phase = Phase::DISCONNECTED;
+    this->socket.Close(false);
+}
@@ -0,0 +1,135 @@
+#include "netsim/netsim.hpp"
+
+#include "common/net_msg.hpp"
+#include "common/log.hpp"
+
+#include <algorithm>
+
+using Milliseconds = chrono::duration<f32, std::milli>;
+
+static InFlightMessage::Clock::duration ToDuration(f32 ms) {
+    return chrono::duration_cast<InFlightMessage::Clock::duration>(Milliseconds{ms});
+}
+
+bool NetsimLog::Open(StringView filename) {
+    this->file.open(String{filename}, std::ios::out | std::ios::trunc);
+    if (!this->file.is_open()) {
+        LogError("netsim", "Cannot open log file {}"_format(filename));
+        return false;
+    }
+
+    this->file << "time,connection,direction,type,size,delay_ms,flags\n";
+    return true;
+}
+
+void NetsimLog::Write(i32 connection_id, NetsimDirection direction, const Array<char> &data, f32 delay_ms, u8 flags) {
+    auto now = chrono::system_clock::now();
+    auto time = chrono::system_clock::to_time_t(now);
+    auto time_string = fmt::format(
+        "{:%H:%M:%S}.{:#03}",
+        *std::localtime(&time),
+        (chrono::duration_cast<chrono::milliseconds>(now.time_since_epoch()) % 1000).count());
+
+    // Compressed packets and chunks are forwarded as they are, so their type is not known
+    StringView type = "(compressed)";
+    Packet_Header header;
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    if (header.size & Packet_Header::FLAG_CHUNK) {
+        type = "(chunk)";
+    } else if (!(header.size & Packet_Header::FLAG_COMPRESSED) && data.size() > sizeof(Packet_Header)) {
+        type = ToString(static_cast<NetMessageType>(data[sizeof(Packet_Header)]));
+    }
+
+    String flags_string;
+    if (flags & InFlightMessage::REORDERED) flags_string += "reordered ";
+    if (flags & InFlightMessage::LOST)      flags_string += "lost ";
+    if (flags & InFlightMessage::STALLED)   flags_string += "stalled ";
+    if (!flags_string.empty()) flags_string.pop_back();
+
+    this->file << "{},{},{},{},{},{:.1f},{}\n"_format(
+        time_string,
+        connection_id,
+        ToString(direction),
+        type,
+        data.size(),
+        delay_ms,
+        flags_string);
+}
+
+void Link::Submit(Array<char> &&data, const LinkConditions &conditions, Clock::time_point now, std::mt19937 &rng) {
+    std::uniform_real_distribution dist_chance{0.0f, 1.0f};
+
+    InFlightMessage message;
+    message.received = now;
+    message.sequence = this->next_sequence++;
+
+    // The wire takes the bytes one after another, so a message also waits for the ones before it
+    auto wire_start = std::max(now, this->wire_free_at);
+    if (conditions.bandwidth_kbps > 0.0f) {
+        this->wire_free_at = wire_start + ToDuration(static_cast<f32>(data.size()) * 8.0f / conditions.bandwidth_kbps);
+    } else {
+        this->wire_free_at = wire_start;
+    }
+
+    auto delay_ms = conditions.latency_ms + conditions.jitter_ms * dist_chance(rng);
+
+    // TCP does not lose messages: the segment is sent again after the retransmission timeout
+    // and holds up everything behind it
+    if (conditions.loss_chance > 0.0f && dist_chance(rng) < conditions.loss_chance) {
+        delay_ms += std::max(min_retransmit_ms, 3.0f * conditions.latency_ms);
+        message.flags |= InFlightMessage::LOST;
+        ++this->stats.num_lost;
+    }
+
+    message.deliver_at = this->wire_free_at + ToDuration(delay_ms);
+
+    // The chunks of a streamed packet are one message to the application, so they keep their order
+    Packet_Header header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    auto chunk = (header.size & Packet_Header::FLAG_CHUNK) != 0;
+
+    if (!chunk && conditions.reorder_chance > 0.0f && dist_chance(rng) < conditions.reorder_chance) {
+        message.deliver_at += ToDuration(conditions.reorder_ms);
+        message.flags |= InFlightMessage::REORDERED;
+        ++this->stats.num_reordered;
+    } else {
+        // Jitter alone does not reorder a stream, a message never overtakes the one before it
+        message.deliver_at = std::max(message.deliver_at, this->in_order_at);
+        this->in_order_at = message.deliver_at;
+    }
+
+    message.data = ToRvalue(data);
+    this->in_flight.emplace_back(ToRvalue(message));
+    std::push_heap(this->in_flight.begin(), this->in_flight.end());
+}
+
+void Link::Deliver(TcpSocket &to, Clock::time_point now, Clock::time_point stalled_until, NetsimLog *log, i32 connection_id) {
+    if (now < stalled_until) {
+        for (auto &message : this->in_flight) {
+            if (message.deliver_at <= now && !(message.flags & InFlightMessage::STALLED)) {
+                message.flags |= InFlightMessage::STALLED;
+                ++this->stats.num_stalled;
+            }
+        }
+
+        return;
+    }
+
+    while (!this->in_flight.empty() && this->in_flight.front().deliver_at <= now) {
+        std::pop_heap(this->in_flight.begin(), this->in_flight.end());
+        auto message = ToRvalue(this->in_flight.back());
+        this->in_flight.pop_back();
+
+        auto delay_ms = Milliseconds{now - message.received}.count();
+        ++this->stats.num_messages;
+        this->stats.num_bytes += message.data.size();
+        this->stats.delays_ms.emplace_back(delay_ms);
+
+        if (log != nullptr) {
+            log->Write(connection_id, this->direction, message.data, delay_ms, message.flags);
+        }
+
+        to.Enqueue(ToRvalue(message.data), {});
+    }
+}
@@ -0,0 +1,281 @@
+#include "netsim/netsim.hpp"
+
+#include "common/log.hpp"
+
+#include <charconv>
+#include <thread>
+
+// Sits between the clients and the server on this machine and makes the loopback connection
+// behave like a real link: clients connect to the listen port instead of the server's port
+// (e.g. "connect 127.0.0.1:1304") and every packet is held back according to the profile.
+static void PrintUsage() {
+    fmt::print(
+        "usage: tankgame-netsim [--listen-port <port>] [--server <ip>] [--server-port <port>]\n"
+        "                       [--profile <lan|dsl|transatlantic|mobile|bad-wifi|script file>]\n"
+        "                       [--log <csv file>] [--seed <n>]\n");
+}
+
+template<typename T>
+static bool ParseNumber(StringView text, T &out) {
+    auto [p, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+    return ec == std::errc{} && p == text.data() + text.size();
+}
+
+static bool ParseOptions(int argc, char **argv, NetsimOptions &options) {
+    for (int i = 1; i < argc; ++i) {
+        StringView arg = argv[i];
+
+        if (i + 1 >= argc) {
+            return false;
+        }
+
+        StringView value = argv[++i];
+        auto ok = true;
+
+        if (arg == "--listen-port") {
+            ok = ParseNumber(value, options.listen_port);
+        } else if (arg == "--server") {
+            options.server_host = value;
+        } else if (arg == "--server-port") {
+            ok = ParseNumber(value, options.server_port);
+        } else if (arg == "--profile") {
+            options.profile = value;
+        } else if (arg == "--log") {
+            options.log_filename = String{value};
+        } else if (arg == "--seed") {
+            ok = ParseNumber(value, options.seed);
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static f32 GetPercentile(Array<f32> &values, f32 percentile) {
+    if (values.empty()) {
+        return 0.0f;
+    }
+
+    auto index = static_cast<size_t>(percentile / 100.0f * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+bool NetsimProxy::Start() {
+    if (!this->profile.Load(this->options.profile)) {
+        return false;
+    }
+
+    if (this->options.log_filename.has_value() && !this->log.emplace().Open(this->options.log_filename.value())) {
+        return false;
+    }
+
+    this->rng.seed(this->options.seed);
+
+    this->server_address.sin_family = AF_INET;
+    this->server_address.sin_port = htons(this->options.server_port);
+    if (inet_pton(AF_INET, this->options.server_host.c_str(), &this->server_address.sin_addr) != 1) {
+        LogError("netsim", "Invalid server address {}"_format(this->options.server_host));
+        return false;
+    }
+
+    this->sd = net::CreateNonBlockingSocket();
+    if (this->sd == -1) {
+        LogError("netsim", "Unable to create socket");
+        return false;
+    }
+
+    net::MakeReusable(this->sd);
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(this->options.listen_port);
+
+    if (::bind(this->sd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == -1) {
+        LogError("netsim", "Unable to bind socket");
+        return false;
+    }
+
+    if (::listen(this->sd, 16) == -1) {
+        LogError("netsim", "Unable to listen on socket");
+        return false;
+    }
+
+    LogInfo("netsim", "Forwarding 127.0.0.1:{} to {}:{} with profile {}"_format(
+        this->options.listen_port,
+        this->options.server_host,
+        this->options.server_port,
+        this->options.profile));
+    return true;
+}
+
+void NetsimProxy::DoAccept() {
+    while (true) {
+        sockaddr_in client_address;
+        auto client_socket = net::AcceptNonBlockingSocket(this->sd, &client_address);
+
+        if (client_socket == -1) {
+            if (!net::IsEWouldBlock()) {
+                LogWarning("netsim", "Failed to accept client");
+            }
+
+            return;
+        }
+
+        auto &connection = *this->connections.emplace_back(std::make_unique<NetsimConnection>());
+        connection.id = this->next_connection_id++;
+        connection.client.SetConnectedSocket(client_socket);
+        connection.client.keep_compressed = true;
+        connection.server.keep_compressed = true;
+        connection.server.Connect(this->server_address);
+        connection.links[static_cast<size_t>(NetsimDirection::UP)].direction = NetsimDirection::UP;
+        connection.links[static_cast<size_t>(NetsimDirection::DOWN)].direction = NetsimDirection::DOWN;
+
+        LogInfo("netsim", "Connection {} from {}:{}"_format(connection.id, inet_ntoa(client_address.sin_addr), ntohs(client_address.sin_port)));
+    }
+}
+
+void NetsimProxy::Tick() {
+    auto now = Clock::now();
+
+    this->DoAccept();
+    this->profile.Tick(*this, now);
+
+    auto log = this->log.has_value() ? &this->log.value() : nullptr;
+
+    for (auto &connection : this->connections) {
+        auto &client = connection->client;
+        auto &server = connection->server;
+        auto &up = connection->links[static_cast<size_t>(NetsimDirection::UP)];
+        auto &down = connection->links[static_cast<size_t>(NetsimDirection::DOWN)];
+
+        if (server.state == SocketState::CONNECTING && server.DoConnect() == SocketResult::ERROR) {
+            LogWarning("netsim", "Connection {}: cannot connect to the server"_format(connection->id));
+        }
+
+        client.DoRecv();
+        server.DoRecv();
+
+        // The sockets only frame the stream, the packets are forwarded byte for byte
+        while (!client.recv.queue.empty()) {
+            up.Submit(ToRvalue(client.recv.queue.front()), this->GetConditions(NetsimDirection::UP), now, this->rng);
+            client.recv.queue.pop_front();
+        }
+
+        while (!server.recv.queue.empty()) {
+            down.Submit(ToRvalue(server.recv.queue.front()), this->GetConditions(NetsimDirection::DOWN), now, this->rng);
+            server.recv.queue.pop_front();
+        }
+
+        if (server.state == SocketState::CONNECTED) {
+            up.Deliver(server, now, this->stalled_until[static_cast<size_t>(NetsimDirection::UP)], log, connection->id);
+        }
+
+        down.Deliver(client, now, this->stalled_until[static_cast<size_t>(NetsimDirection::DOWN)], log, connection->id);
+
+        client.DoSend();
+        server.DoSend();
+
+        // Whatever one side sent before it went away still reaches the other side, like a FIN behind the data
+        auto client_gone = client.state != SocketState::CONNECTED;
+        auto server_gone = server.state != SocketState::CONNECTED && server.state != SocketState::CONNECTING;
+
+        if (client_gone && server.state == SocketState::CONNECTED && up.in_flight.empty() && server.IsSendDone()) {
+            server.Close(false);
+        }
+
+        if (server_gone && client.state == SocketState::CONNECTED && down.in_flight.empty() && client.IsSendDone()) {
+            client.Close(false);
+        }
+
+        if (client.state != SocketState::CONNECTED && server.state != SocketState::CONNECTED && server.state != SocketState::CONNECTING) {
+            LogInfo("netsim", "Connection {} closed"_format(connection->id));
+            connection->closed = true;
+        }
+    }
+
+    std::erase_if(this->connections,
+        [](const UniquePtr<NetsimConnection> &connection) {
+            return connection->closed;
+        });
+}
+
+void NetsimProxy::Report() {
+    for (auto direction : {NetsimDirection::UP, NetsimDirection::DOWN}) {
+        LinkStats total;
+
+        for (auto &connection : this->connections) {
+            auto &stats = connection->links[static_cast<size_t>(direction)].stats;
+            total.num_messages += stats.num_messages;
+            total.num_bytes += stats.num_bytes;
+            total.num_reordered += stats.num_reordered;
+            total.num_lost += stats.num_lost;
+            total.num_stalled += stats.num_stalled;
+            total.delays_ms.insert(total.delays_ms.end(), stats.delays_ms.begin(), stats.delays_ms.end());
+            stats.delays_ms.clear();
+        }
+
+        const auto &conditions = this->GetConditions(direction);
+
+        LogInfo("netsim", "{} latency={} jitter={} kbps={} | msgs={} kib={} delay_ms p50={:.1f} p99={:.1f} max={:.1f} reordered={} lost={} stalled={}"_format(
+            ToString(direction),
+            conditions.latency_ms,
+            conditions.jitter_ms,
+            conditions.bandwidth_kbps,
+            total.num_messages,
+            total.num_bytes / 1024,
+            GetPercentile(total.delays_ms, 50.0f),
+            GetPercentile(total.delays_ms, 99.0f),
+            GetPercentile(total.delays_ms, 100.0f),
+            total.num_reordered,
+            total.num_lost,
+            total.num_stalled));
+    }
+}
+
+int main(int argc, char **argv) {
+    NetsimProxy proxy;
+    if (!ParseOptions(argc, argv, proxy.options)) {
+        PrintUsage();
+        return 1;
+    }
+
+#ifdef WINDOWS
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        LogError("netsim", "WSAStartup failed");
+        return 1;
+    }
+#endif
+
+    if (!proxy.Start()) {
+        return 1;
+    }
+
+    using Clock = NetsimProxy::Clock;
+    auto next_report = Clock::now() + 5s;
+
+    // NOTE(janh): Delays have a resolution of about a millisecond, good enough for a game that ticks every 16
+    while (true) {
+        proxy.Tick();
+
+        if (Clock::now() >= next_report) {
+            proxy.Report();
+            next_report += 5s;
+        }
+
+        std::this_thread::sleep_for(1ms);
+    }
+
+#ifdef WINDOWS
+    WSACleanup();
+#endif
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/socket.hpp"
+
+#include <random>
+#include <fstream>
+
+enum class NetsimDirection : u8 {
+    UP,   // Client to server
+    DOWN, // Server to client
+    COUNT
+};
+
+inline StringView ToString(NetsimDirection direction) {
+    return direction == NetsimDirection::UP ? "up" : "down";
+}
+
+// What one direction of the simulated link does to the messages that pass it
+struct LinkConditions {
+    f32 latency_ms = 0.0f; // One way
+    f32 jitter_ms = 0.0f; // Uniform in [0, jitter_ms] on top of the latency
+    f32 bandwidth_kbps = 0.0f; // 0 for unlimited
+    f32 reorder_chance = 0.0f; // A reordered message is held back for reorder_ms and can be overtaken
+    f32 reorder_ms = 0.0f;
+    f32 loss_chance = 0.0f; // See Link::Submit
+};
+
+struct NetsimOptions {
+    u16 listen_port = 1304;
+    String server_host = "127.0.0.1";
+    u16 server_port = 1303;
+    String profile = "lan"; // Built-in profile name or script file, see NetsimProfile
+    Optional<String> log_filename; // Per message delays as CSV
+    u32 seed = 0;
+};
+
+// One line per delivered message, the time is formatted like the game's log lines
+struct NetsimLog {
+    bool Open(StringView filename);
+    void Write(i32 connection_id, NetsimDirection direction, const Array<char> &data, f32 delay_ms, u8 flags);
+
+    std::ofstream file;
+};
+
+struct InFlightMessage {
+    using Clock = chrono::high_resolution_clock;
+
+    enum Flags : u8 {
+        REORDERED = 1 << 0,
+        LOST      = 1 << 1, // Retransmitted
+        STALLED   = 1 << 2, // Held back by a stall when it was due
+    };
+
+    Array<char> data;
+    Clock::time_point received;
+    Clock::time_point deliver_at;
+    u64 sequence = 0;
+    u8 flags = 0;
+
+    // Heap order, the message that is due first is on top
+    inline bool operator<(const InFlightMessage &other) const {
+        return this->deliver_at != other.deliver_at ? this->deliver_at > other.deliver_at : this->sequence > other.sequence;
+    }
+};
+
+struct LinkStats {
+    u64 num_messages = 0;
+    u64 num_bytes = 0;
+    u64 num_reordered = 0;
+    u64 num_lost = 0;
+    u64 num_stalled = 0;
+    Array<f32> delays_ms; // Since the last report
+};
+
+// One direction of a proxied connection. Messages are complete packets including their
+// Packet_Header, so conditions apply per message and not per TCP segment.
+struct Link {
+    using Clock = InFlightMessage::Clock;
+
+    // Retransmission timeouts never go below this, like Linux' TCP_RTO_MIN
+    constexpr static f32 min_retransmit_ms = 200.0f;
+
+    void Submit(Array<char> &&data, const LinkConditions &conditions, Clock::time_point now, std::mt19937 &rng);
+    void Deliver(TcpSocket &to, Clock::time_point now, Clock::time_point stalled_until, NetsimLog *log, i32 connection_id);
+
+    NetsimDirection direction = NetsimDirection::UP;
+    Array<InFlightMessage> in_flight; // Heap
+    Clock::time_point wire_free_at{}; // When the bandwidth limited wire is done with the last message
+    Clock::time_point in_order_at{}; // Delivery time of the last message that could not be overtaken
+    u64 next_sequence = 0;
+    LinkStats stats;
+};
+
+struct NetsimConnection {
+    i32 id = 0;
+    TcpSocket client;
+    TcpSocket server;
+    std::array<Link, static_cast<size_t>(NetsimDirection::COUNT)> links;
+    bool closed = false;
+};
+
+struct NetsimProxy;
+
+// A script that changes the conditions of all links over time, one command per line:
+//   latency <up|down|both> <ms>               One way latency
+//   jitter <up|down|both> <ms>
+//   bandwidth <up|down|both> <kbit/s>          0 for unlimited
+//   reorder <up|down|both> <chance> <ms>
+//   loss <up|down|both> <chance>
+//   stall <up|down|both> <ms>                 Holds back everything for a while, like a hiccup of a WiFi link
+//   wait <seconds>                            Keeps the conditions for a while
+//   loop                                      Starts over
+// Lines starting with # are comments.
+struct NetsimProfile {
+    using Clock = InFlightMessage::Clock;
+
+    bool Load(StringView name_or_filename);
+    void SetScript(StringView text);
+    void Tick(NetsimProxy &proxy, Clock::time_point now);
+    bool Step(NetsimProxy &proxy, const Array<String> &line, Clock::time_point now);
+
+    Array<Array<String>> script;
+    size_t position = 0;
+    Clock::time_point waiting_until{};
+};
+
+struct NetsimProxy {
+    using Clock = InFlightMessage::Clock;
+
+    bool Start();
+    void Tick();
+    void DoAccept();
+    void Report();
+
+    inline LinkConditions &GetConditions(NetsimDirection direction) {
+        return this->conditions[static_cast<size_t>(direction)];
+    }
+
+    NetsimOptions options;
+    net::SocketDescriptor sd = -1;
+    sockaddr_in server_address{};
+    Array<UniquePtr<NetsimConnection>> connections;
+    i32 next_connection_id = 1;
+    std::array<LinkConditions, static_cast<size_t>(NetsimDirection::COUNT)> conditions;
+    std::array<Clock::time_point, static_cast<size_t>(NetsimDirection::COUNT)> stalled_until{};
+    NetsimProfile profile;
+    Optional<NetsimLog> log;
+    std::mt19937 rng;
+};
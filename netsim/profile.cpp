@@ -0,0 +1,185 @@
+#include "netsim/netsim.hpp"
+
+#include "common/command_manager.hpp"
+#include "common/log.hpp"
+
+#include <sstream>
+
+struct BuiltinProfile {
+    StringView name;
+    StringView script;
+};
+
+// NOTE(janh): Latencies are one way, so the round trip is twice as long
+constexpr BuiltinProfile builtin_profiles[] = {
+    {
+        "lan",
+        "latency both 1\n"
+    },
+    {
+        "dsl",
+        "latency both 15\n"
+        "jitter both 3\n"
+        "bandwidth up 1000\n"
+        "bandwidth down 16000\n"
+    },
+    {
+        "transatlantic",
+        "latency both 50\n"
+        "jitter both 5\n"
+    },
+    {
+        "mobile",
+        "latency both 40\n"
+        "jitter both 30\n"
+        "bandwidth up 500\n"
+        "bandwidth down 2000\n"
+        "reorder both 0.01 40\n"
+        "loss both 0.01\n"
+        "wait 20\n"
+        "stall both 800\n"
+        "loop\n"
+    },
+    {
+        "bad-wifi",
+        "latency both 10\n"
+        "jitter both 40\n"
+        "loss both 0.03\n"
+        "wait 5\n"
+        "stall down 300\n"
+        "loop\n"
+    },
+};
+
+bool NetsimProfile::Load(StringView name_or_filename) {
+    for (const auto &profile : builtin_profiles) {
+        if (profile.name == name_or_filename) {
+            this->SetScript(profile.script);
+            return true;
+        }
+    }
+
+    std::ifstream ifs{String{name_or_filename}};
+    if (!ifs.is_open()) {
+        LogError("netsim", "{} is neither a built-in profile nor a readable file"_format(name_or_filename));
+        return false;
+    }
+
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    this->SetScript(ss.str());
+    return true;
+}
+
+void NetsimProfile::SetScript(StringView text) {
+    this->script.clear();
+    this->position = 0;
+    this->waiting_until = {};
+
+    std::istringstream iss{String{text}};
+    String line;
+
+    while (std::getline(iss, line)) {
+        std::istringstream line_stream{line};
+        Array<String> args;
+        String arg;
+
+        while (line_stream >> arg) {
+            args.emplace_back(ToRvalue(arg));
+        }
+
+        if (!args.empty() && args.front().front() != '#') {
+            this->script.emplace_back(ToRvalue(args));
+        }
+    }
+}
+
+void NetsimProfile::Tick(NetsimProxy &proxy, Clock::time_point now) {
+    // Run lines until one of them waits, a script that loops without waiting runs once per tick
+    auto looped = false;
+
+    while (this->position < this->script.size()) {
+        const auto &line = this->script[this->position];
+
+        if (line.front() == "loop") {
+            if (looped) {
+                return;
+            }
+
+            looped = true;
+            this->position = 0;
+            continue;
+        }
+
+        if (!this->Step(proxy, line, now)) {
+            return;
+        }
+
+        ++this->position;
+    }
+}
+
+bool NetsimProfile::Step(NetsimProxy &proxy, const Array<String> &line, Clock::time_point now) {
+    const auto &command = line.front();
+
+    if (command == "wait") {
+        f32 seconds = 0.0f;
+        GetArg(line, 1, seconds);
+
+        if (this->waiting_until == Clock::time_point{}) {
+            this->waiting_until = now + chrono::duration_cast<Clock::duration>(chrono::duration<f32>{seconds});
+        }
+
+        if (now < this->waiting_until) {
+            return false;
+        }
+
+        this->waiting_until = {};
+        return true;
+    }
+
+    String direction_name;
+    GetArg(line, 1, direction_name);
+
+    Array<NetsimDirection> directions;
+    if (direction_name == "up" || direction_name == "both") {
+        directions.emplace_back(NetsimDirection::UP);
+    }
+    if (direction_name == "down" || direction_name == "both") {
+        directions.emplace_back(NetsimDirection::DOWN);
+    }
+
+    if (directions.empty()) {
+        LogWarning("netsim", "Invalid direction '{}' in profile line '{}'"_format(direction_name, command));
+        return true;
+    }
+
+    f32 value = 0.0f;
+    GetArg(line, 2, value);
+
+    for (auto direction : directions) {
+        auto &conditions = proxy.GetConditions(direction);
+
+        if (command == "latency") {
+            conditions.latency_ms = value;
+        } else if (command == "jitter") {
+            conditions.jitter_ms = value;
+        } else if (command == "bandwidth") {
+            conditions.bandwidth_kbps = value;
+        } else if (command == "reorder") {
+            conditions.reorder_chance = value;
+            GetArg(line, 3, conditions.reorder_ms);
+        } else if (command == "loss") {
+            conditions.loss_chance = value;
+        } else if (command == "stall") {
+            auto &stalled_until = proxy.stalled_until[static_cast<size_t>(direction)];
+            stalled_until = now + chrono::duration_cast<Clock::duration>(chrono::duration<f32, std::milli>{value});
+        } else {
+            LogWarning("netsim", "Unknown profile command '{}'"_format(command));
+            return true;
+        }
+    }
+
+    LogInfo("netsim", "{} {} {}"_format(command, direction_name, value));
+    return true;
+}
@@ -0,0 +1,270 @@
+#include "server/server.hpp"
+#include "server/session.hpp"
+#include "server/server_game_state.hpp"
+#include "server/client_connection.hpp"
+#include "common/replay.hpp"
+#include "common/crc32.hpp"
+#include "common/log.hpp"
+
+#include <algorithm>
+
+// Plays a replay recorded with tankgame-sv --record back without any networking. The game
+// state is driven by the recorded commands and tick durations only, so the result must match
+// the recorded checksums. The tick timings make this usable as a profiling harness as well.
+
+struct ReplayStats {
+    Array<u32> tick_us;
+    u32 slowest_tick = 0;
+    u32 num_checksums = 0;
+    u32 num_mismatches = 0;
+};
+
+static void PrintUsage() {
+    fmt::print("usage: tankgame-replay <file> [--quiet]\n");
+}
+
+static bool ReadSession(const ReplayRecord &record, Session *&session, u32 &seed) {
+    auto packet = record.ToPacket();
+    String name;
+    i32 num_players;
+    i32 num_npcs;
+    u32 num_slots;
+
+    if (!(packet.ReadU32(seed) &&
+          packet.ReadString(name) &&
+          packet.ReadI32(num_players) &&
+          packet.ReadI32(num_npcs) &&
+          packet.ReadU32(num_slots))) {
+        return false;
+    }
+
+    auto &server = GetServer();
+    auto session_id = server.CreateSession(name, {}, num_players, num_npcs, false);
+
+    if (!session_id.has_value()) {
+        return false;
+    }
+
+    session = server.TryGetSession(session_id.value());
+
+    // Every recorded player slot gets a connection without a socket. Whatever the game
+    // state sends to them is queued and dropped after each tick.
+    for (u32 slot = 0; slot < num_slots; ++slot) {
+        b8 occupied;
+        String player_name;
+
+        if (!packet.ReadB8(occupied) || !packet.ReadString(player_name)) {
+            return false;
+        }
+
+        if (!occupied) {
+            session->players.emplace_back();
+            continue;
+        }
+
+        auto id = static_cast<i32>(server.clients.size());
+        auto &con = server.clients.emplace_back(std::make_unique<ClientConnection>(id, TcpSocket{}));
+        server.pollfds.emplace_back(pollfd{.fd = -1});
+
+        con->session_id = session->id;
+        con->player_id = static_cast<i32>(slot);
+
+        auto &player = session->players.emplace_back(con.get());
+        player->name = player_name;
+        player->ready = true;
+    }
+
+    return true;
+}
+
+static ClientConnection *GetSlotConnection(Session &session, i32 slot) {
+    if (slot < 0 || static_cast<size_t>(slot) >= session.players.size() || !session.players[slot].has_value()) {
+        return nullptr;
+    }
+
+    return session.players[slot].value().con;
+}
+
+static u32 GetPercentile(Array<u32> sorted, f32 percentile) {
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    return sorted[static_cast<size_t>(percentile * static_cast<f32>(sorted.size() - 1))];
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        PrintUsage();
+        return 1;
+    }
+
+    auto quiet = false;
+
+    for (int i = 2; i < argc; ++i) {
+        if (StringView{argv[i]} == "--quiet") {
+            quiet = true;
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    Crc32::InitTable();
+
+    ReplayReader reader;
+    if (!reader.Open(argv[1])) {
+        return 1;
+    }
+
+    Session *session = nullptr;
+    ReplayRecord record;
+    ReplayStats stats;
+    auto started = chrono::high_resolution_clock::now();
+
+    while (reader.Next(record)) {
+        if (session == nullptr && record.type != ReplayRecordType::SESSION) {
+            LogError("replay", "The replay does not start with a session record");
+            return 1;
+        }
+
+        auto packet = record.ToPacket();
+
+        switch (record.type) {
+            case ReplayRecordType::SESSION: {
+                u32 seed;
+
+                if (session != nullptr || !ReadSession(record, session, seed)) {
+                    LogError("replay", "Invalid session record");
+                    return 1;
+                }
+
+                session->StartGame(seed);
+            } break;
+
+            case ReplayRecordType::LEVEL: {
+                u32 checksum;
+
+                if (!packet.ReadU32(checksum)) {
+                    LogError("replay", "Invalid level record");
+                    return 1;
+                }
+
+                auto actual = session->game_state->ComputeChecksum();
+                if (actual != checksum) {
+                    LogError("replay", "The prepared level differs from the recording ({:08x} != {:08x})"_format(actual, checksum));
+                    return 1;
+                }
+            } break;
+
+            case ReplayRecordType::COMMAND: {
+                u32 tick;
+                i32 slot;
+
+                if (!packet.ReadU32(tick) || !packet.ReadI32(slot)) {
+                    LogError("replay", "Invalid command record");
+                    return 1;
+                }
+
+                auto con = GetSlotConnection(*session, slot);
+                if (con == nullptr || session->game_state == nullptr) {
+                    LogWarning("replay", "Command for the empty slot {} in tick {}"_format(slot, tick));
+                    break;
+                }
+
+                session->game_state->HandleCommandPacket(GameState::CommandContext{.con = con}, packet);
+            } break;
+
+            case ReplayRecordType::LEAVE: {
+                u32 tick;
+                i32 slot;
+
+                if (!packet.ReadU32(tick) || !packet.ReadI32(slot)) {
+                    LogError("replay", "Invalid leave record");
+                    return 1;
+                }
+
+                if (auto con = GetSlotConnection(*session, slot); con != nullptr) {
+                    session->Remove(*con);
+                }
+            } break;
+
+            case ReplayRecordType::TICK: {
+                u32 tick;
+                f32 dt;
+                u32 recorded_us;
+
+                if (!packet.ReadU32(tick) || !packet.ReadF32(dt) || !packet.ReadU32(recorded_us)) {
+                    LogError("replay", "Invalid tick record");
+                    return 1;
+                }
+
+                if (session->game_state == nullptr) {
+                    break;
+                }
+
+                auto tick_started = chrono::high_resolution_clock::now();
+                session->Tick(dt);
+                auto us = static_cast<u32>(chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - tick_started).count());
+
+                if (stats.tick_us.empty() || us > stats.tick_us[stats.slowest_tick]) {
+                    stats.slowest_tick = static_cast<u32>(stats.tick_us.size());
+                }
+
+                stats.tick_us.push_back(us);
+
+                if (!quiet) {
+                    LogInfo("replay_tick", "tick={} us={} recorded_us={} checksum={:08x}"_format(
+                        tick, us, recorded_us, session->game_state->ComputeChecksum()));
+                }
+
+                for (auto &player : session->players) {
+                    if (player.has_value()) {
+                        player.value().con->socket.send.Reset();
+                    }
+                }
+            } break;
+
+            case ReplayRecordType::CHECKSUM: {
+                u32 tick;
+                u32 checksum;
+
+                if (!packet.ReadU32(tick) || !packet.ReadU32(checksum)) {
+                    LogError("replay", "Invalid checksum record");
+                    return 1;
+                }
+
+                if (session->game_state == nullptr) {
+                    break;
+                }
+
+                ++stats.num_checksums;
+                auto actual = session->game_state->ComputeChecksum();
+
+                if (actual != checksum) {
+                    if (stats.num_mismatches == 0) {
+                        LogError("replay", "First divergence in tick {} ({:08x} != {:08x})"_format(tick, actual, checksum));
+                    }
+
+                    ++stats.num_mismatches;
+                }
+            } break;
+
+            default: {
+                LogWarning("replay", "Skipping unknown record type {}"_format(static_cast<i32>(record.type)));
+            } break;
+        }
+    }
+
+    auto elapsed = chrono::duration<f64>(chrono::high_resolution_clock::now() - started).count();
+    auto sorted = stats.tick_us;
+    std::sort(sorted.begin(), sorted.end());
+
+    LogInfo("replay", "{} ticks in {:.2f}s ({:.0f} ticks/s)"_format(
+        stats.tick_us.size(), elapsed, elapsed > 0.0 ? static_cast<f64>(stats.tick_us.size()) / elapsed : 0.0));
+    LogInfo("replay", "Tick duration p50={}us p99={}us max={}us (tick {})"_format(
+        GetPercentile(sorted, 0.5f), GetPercentile(sorted, 0.99f), sorted.empty() ? 0 : sorted.back(), stats.slowest_tick));
+    LogInfo("replay", "{}/{} checksums matched"_format(stats.num_checksums - stats.num_mismatches, stats.num_checksums));
+
+    return stats.num_mismatches == 0 ? 0 : 2;
+}
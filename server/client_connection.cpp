@@ -7,9 +7,16 @@
 ClientConnection::ClientConnection(i32 id, TcpSocket &&socket)
     : id(id)
     , socket(ToRvalue(socket)) {
+    this->socket.send_soft_limit = ClientConnection::send_queue_soft_limit;
+    this->socket.send_hard_limit = ClientConnection::send_queue_hard_limit;
+    this->socket.max_stream_size = 0; // Clients have nothing large to send, a chunk from one is an error
 }
 
-ClientConnection::~ClientConnection() = default;
+ClientConnection::~ClientConnection() {
+    auto &timers = GetServer().timers;
+    timers.Cancel(this->state_timer);
+    timers.Cancel(this->close_timer);
+}
 
 void ClientConnection::Start() {
     this->SetNextState(client_connection_states::MakeHandshake(this));
@@ -27,6 +34,11 @@ void ClientConnection::Close(bool force, DisconnectReason reason, StringView mes
         }
     }
 
+    auto &timers = GetServer().timers;
+    timers.Cancel(this->state_timer);
+    timers.Cancel(this->close_timer);
+    this->held_state.clear();
+
     if (force) {
         this->socket.Close(false);
         this->garbage = true;
@@ -36,28 +48,34 @@ void ClientConnection::Close(bool force, DisconnectReason reason, StringView mes
         disconnect_message.message = String{message};
         this->Send(disconnect_message);
         this->closed = true;
-        this->closed_at = chrono::high_resolution_clock::now();
+
+        this->close_timer = timers.Schedule(TimerWheel::ToTicks(ClientConnection::last_packet_timeout), [this] {
+            this->close_timer = 0;
+            this->socket.Close(false);
+            this->garbage = true;
+        });
     }
 }
 
-void ClientConnection::Tick(f32 dt, bool incoming, bool outgoing) {
+void ClientConnection::HandleEvents(bool incoming, bool outgoing) {
     if (incoming) {
         this->socket.DoRecv();
     }
 
     if (outgoing) {
         this->socket.DoSend();
-        auto send_done = this->socket.send.queue.empty() && this->socket.send.current.empty();
+        auto send_done = this->socket.IsSendDone();
 
-        if (this->closed) {
-            auto timed_out =
-                chrono::high_resolution_clock::now() >
-                    this->closed_at + ClientConnection::last_packet_timeout;
+        if (this->traced_ack.has_value() && this->socket.stats.bytes_sent >= this->traced_ack->send_offset) {
+            auto elapsed = chrono::high_resolution_clock::now() - this->traced_ack->pushed_at;
+            GetServer().input_flush_latency.Add(chrono::duration<f32, std::milli>{elapsed}.count());
+            this->traced_ack.reset();
+        }
 
-            if (send_done || timed_out) {
-                this->socket.Close(false);
-                this->garbage = true;
-            }
+        if (this->closed && send_done) {
+            GetServer().timers.Cancel(this->close_timer);
+            this->socket.Close(false);
+            this->garbage = true;
         }
     }
 
@@ -66,16 +84,21 @@ void ClientConnection::Tick(f32 dt, bool incoming, bool outgoing) {
     }
 
     if (this->state != nullptr)  {
-        this->state->Tick(dt);
-
         Packet incoming_packet;
-        while (this->socket.Pop(incoming_packet)) {
+        while (!this->closed && !this->garbage && this->socket.Pop(incoming_packet)) {
 #if 0 && SERVER
             Net_Message_Type msg;
             std::memcpy(&msg, &incoming_packet.buf[sizeof(Packet_Header)], sizeof(msg));
             log_info("recv", "received: {}"_format((int)msg));
 #endif
 
+            this->RecordSessionTraffic(NetDirection::INBOUND, incoming_packet);
+
+            if (!this->inbound_limiter.AllowMessage(GetServer().num_ticks)) {
+                this->OnRateLimited("messages");
+                continue;
+            }
+
             if (!this->state->net_message_handlers.HandlePacket(ToRvalue(incoming_packet))) {
                 this->Close(false, DisconnectReason::ERROR, "Could not find packet handler in current state");
             }
@@ -87,28 +110,154 @@ void ClientConnection::Tick(f32 dt, bool incoming, bool outgoing) {
             this->state->End();
         }
 
+        GetServer().timers.Cancel(this->state_timer);
+
         this->state = ToRvalue(this->next_state);
         this->state->Begin();
     }
 }
 
-void ClientConnection::SendPacket(Packet &&packet) {
-    if (this->closed) {
+void ClientConnection::SendPacket(Packet &&packet, SendPolicy policy) {
+    if (this->closed || this->send_queue_overflowed) {
         return;
     }
 
     packet.WriteHeader();
-    this->socket.Push(ToRvalue(packet));
+
+    if (this->HoldStatePacket(packet, policy)) {
+        return;
+    }
+
+    this->RecordSessionTraffic(NetDirection::OUTBOUND, packet);
+    this->socket.Push(ToRvalue(packet), policy);
+    GetServer().NotifySent(*this);
+    this->CheckSendQueue();
+}
+
+void ClientConnection::SendPacketCopy(const Packet &packet, SendPolicy policy) {
+    if (this->closed || this->send_queue_overflowed) {
+        return;
+    }
+
+    if (this->HoldStatePacket(packet, policy)) {
+        return;
+    }
+
+    this->RecordSessionTraffic(NetDirection::OUTBOUND, packet);
+    this->socket.Push(packet, policy);
     GetServer().NotifySent(*this);
+    this->CheckSendQueue();
+}
+
+// A client that stopped reading would make us queue every broadcast forever. Closing right
+// away is not possible because we may be in the middle of a session broadcast, so the queue
+// is emptied and the connection is closed on the next tick. The disconnect message is all
+// the client gets if it ever reads again.
+void ClientConnection::CheckSendQueue() {
+    if (!this->socket.IsSendQueueOverflowing()) {
+        return;
+    }
+
+    LogWarning("client connection", "Send queue of connection {} is over {} bytes, dropping the client"_format(
+        this->id,
+        ClientConnection::send_queue_hard_limit));
+
+    this->socket.DiscardQueuedPackets();
+    this->send_queue_overflowed = true;
+    ++GetServer().num_send_queue_overflows;
+
+    auto &timers = GetServer().timers;
+    timers.Cancel(this->close_timer);
+    this->close_timer = timers.Schedule(1, [this] {
+        this->close_timer = 0;
+        this->send_queue_overflowed = false;
+        this->Close(false, DisconnectReason::TOO_SLOW, "Your connection could not keep up");
+    });
+}
+
+// State updates are held back while the client gets them at a reduced rate, a newer one
+// with the same key replaces the held one. RELIABLE packets flush the held updates first
+// so they do not overtake one that was sent before them. TRANSIENT and URGENT packets do
+// not depend on the state and go ahead.
+bool ClientConnection::HoldStatePacket(const Packet &packet, SendPolicy policy) {
+    if (policy.send_class != SendClass::STATE) {
+        if (policy.send_class == SendClass::RELIABLE) {
+            this->FlushHeldState();
+        }
+
+        return false;
+    }
+
+    // Once the rate is back to normal, updates are still held until the held ones are flushed,
+    // a held update pushed after a newer one with the same key would supersede it in the queue
+    if (this->replication_rate.interval == ReplicationRate::min_interval && this->held_state.empty()) {
+        return false;
+    }
+
+    for (auto &[held_packet, held_policy] : this->held_state) {
+        if (held_policy.key == policy.key) {
+            held_packet = packet;
+            ++this->socket.stats.packets_superseded;
+            ++TcpSocket::global_stats.packets_superseded;
+            return true;
+        }
+    }
+
+    this->held_state.emplace_back(packet, policy);
+    return true;
 }
 
-void ClientConnection::SendPacketCopy(const Packet &packet) {
-    if (this->closed) {
+void ClientConnection::FlushHeldState() {
+    if (this->held_state.empty()) {
         return;
     }
 
-    this->socket.Push(packet);
+    for (auto &[packet, policy] : this->held_state) {
+        this->RecordSessionTraffic(NetDirection::OUTBOUND, packet);
+        this->socket.Push(ToRvalue(packet), policy);
+    }
+
+    this->held_state.clear();
     GetServer().NotifySent(*this);
+    this->CheckSendQueue();
+}
+
+void ClientConnection::TickReplication(u64 now) {
+    if (this->closed || this->send_queue_overflowed) {
+        return;
+    }
+
+    auto &rate = this->replication_rate;
+
+    if (rate.Update(now, this->socket.stats.bytes_sent, this->socket.send.num_bytes, this->clock_sync)) {
+        LogInfo("client connection", "Connection {} gets state updates every {} ticks now (bandwidth: {:.0f} bytes/tick)"_format(
+            this->id,
+            rate.interval,
+            rate.bandwidth));
+
+        if (rate.interval == ReplicationRate::min_interval) {
+            this->FlushHeldState();
+        }
+    }
+
+    if (rate.IsUpdateDue(now)) {
+        this->FlushHeldState();
+        rate.OnUpdateSent(now);
+    }
+}
+
+// The message was dropped, the client is disconnected if it keeps sending too much
+void ClientConnection::OnRateLimited(StringView what) {
+    auto &server = GetServer();
+    ++server.num_inbound_dropped;
+
+    if (this->inbound_limiter.OnViolation(server.num_ticks)) {
+        return;
+    }
+
+    LogWarning("client connection", "Connection {} keeps sending too many {}, dropping the client"_format(this->id, what));
+    ++server.num_rate_limit_disconnects;
+    this->Close(false, DisconnectReason::PROTO_ERR, "Too many {}"_format(what));
 }
 
 void ClientConnection::SetNextState(UniquePtr<ClientConnectionState> state) {
@@ -116,3 +265,19 @@ void ClientConnection::SetNextState(UniquePtr<ClientConnectionState> state) {
     assert(state != nullptr);
     this->next_state = ToRvalue(state);
 }
+
+void ClientConnection::ScheduleStateTimer(u64 delay, TimerWheel::Callback callback) {
+    auto &timers = GetServer().timers;
+    timers.Cancel(this->state_timer);
+    this->state_timer = timers.Schedule(delay, ToRvalue(callback));
+}
+
+void ClientConnection::RecordSessionTraffic(NetDirection direction, const Packet &packet) {
+    if (!this->session_id.has_value()) {
+        return;
+    }
+
+    if (auto session = GetServer().TryGetSession(this->session_id.value())) {
+        session->traffic.Record(direction, packet.buffer.data(), packet.buffer.size());
+    }
+}
@@ -5,24 +5,41 @@
 #include "common/net_msg.hpp"
 #include "common/socket.hpp"
 #include "common/disconnect_reason.hpp"
+#include "server/clock_sync.hpp"
+#include "server/replication_rate.hpp"
+#include "server/rate_limiter.hpp"
+#include "server/timer_wheel.hpp"
 
 struct ClientConnectionState;
 
 struct ClientConnection {
+    // The ack of a traced input that has not left the socket yet
+    struct TracedAck {
+        size_t send_offset = 0; // See TcpSocket::GetSendOffset
+        chrono::high_resolution_clock::time_point pushed_at;
+    };
+
     explicit ClientConnection(i32 id, TcpSocket &&socket);
     ~ClientConnection();
     void Start();
     void Close(bool force, DisconnectReason reason, StringView message);
-    void Tick(f32 dt, bool incoming, bool outgoing);
-    void SendPacket(Packet &&packet);
-    void SendPacketCopy(const Packet &packet);
+    void HandleEvents(bool incoming, bool outgoing);
+    void SendPacket(Packet &&packet, SendPolicy policy = {});
+    void SendPacketCopy(const Packet &packet, SendPolicy policy = {});
+    void CheckSendQueue();
+    bool HoldStatePacket(const Packet &packet, SendPolicy policy);
+    void FlushHeldState();
+    void TickReplication(u64 now);
+    void OnRateLimited(StringView what);
     void SetNextState(UniquePtr<ClientConnectionState> state);
+    void RecordSessionTraffic(NetDirection direction, const Packet &packet);
+    void ScheduleStateTimer(u64 delay, TimerWheel::Callback callback);
 
     template<typename T>
-    void Send(const T &data) {
+    void Send(const T &data, SendPolicy policy = {}) {
         Packet packet;
         data.Serialize(packet);
-        this->SendPacket(ToRvalue(packet));
+        this->SendPacket(ToRvalue(packet), policy);
     }
 
     inline bool IsAdmin() const {
@@ -30,6 +47,9 @@ struct ClientConnection {
     }
 
     constexpr static chrono::high_resolution_clock::duration last_packet_timeout = 2s;
+    constexpr static chrono::high_resolution_clock::duration handshake_timeout = 5s;
+    constexpr static size_t send_queue_soft_limit = 256 * 1024; // Bytes, sound effects are dropped above it
+    constexpr static size_t send_queue_hard_limit = 4 * 1024 * 1024; // Bytes, the client is disconnected above it
 
     i32 id;
     Optional<i32> session_id;
@@ -39,10 +59,15 @@ struct ClientConnection {
     TcpSocket socket;
     bool garbage = false;
     bool closed = false;
-    chrono::high_resolution_clock::time_point closed_at;
-    std::array<f32, 32> time_diff_ringbuf{};
-    std::size_t time_diff_ringbuf_pos = 0;
-    std::array<f32, 32> rtt_ringbuf{};
-    std::size_t rtt_ringbuf_pos = 0;
+    bool send_queue_overflowed = false; // Nothing is queued anymore, the connection is closed on the next tick
+    bool session_list_subscribed = false; // See SessionDirectory
+    TimerId state_timer = 0; // Owned by the current state, cancelled when the state changes
+    TimerId close_timer = 0; // Gives up on sending the remaining data after a close
+    ClockSync clock_sync;
+    ReplicationRate replication_rate;
+    InboundRateLimiter inbound_limiter;
+    Array<std::pair<Packet, SendPolicy>> held_state; // Latest STATE packet per key until the next state update, few enough for a linear search
     f32 time_last_speed_change_requested = 0.0f;
+    Optional<TracedAck> traced_ack;
+    NetTrafficRate traffic_rate;
 };
@@ -13,7 +13,6 @@ struct ClientConnectionState {
 
     virtual void Begin() = 0;
     virtual void End() = 0;
-    virtual void Tick(f32 dt) = 0;
     virtual StringView GetDisplayName() const = 0;
 
     ClientConnection *connection;
@@ -7,12 +7,13 @@ struct HandshakeState : public ClientConnectionState {
 
     void Begin() override {
         this->net_message_handlers.Add(&HandshakeState::handle_handshake, this);
-    }
 
-    void End() override {
+        this->connection->ScheduleStateTimer(TimerWheel::ToTicks(ClientConnection::handshake_timeout), [this] {
+            this->connection->Close(false, DisconnectReason::PROTO_ERR, "Handshake timed out");
+        });
     }
 
-    void Tick(f32 dt) override {
+    void End() override {
     }
 
     StringView GetDisplayName() const override {
@@ -29,10 +30,28 @@ struct HandshakeState : public ClientConnectionState {
             request.ver_major == VER_MAJOR &&
             request.ver_minor == VER_MINOR &&
             request.ver_build == VER_BUILD;
+        response.compression = response.ok && request.supports_compression;
         con.Send(response);
 
+        // The response itself goes out uncompressed, the client enables compression when it receives it
+        con.socket.compression_enabled = response.compression;
+        con.socket.max_decompressed_size = response.compression ? TcpSocket::max_packet_size : 0; // Clients send nothing large
+
         if (!response.ok) {
             GetServer().ProtoErr(con);
+            return;
+        }
+
+        if (request.fast_join.has_value()) {
+            // Answered in the same flight as the handshake response, the client waits for both
+            const auto &fast_join = request.fast_join.value();
+            auto join_response = GetServer().JoinSession(con, fast_join.session_id, fast_join.player_name, fast_join.password);
+            con.Send(join_response);
+
+            if (join_response.result == JoinSessionResult::SUCCESS) {
+                con.SetNextState(client_connection_states::MakeLobby(&con));
+                return;
+            }
         }
 
         con.SetNextState(client_connection_states::MakeJoinSession(&con));
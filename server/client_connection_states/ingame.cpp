@@ -10,24 +10,52 @@ class IngameState : public ClientConnectionState {
 
     void Begin() override {
         this->net_message_handlers.Add<NetMessageType::GAME_COMMAND>(&IngameState::handle_game_command, this);
+        this->net_message_handlers.Add(&IngameState::handle_input_bundle, this);
         this->net_message_handlers.Add(&IngameState::handle_set_tick_length_message, this);
         this->net_message_handlers.Add(&IngameState::handle_pause_game_message, this);
         //this->net_message_handlers.add(&Ingame_State::handle_ping_message, this);
         this->net_message_handlers.Add(&IngameState::handle_pong_message, this);
+        this->net_message_handlers.Add(&IngameState::HandleRequestLevelMessage, this);
+
+        this->SchedulePing();
     }
 
     void End() override {
     }
 
-    void Tick(f32 dt) override {
-        if (this->connection->session_id.has_value()) {
-            auto session = GetServer().TryGetSession(this->connection->session_id.value());
-            if (session && session->game_state) {
-                PingMessage ping;
-                ping.my_time = session->game_state->time;
-                this->connection->Send(ping);
-            }
+    // Wakes up when the next ping could be due. Timestamps usually go out with the input acks,
+    // so by then an ack has often taken care of it and the timer is just scheduled again.
+    void SchedulePing() {
+        auto &con = *this->connection;
+        auto session = con.session_id.has_value() ? GetServer().TryGetSession(con.session_id.value()) : nullptr;
+
+        if (session == nullptr || session->game_state == nullptr) {
+            return;
         }
+
+        auto delay = std::max(con.clock_sync.GetPingTime() - session->game_state->time, 1.0f);
+        con.ScheduleStateTimer(static_cast<u64>(std::ceil(delay)), [this] {
+            this->SendPingIfDue();
+        });
+    }
+
+    void SendPingIfDue() {
+        auto &con = *this->connection;
+        auto session = con.session_id.has_value() ? GetServer().TryGetSession(con.session_id.value()) : nullptr;
+
+        if (session == nullptr || session->game_state == nullptr) {
+            return;
+        }
+
+        if (con.clock_sync.IsPingDue(session->game_state->time)) {
+            PingMessage ping;
+            ping.my_time = session->game_state->time;
+            con.Send(ping, SendPolicy{.send_class = SendClass::URGENT});
+            con.clock_sync.OnTimestampSent(ping.my_time);
+            ++con.clock_sync.num_pings_sent;
+        }
+
+        this->SchedulePing();
     }
 
     StringView GetDisplayName() const override {
@@ -47,7 +75,66 @@ class IngameState : public ClientConnectionState {
             return;
         }
 
-        session->game_state->HandleCommandPacket(GameState::CommandContext{.con = &con}, packet);
+        GameCommand::Type type;
+        SendPolicy policy;
+        if (!GameState::PeekCommand(packet, type, policy)) {
+            con.Close(false, DisconnectReason::PROTO_ERR, "Invalid game command");
+            return;
+        }
+
+        if (!con.inbound_limiter.AllowCommand(GetServer().num_ticks, type)) {
+            con.OnRateLimited(ToString(type));
+            return;
+        }
+
+        if (!session->game_state->QueueCommand(session->GetPlayer(con), ToRvalue(packet), policy)) {
+            con.Close(false, DisconnectReason::PROTO_ERR, "Too many game commands");
+        }
+    }
+
+    void handle_input_bundle(const InputBundleView &message) {
+        auto &con = *this->connection;
+        if (!con.session_id.has_value()) {
+            con.Close(false, DisconnectReason::INVALID, "Can not handle input: invalid session");
+            return;
+        }
+
+        auto session = GetServer().TryGetSession(con.session_id.value());
+        if (session == nullptr || session->state != SessionState::INGAME || session->game_state == nullptr) {
+            con.Close(false, DisconnectReason::INVALID, "Can not handle input: invalid session");
+            return;
+        }
+
+        // The bundle repeats inputs that we may already have received
+        auto &player = session->GetPlayer(con);
+        auto has_new_input = false;
+
+        for (u8 i = 0; i < message.GetNumInputs(); ++i) {
+            auto input = message.GetInput(i);
+
+            if (input.sequence > player.last_received_input_sequence) {
+                player.pending_inputs.emplace_back(input);
+                player.last_received_input_sequence = input.sequence;
+                has_new_input = true;
+            }
+        }
+
+        if (has_new_input) {
+            if (message.trace_latency) {
+                player.traced_input_received_at = chrono::high_resolution_clock::now();
+            } else {
+                player.traced_input_received_at.reset();
+            }
+        }
+
+        if (player.pending_inputs.size() > SessionPlayer::max_pending_inputs) {
+            con.Close(false, DisconnectReason::PROTO_ERR, "Too many inputs");
+            return;
+        }
+
+        if (message.echo.has_value()) {
+            this->HandleTimeEcho(*session, message.echo.value());
+        }
     }
 
     void handle_set_tick_length_message(SetTickLengthMessage&& message) {
@@ -95,73 +182,84 @@ class IngameState : public ClientConnectionState {
 #endif
 
     void handle_pong_message(PongMessage&& message) {
-        auto &con = *this->connection;
-
         CHECK(this->connection->session_id.has_value());
         auto session = GetServer().TryGetSession(this->connection->session_id.value());
         CHECK(session && session->game_state);
-        auto time = session->game_state->time;
 
-        auto rtt = time - message.your_time;
-        con.rtt_ringbuf[con.rtt_ringbuf_pos++] = rtt;
-        con.rtt_ringbuf_pos %= con.rtt_ringbuf.size();
+        this->HandleTimeEcho(*session, message.echo);
+    }
+
+    void HandleRequestLevelMessage(RequestLevelMessage &&message) {
+        auto &con = *this->connection;
+        auto session = con.session_id.has_value() ? GetServer().TryGetSession(con.session_id.value()) : nullptr;
 
-        auto rtt_avg = 0.0f;
-        for (size_t i = 0; i < con.rtt_ringbuf.size(); ++i) {
-            rtt_avg += con.rtt_ringbuf[i];
+        if (session == nullptr || session->state != SessionState::INGAME || session->game_state == nullptr) {
+            con.Close(false, DisconnectReason::INVALID, "Can not send level: invalid session");
+            return;
+        }
+
+        auto &player = session->GetPlayer(con);
+        if (player.level_snapshot_sent) {
+            con.Close(false, DisconnectReason::PROTO_ERR, "Level requested twice");
+            return;
         }
 
-        rtt_avg /= con.rtt_ringbuf.size();
-        //DUMP(rtt_avg);
+        LogWarning("ingame", "Connection {} could not generate the level, sending the complete state"_format(con.id));
+        player.level_snapshot_sent = true;
+        session->game_state->SendLevelSnapshot(player);
+    }
 
-        auto half_rtt = rtt_avg / 2.0f;
-        auto server_time = message.your_time;
+    void HandleTimeEcho(Session &session, const TimeEcho &echo) {
+        auto &con = *this->connection;
+        auto &sync = con.clock_sync;
+        auto time = session.game_state->time;
 
-        // NOTE(janh): Our best guess of the client's time (in our notion of time) when the client received the ping message
-        auto approx_client_time = message.my_time - half_rtt;
+        sync.AddSample(time, echo);
 
-        // NOTE(janh): This is where the client would have been ideally when we sent the ping
-        auto target = server_time + half_rtt;
+        if (!sync.HasEstimate()) {
+            return;
+        }
 
-        // NOTE(janh): diff < 0 -> client time ahead of server, diff > 0 -> client time behind server
-        auto diff = target - approx_client_time;
-        con.time_diff_ringbuf[con.time_diff_ringbuf_pos++] = diff;
-        con.time_diff_ringbuf_pos %= con.time_diff_ringbuf.size();
+        ClockSyncMessage estimate;
+        estimate.rtt = sync.rtt;
+        estimate.last_rtt = sync.last_rtt;
+        estimate.offset = sync.offset;
+        con.Send(estimate, SendPolicy{.send_class = SendClass::URGENT});
 
         constexpr auto speed_change_cooldown = 9.0f;
-        if (con.time_last_speed_change_requested + speed_change_cooldown < time) {
-            auto diff_avg = 0.0f;
-            for (size_t i = 0; i < con.time_diff_ringbuf.size(); ++i) {
-                diff_avg += con.time_diff_ringbuf[i];
-            }
+        if (con.time_last_speed_change_requested + speed_change_cooldown >= time) {
+            return;
+        }
 
-            diff_avg /= con.time_diff_ringbuf.size();
-            //log_info("client time diff", "{:.2f} ticks {}"_format(std::abs(diff_avg), diff_avg < 0.0f ? "ahead" : "behind"));
+        //log_info("client time diff", "{:.2f} ticks {}"_format(std::abs(sync.offset), sync.offset < 0.0f ? "ahead" : "behind"));
 
-            constexpr auto punishable_offense = 50.0f;
-            constexpr auto epsilon = 3.5;
+        constexpr auto punishable_offense = 50.0f;
+        constexpr auto epsilon = 3.5;
 
 #if !defined(DEVELOPMENT) || !DEVELOPMENT
-            if (std::abs(diff_avg) > punishable_offense) {
-                log_warn("ingame", "Kicking client that can't keep up the tick rate");
-                this->connection->close(false, Disconnect_Reason::PROTO_ERR, "It looks like you could not keep up the frame rate");
-                return;
-            } else
+        if (std::abs(sync.offset) > punishable_offense) {
+            log_warn("ingame", "Kicking client that can't keep up the tick rate");
+            this->connection->close(false, Disconnect_Reason::PROTO_ERR, "It looks like you could not keep up the frame rate");
+            return;
+        } else
 #endif
-            if (diff_avg > epsilon) {
-                SetTickLengthMessage message;
-                message.tick_length_delta_microseconds = -750; // Slower
-                message.duration_milliseconds = 650; // TODO(janh): find best value
-                con.Send(message);
-            } else if (diff_avg < -epsilon) {
-                SetTickLengthMessage message;
-                message.tick_length_delta_microseconds = 750; // Faster
-                message.duration_milliseconds = 650; // TODO(janh): find best value
-                con.Send(message);
-            }
-
-            con.time_last_speed_change_requested = time;
+        if (sync.offset > epsilon) {
+            SetTickLengthMessage message;
+            message.tick_length_delta_microseconds = -750; // Slower
+            message.duration_milliseconds = 650; // TODO(janh): find best value
+            con.Send(message, SendPolicy{.send_class = SendClass::URGENT});
+            sync.Reset();
+            this->SchedulePing();
+        } else if (sync.offset < -epsilon) {
+            SetTickLengthMessage message;
+            message.tick_length_delta_microseconds = 750; // Faster
+            message.duration_milliseconds = 650; // TODO(janh): find best value
+            con.Send(message, SendPolicy{.send_class = SendClass::URGENT});
+            sync.Reset();
+            this->SchedulePing();
         }
+
+        con.time_last_speed_change_requested = time;
     }
 };
 
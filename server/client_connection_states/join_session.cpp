@@ -12,9 +12,7 @@ class Join_Session_State : public ClientConnectionState {
     }
 
     void End() override {
-    }
-
-    void Tick(f32 dt) override {
+        GetServer().session_directory.Unsubscribe(*this->connection);
     }
 
     StringView GetDisplayName() const override {
@@ -22,18 +20,31 @@ class Join_Session_State : public ClientConnectionState {
     }
 
     void handle_get_session_info_request(GetSessionInfoRequest &&request) {
-        GetSessionInfoResponse response;
-        GetServer().GetInfo(response);
-        this->connection->Send(response);
+        auto &con = *this->connection;
+        auto &directory = GetServer().session_directory;
+
+        if (request.subscribe) {
+            directory.Subscribe(con);
+        } else {
+            directory.Unsubscribe(con);
+        }
+
+        if (request.IsUnfiltered()) {
+            con.SendPacketCopy(directory.GetListing());
+        } else {
+            Packet packet;
+            directory.WriteListing(request, packet);
+            con.SendPacket(ToRvalue(packet));
+        }
     }
 
-    void handle_create_session_request(CreateSessionRequest &&request) {
+    void handle_create_session_request(const CreateSessionRequestView &request) {
         auto session_id =
             GetServer().CreateSession(
                 request.name,
                 request.password,
-                request.num_players,
-                request.num_bots,
+                request.GetNumPlayers(),
+                request.GetNumBots(),
                 false);
 
         CreateSessionResponse response;
@@ -42,25 +53,9 @@ class Join_Session_State : public ClientConnectionState {
         this->connection->Send(response);
     }
 
-    void handle_join_session_request(JoinSessionRequest &&request) {
+    void handle_join_session_request(const JoinSessionRequestView &request) {
         auto &con = *this->connection;
-        
-        JoinSessionResponse response;
-        response.result = JoinSessionResult::NOT_FOUND;
-
-        auto session = GetServer().TryGetSession(request.session_id);
-        if (session != nullptr) {
-            response.result = session->Join(con, request.player_name, request.password);
-
-            for (const auto &player : session->players) {
-                if (player.has_value()) {
-                    auto &player = session->GetPlayer(*this->connection);
-                    auto player_info = session->GetPlayerInfo(player);
-                    response.connected_players.emplace_back(ToRvalue(player_info));
-                }
-            }
-        }
-
+        auto response = GetServer().JoinSession(con, request.GetSessionId(), request.player_name, request.password);
         con.Send(response);
 
         if (response.result == JoinSessionResult::SUCCESS) {
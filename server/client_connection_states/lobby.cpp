@@ -13,9 +13,6 @@ class LobbyState : public ClientConnectionState {
     void End() override {
     }
 
-    void Tick(f32 dt) override {
-    }
-
     StringView GetDisplayName() const override {
         return "Handshake_State";
     }
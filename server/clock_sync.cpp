@@ -0,0 +1,75 @@
+#include "server/clock_sync.hpp"
+
+bool ClockSync::IsSampleDue(f32 now) const {
+    if (this->timestamp_sent_at.has_value() && now < this->timestamp_sent_at.value() + echo_timeout) {
+        return false;
+    }
+
+    return now >= this->next_sample_time;
+}
+
+bool ClockSync::IsPingDue(f32 now) const {
+    return now >= this->GetPingTime();
+}
+
+f32 ClockSync::GetPingTime() const {
+    auto time = this->next_sample_time + ping_delay;
+
+    if (this->timestamp_sent_at.has_value()) {
+        time = std::max(time, this->timestamp_sent_at.value() + echo_timeout);
+    }
+
+    return time;
+}
+
+void ClockSync::OnTimestampSent(f32 now) {
+    this->timestamp_sent_at = now;
+    ++this->num_timestamps_sent;
+}
+
+void ClockSync::AddSample(f32 now, const TimeEcho &echo) {
+    if (!this->timestamp_sent_at.has_value() || echo.server_time != this->timestamp_sent_at.value()) {
+        return; // Late echo of a timestamp that already timed out
+    }
+
+    this->timestamp_sent_at.reset();
+
+    auto rtt = std::max(now - echo.server_time - echo.hold_time, 0.0f);
+    auto half_rtt = rtt / 2.0f;
+
+    // NOTE(janh): Our best guess of the client's time (in our notion of time) when the client received the timestamp
+    auto approx_client_time = echo.client_time - half_rtt;
+
+    // NOTE(janh): This is where the client would have been ideally when we sent the timestamp
+    auto target = echo.server_time + half_rtt;
+
+    this->samples[this->next_sample_index] = Sample{.rtt = rtt, .offset = target - approx_client_time};
+    this->next_sample_index = (this->next_sample_index + 1) % window_size;
+    this->num_samples = std::min(this->num_samples + 1, window_size);
+    this->last_rtt = rtt;
+
+    auto best = std::min_element(this->samples.begin(), this->samples.begin() + this->num_samples,
+        [](const Sample &a, const Sample &b) {
+            return a.rtt < b.rtt;
+        });
+
+    auto previous_offset = this->offset;
+    this->rtt = best->rtt;
+    this->offset = best->offset;
+
+    // Back off while the estimate holds, sample quickly again when it moves
+    if (this->HasEstimate() && std::abs(this->offset - previous_offset) < stable_tolerance) {
+        this->interval = std::min(this->interval * 2.0f, max_interval);
+    } else {
+        this->interval = min_interval;
+    }
+
+    this->next_sample_time = echo.server_time + this->interval;
+}
+
+void ClockSync::Reset() {
+    this->num_samples = 0;
+    this->next_sample_index = 0;
+    this->interval = min_interval;
+    this->next_sample_time = 0.0f;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/net_msg.hpp"
+
+// Estimates the round trip time and the clock offset of one client from timestamps that
+// are echoed back by the client (see TimeEcho). Only the sample with the smallest round
+// trip time in the window is trusted, samples that were delayed by queuing are ignored.
+// Samples are requested rarely once the estimate is stable. All times are in ticks.
+struct ClockSync {
+    constexpr static size_t window_size = 8;
+    constexpr static size_t min_samples = 3; // Before that there is no estimate
+    constexpr static f32 min_interval = 15.0f; // Between two samples while the estimate is unsettled
+    constexpr static f32 max_interval = 300.0f; // Between two samples once the estimate is stable
+    constexpr static f32 stable_tolerance = 0.5f; // The estimate is stable if it changes less than this
+    constexpr static f32 ping_delay = 10.0f; // How long a due sample waits for an input ack before an explicit ping is sent
+    constexpr static f32 echo_timeout = 120.0f; // A timestamp that was not echoed in time is considered lost
+
+    struct Sample {
+        f32 rtt = 0.0f;
+        f32 offset = 0.0f;
+    };
+
+    bool IsSampleDue(f32 now) const; // The next input ack should carry a timestamp
+    bool IsPingDue(f32 now) const; // No input ack came along, a ping has to carry the timestamp
+    f32 GetPingTime() const; // When IsPingDue becomes true unless an input ack carries a timestamp before
+    void OnTimestampSent(f32 now);
+    void AddSample(f32 now, const TimeEcho &echo);
+    void Reset(); // After the client's clock was adjusted, the old samples are meaningless
+
+    inline bool HasEstimate() const {
+        return this->num_samples >= min_samples;
+    }
+
+    std::array<Sample, window_size> samples{};
+    size_t num_samples = 0;
+    size_t next_sample_index = 0;
+    f32 rtt = 0.0f; // Of the best sample in the window
+    f32 last_rtt = 0.0f; // Of the most recent sample, follows queuing delay unlike rtt
+    f32 offset = 0.0f; // < 0: client ahead of the server, > 0: client behind the server
+    f32 interval = min_interval;
+    f32 next_sample_time = 0.0f;
+    Optional<f32> timestamp_sent_at; // Waiting for the echo
+    size_t num_timestamps_sent = 0;
+    size_t num_pings_sent = 0;
+};
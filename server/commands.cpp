@@ -0,0 +1,106 @@
+#include "server/server.hpp"
+#include "common/command_manager.hpp"
+#include "common/log.hpp"
+
+void RegisterServerCommands() {
+    auto &command_manager = GetCommandManager();
+
+    command_manager.RegisterCommand(
+        "exit",
+        [](const Array<String> &args) {
+            GetServer().Quit();
+        });
+
+    command_manager.RegisterCommand(
+        "trace",
+        [](const Array<String> &args) {
+            String filename;
+
+            if (!GetArg(args, 0, filename)) {
+                LogError("trace command", "usage: trace <file> | trace off");
+            } else if (filename == "off") {
+                StopNetTrace(GetServer().net_trace);
+            } else {
+                StartNetTrace(GetServer().net_trace, filename, NetTraceRole::RECORDED_BY_SERVER);
+            }
+        });
+
+    command_manager.RegisterCommand(
+        "netstats",
+        [](const Array<String> &args) {
+            auto print_help = []() {
+                LogError("netstats command", "usage: netstats [server | session <id> | connection <id>]");
+            };
+
+            String scope = "server";
+            GetArg(args, 0, scope);
+
+            auto &server = GetServer();
+
+            if (scope == "server") {
+                server.LogNetStats(true);
+            } else if (scope == "session") {
+                i32 id;
+                if (!GetArg(args, 1, id)) {
+                    print_help();
+                    return;
+                }
+
+                auto session = server.TryGetSession(id);
+                if (session == nullptr) {
+                    LogError("netstats command", "No session {}"_format(id));
+                    return;
+                }
+
+                LogNetTrafficStats("session:{}"_format(id), session->traffic);
+            } else if (scope == "connection") {
+                i32 id;
+                if (!GetArg(args, 1, id)) {
+                    print_help();
+                    return;
+                }
+
+                auto con = server.TryGetConnection(id);
+                if (con == nullptr) {
+                    LogError("netstats command", "No connection {}"_format(id));
+                    return;
+                }
+
+                LogNetTrafficStats("connection:{}"_format(id), con->socket.stats.traffic);
+                const auto &send = con->socket.send;
+                const auto &rate = con->replication_rate;
+                LogInfo("net_stats", "scope=connection:{} state_interval={} bandwidth={:.0f} base_rtt={:.1f} rtt={:.1f} backoffs={}"_format(
+                    id,
+                    rate.interval,
+                    rate.bandwidth,
+                    rate.base_rtt.value_or(0.0f),
+                    con->clock_sync.last_rtt,
+                    rate.num_backoffs));
+                LogInfo("net_stats", "scope=connection:{} send_queue={} send_queue_bytes={} send_queue_peak={} superseded={} dropped={} compression_ratio={:.2f}"_format(
+                    id,
+                    send.queue.size(),
+                    send.num_bytes,
+                    send.peak_bytes,
+                    con->socket.stats.packets_superseded,
+                    con->socket.stats.packets_dropped,
+                    con->socket.stats.GetCompressionRatio()));
+
+                const auto &limiter = con->inbound_limiter;
+                LogInfo("net_stats", "scope=connection:{} inbound_dropped_messages={} inbound_collapsed_commands={}"_format(
+                    id,
+                    limiter.num_dropped_messages,
+                    limiter.num_collapsed_commands));
+
+                for (size_t i = 0; i < limiter.num_dropped_commands.size(); ++i) {
+                    if (limiter.num_dropped_commands[i] != 0) {
+                        LogInfo("net_stats", "scope=connection:{} command={} inbound_dropped={}"_format(
+                            id,
+                            ToString(static_cast<GameCommand::Type>(i)),
+                            limiter.num_dropped_commands[i]));
+                    }
+                }
+            } else {
+                print_help();
+            }
+        });
+}
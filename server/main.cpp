@@ -18,6 +18,19 @@ int main(int argc, char **argv) {
     int res = EXIT_SUCCESS;
     auto &server = GetServer();
 
+    for (int i = 1; i < argc; ++i) {
+        StringView arg = argv[i];
+
+        if (arg == "--record" && i + 1 < argc) {
+            server.replay_directory = argv[++i];
+            std::filesystem::create_directories(server.replay_directory.value());
+        } else if (arg == "--trace" && i + 1 < argc) {
+            StartNetTrace(server.net_trace, argv[++i], NetTraceRole::RECORDED_BY_SERVER);
+        } else {
+            LogWarning("server main", "Unknown argument {}"_format(arg));
+        }
+    }
+
     if (!server.Start()) {
         LogError("server main", "Failed to initialize");
         res = 1;
@@ -0,0 +1,32 @@
+#include "server/rate_limiter.hpp"
+
+InboundRateLimiter::InboundRateLimiter() {
+    this->messages = TokenBucket{.rate = message_rate, .burst = message_burst};
+    this->commands.fill(TokenBucket{.rate = command_rate, .burst = command_burst});
+    this->violations = TokenBucket{.rate = violation_rate, .burst = violation_burst};
+}
+
+bool InboundRateLimiter::AllowMessage(u64 now) {
+    if (this->messages.Take(now)) {
+        return true;
+    }
+
+    ++this->num_dropped_messages;
+    return false;
+}
+
+bool InboundRateLimiter::AllowCommand(u64 now, GameCommand::Type type) {
+    auto index = static_cast<size_t>(type);
+    assert(index < this->commands.size());
+
+    if (this->commands[index].Take(now)) {
+        return true;
+    }
+
+    ++this->num_dropped_commands[index];
+    return false;
+}
+
+bool InboundRateLimiter::OnViolation(u64 now) {
+    return this->violations.Take(now);
+}
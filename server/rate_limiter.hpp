@@ -0,0 +1,48 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/game_state.hpp"
+
+// Allows rate events per tick on average and bursts of up to burst events
+struct TokenBucket {
+    inline bool Take(u64 now) {
+        this->used = std::max(this->used - static_cast<f32>(now - this->last_take) * this->rate, 0.0f);
+        this->last_take = now;
+
+        if (this->used + 1.0f > this->burst) {
+            return false;
+        }
+
+        this->used += 1.0f;
+        return true;
+    }
+
+    f32 rate = 1.0f;
+    f32 burst = 1.0f;
+    f32 used = 0.0f;
+    u64 last_take = 0;
+};
+
+// Limits what one client may send, on top of the limit for all messages there is one for each
+// game command type. Messages over the limit are dropped. Every dropped message is a
+// violation, a client that keeps violating the limits is disconnected.
+struct InboundRateLimiter {
+    constexpr static f32 message_rate = 4.0f; // Per tick, a well behaved client sends one or two
+    constexpr static f32 message_burst = 120.0f;
+    constexpr static f32 command_rate = 0.5f;
+    constexpr static f32 command_burst = 16.0f;
+    constexpr static f32 violation_rate = 1.0f / 60.0f;
+    constexpr static f32 violation_burst = 30.0f; // Violations in a row before the client is disconnected
+
+    InboundRateLimiter();
+    bool AllowMessage(u64 now);
+    bool AllowCommand(u64 now, GameCommand::Type type);
+    bool OnViolation(u64 now); // Returns false if the client should be disconnected
+
+    TokenBucket messages;
+    std::array<TokenBucket, GameCommands::table_size> commands;
+    TokenBucket violations;
+    size_t num_dropped_messages = 0;
+    std::array<size_t, GameCommands::table_size> num_dropped_commands{};
+    size_t num_collapsed_commands = 0; // Made redundant by a later command in the same tick
+};
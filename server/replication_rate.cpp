@@ -0,0 +1,53 @@
+#include "server/replication_rate.hpp"
+
+bool ReplicationRate::Update(u64 now, size_t bytes_sent, size_t queued_bytes, const ClockSync &clock_sync) {
+    if (now < this->next_sample) {
+        return false;
+    }
+
+    this->next_sample = now + sample_interval;
+
+    auto elapsed = static_cast<f32>(std::max<u64>(now - this->last_sample, 1));
+    auto drained = static_cast<f32>(bytes_sent - this->last_bytes_sent) / elapsed;
+    auto was_busy = this->last_queued_bytes > 0 || queued_bytes > 0;
+    auto grew = queued_bytes > this->last_queued_bytes;
+
+    this->last_sample = now;
+    this->last_bytes_sent = bytes_sent;
+    this->last_queued_bytes = queued_bytes;
+
+    // NOTE(janh): An idle link only tells us that the bandwidth is at least what we sent
+    if (was_busy && this->bandwidth > 0.0f) {
+        this->bandwidth = this->bandwidth * 0.75f + drained * 0.25f;
+    } else {
+        this->bandwidth = std::max(this->bandwidth, drained);
+    }
+
+    auto delayed = false;
+    if (clock_sync.num_samples > 0) {
+        if (!this->base_rtt.has_value() || clock_sync.last_rtt < this->base_rtt.value()) {
+            this->base_rtt = clock_sync.last_rtt;
+        }
+
+        delayed = clock_sync.last_rtt > this->base_rtt.value() + rtt_tolerance;
+    }
+
+    auto previous_interval = this->interval;
+    auto queue_delay = this->GetQueueDelay(queued_bytes);
+
+    if (grew && queue_delay > max_queue_delay) {
+        this->num_clean_samples = 0;
+        this->interval = queue_delay > 4.0f * max_queue_delay ? max_interval : std::min(this->interval + 1, max_interval);
+    } else if (delayed) {
+        this->num_clean_samples = 0;
+    } else if (++this->num_clean_samples >= recovery_samples) {
+        this->num_clean_samples = 0;
+        this->interval = std::max(this->interval - 1, min_interval);
+    }
+
+    if (this->interval > previous_interval) {
+        ++this->num_backoffs;
+    }
+
+    return this->interval != previous_interval;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "server/clock_sync.hpp"
+
+// Decides how often one client gets state updates (SendClass::STATE packets). The link
+// is considered congested when the send queue keeps growing and holds more data than
+// the estimated bandwidth drains in a few ticks. The interval between two state updates
+// then goes up by one tick, and it comes down again after a while without congestion
+// as long as the round trip time has not risen over the best one seen.
+//
+// Reliable packets are not affected, they are always sent right away. All times are in ticks.
+struct ReplicationRate {
+    constexpr static u64 min_interval = 1; // Between two state updates, every tick
+    constexpr static u64 max_interval = 3; // A third of the tick rate
+    constexpr static u64 sample_interval = 15; // Between two congestion checks
+    constexpr static f32 max_queue_delay = 6.0f; // Time the queued data may take to drain at the estimated bandwidth
+    constexpr static f32 rtt_tolerance = 4.0f; // How much the round trip time may rise over the best one before we stop speeding up
+    constexpr static u32 recovery_samples = 8; // Congestion free checks before the interval goes down again
+
+    // Returns true if the interval changed
+    bool Update(u64 now, size_t bytes_sent, size_t queued_bytes, const ClockSync &clock_sync);
+
+    inline bool IsUpdateDue(u64 now) const {
+        return now >= this->next_update;
+    }
+
+    inline void OnUpdateSent(u64 now) {
+        this->next_update = now + this->interval;
+    }
+
+    inline f32 GetQueueDelay(size_t queued_bytes) const {
+        if (queued_bytes == 0) {
+            return 0.0f;
+        }
+
+        return this->bandwidth > 0.0f ? queued_bytes / this->bandwidth : max_queue_delay + 1.0f;
+    }
+
+    u64 interval = min_interval;
+    u64 next_update = 0;
+    u64 next_sample = 0;
+    u64 last_sample = 0;
+    size_t last_bytes_sent = 0;
+    size_t last_queued_bytes = 0;
+    f32 bandwidth = 0.0f; // Bytes per tick the link drained while it was busy
+    Optional<f32> base_rtt; // Best round trip time seen so far
+    u32 num_clean_samples = 0;
+    size_t num_backoffs = 0;
+};
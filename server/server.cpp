@@ -6,6 +6,10 @@
 #include "common/net_platform.hpp"
 #include "common/log.hpp"
 #include "common/frame_timer.hpp"
+#include "common/command_manager.hpp"
+#include "common/crc32.hpp"
+
+void RegisterServerCommands();
 
 Server::Server() = default;
 Server::~Server() = default;
@@ -13,6 +17,8 @@ Server::~Server() = default;
 bool Server::Start() {
     LogInfo("server", "Starting the server");
 
+    Crc32::InitTable();
+
     this->sd = net::CreateNonBlockingSocket();
     if (this->sd == -1) {
         LogError("server", "Unable to create socket");
@@ -38,6 +44,8 @@ bool Server::Start() {
 
     LogInfo("server", "Server running on port {}"_format(ntohs(svaddr.sin_port)));
 
+    RegisterServerCommands();
+
     // The server is the first "client".
     // This means that there would be also a client_connection allocated in the Connections array which is not used.
     this->clients.emplace_back();
@@ -100,16 +108,13 @@ void Server::MainLoop() {
 }
 
 void Server::Tick() {
-#if 0
-    for (const auto &connection : this->clients) {
-        if (connection != nullptr) {
-            log_info(
-                "socket stats client {}"_format(connection->id),
-                 "{} bytes ({} packets)"_format(
-                    connection->socket.stats.bytes_sent, connection->socket.stats.packets_sent));
-        }
+    ++this->num_ticks;
+
+    if (this->num_ticks % Server::net_stats_log_interval == 0) {
+        this->LogNetStats(false);
     }
-#endif
+
+    this->PollConsole();
 
     net::Poll(&this->pollfds[0], this->pollfds.size(), 0);
 
@@ -141,22 +146,126 @@ void Server::Tick() {
                 continue;
             }
 
+            // Connections without socket events have nothing to do, timeouts are handled by timers
+            if (fd.revents == 0 && con->next_state == nullptr) {
+                continue;
+            }
+
             auto incoming = (fd.revents & POLLIN) != 0;
             auto outgoing = (fd.revents & POLLOUT) != 0;
-            con->Tick(dt, incoming, outgoing);
+            con->HandleEvents(incoming, outgoing);
         }
     }
 
     for (auto &session : this->sessions) {
-        if (session != nullptr) {
-            if (session->state == SessionState::GARBAGE) {
-                LogInfo("server", "Removing garbage session {}"_format(session->id));
-                session.reset();
-            } else {
-                session->Tick(dt);
+        if (session != nullptr && session->state == SessionState::INGAME) {
+            session->Tick(dt);
+        }
+    }
+
+    this->timers.Advance(this->num_ticks);
+}
+
+void Server::PollConsole() {
+#ifndef WINDOWS
+    if (!this->console_enabled) {
+        return;
+    }
+
+    pollfd pfd{.fd = STDIN_FILENO, .events = POLLIN};
+    if (net::Poll(&pfd, 1, 0) <= 0 || !(pfd.revents & (POLLIN | POLLHUP))) {
+        return;
+    }
+
+    char buffer[256];
+    auto num_read = ::read(STDIN_FILENO, buffer, sizeof(buffer));
+    if (num_read <= 0) {
+        // No terminal attached (e.g. stdin is /dev/null)
+        this->console_enabled = false;
+        return;
+    }
+
+    this->console_input.append(buffer, num_read);
+
+    size_t newline;
+    while ((newline = this->console_input.find('\n')) != String::npos) {
+        Array<String> args;
+        size_t pos = 0;
+
+        while (pos < newline) {
+            auto start = this->console_input.find_first_not_of(" \t\r", pos);
+            if (start == String::npos || start >= newline) {
+                break;
+            }
+
+            auto end = std::min(this->console_input.find_first_of(" \t\r", start), newline);
+            args.emplace_back(this->console_input.substr(start, end - start));
+            pos = end;
+        }
+
+        this->console_input.erase(0, newline + 1);
+
+        if (!args.empty()) {
+            auto name = args.front();
+            args.erase(args.begin());
+            GetCommandManager().Dispatch(name, args);
+        }
+    }
+#endif
+}
+
+void Server::LogNetStats(bool detailed) {
+    const auto &global_stats = TcpSocket::global_stats;
+    LogNetTrafficSummary("server", global_stats.traffic, this->traffic_rate, this->num_ticks, 0);
+
+    if (detailed) {
+        LogNetTrafficStats("server", global_stats.traffic);
+    }
+
+    for (const auto &session : this->sessions) {
+        if (session != nullptr && session->state == SessionState::INGAME) {
+            auto scope = "session:{}"_format(session->id);
+            LogNetTrafficSummary(scope, session->traffic, session->traffic_rate, this->num_ticks, 0);
+
+            if (detailed) {
+                LogNetTrafficStats(scope, session->traffic);
+            }
+        }
+    }
+
+    for (const auto &con : this->clients) {
+        if (con != nullptr) {
+            LogNetTrafficSummary(
+                "connection:{}"_format(con->id),
+                con->socket.stats.traffic,
+                con->traffic_rate,
+                this->num_ticks,
+                con->socket.send.queue.size());
+
+            if (detailed) {
+                LogInfo("net_stats", "scope=connection:{} send_queue_bytes={} send_queue_peak={} stream_bytes={} superseded={} dropped={}"_format(
+                    con->id,
+                    con->socket.send.num_bytes,
+                    con->socket.send.peak_bytes,
+                    con->socket.send.stream_bytes,
+                    con->socket.stats.packets_superseded,
+                    con->socket.stats.packets_dropped));
             }
         }
     }
+
+    LogInfo("net_stats", "scope=server packets_superseded={} packets_dropped={} packets_streamed={} chunks_sent={} send_queue_overflows={} inbound_dropped={} rate_limit_disconnects={}"_format(
+        global_stats.packets_superseded,
+        global_stats.packets_dropped,
+        global_stats.packets_streamed,
+        global_stats.chunks_sent,
+        this->num_send_queue_overflows,
+        this->num_inbound_dropped,
+        this->num_rate_limit_disconnects));
+
+    // Only clients that trace their input latency contribute
+    LogLatencyHistogram("server", "input_queue", this->input_queue_latency);
+    LogLatencyHistogram("server", "input_flush", this->input_flush_latency);
 }
 
 void Server::NotifySent(ClientConnection &con) {
@@ -164,6 +273,16 @@ void Server::NotifySent(ClientConnection &con) {
     this->pollfds[con.id].events |= POLLOUT;
 }
 
+void Server::RemoveGarbageSession(i32 id) {
+    auto session = this->TryGetSession(id);
+    if (session == nullptr || session->state != SessionState::GARBAGE) {
+        return;
+    }
+
+    LogInfo("server", "Removing garbage session {}"_format(id));
+    this->sessions[id].reset();
+}
+
 Optional<i32> Server::CreateSession(StringView name, StringView password, i32 num_players, i32 num_npcs, bool persistent) {
     if (name.empty() || name.size() > 20) {
         LogWarning("server", "Cannot create session, invalid name");
@@ -213,39 +332,60 @@ Session *Server::TryGetSession(i32 id) {
     return this->sessions.at(id).get();
 }
 
-ClientConnection *Server::TryGetConnection(i32 id) {
-    if (static_cast<size_t>(id) >= this->clients.size()) {
-        return nullptr;
+// The lobby a fast join without a session id ends up in: the fullest one the player can join,
+// so players that do not care where they play get into a game as soon as possible
+Session *Server::FindOpenSession(StringView password) {
+    Session *best = nullptr;
+
+    for (const auto &session : this->sessions) {
+        if (session == nullptr ||
+            session->state != SessionState::LOBBY ||
+            session->password != password ||
+            session->GetNumberOfConnectedPlayers() >= session->num_players) {
+            continue;
+        }
+
+        if (best == nullptr || session->GetNumberOfConnectedPlayers() > best->GetNumberOfConnectedPlayers()) {
+            best = session.get();
+        }
     }
 
-    return this->clients.at(id).get();
+    return best;
 }
 
-void Server::GetInfo(GetSessionInfoResponse &output) const {
-    size_t num_sessions = 0;
-    for (const auto &session : this->sessions) {
-        if (session != nullptr) {
-            ++num_sessions;
-        }
+JoinSessionResponse Server::JoinSession(ClientConnection &con, u16 session_id, StringView player_name, StringView password) {
+    JoinSessionResponse response;
+    response.result = JoinSessionResult::NOT_FOUND;
+
+    auto session =
+        session_id == HandshakeRequest::FastJoin::any_session
+            ? this->FindOpenSession(password)
+            : this->TryGetSession(session_id);
+
+    if (session == nullptr) {
+        return response;
     }
 
-    output.sessions.resize(num_sessions);
-
-    size_t info_index = 0;
-    for (size_t i = 0; i < this->sessions.size(); ++i) {
-        const auto &session = this->sessions[i];
-
-        if (session != nullptr) {
-            auto &info = output.sessions[info_index];
-            info.name = session->name;
-            info.id = i;
-            info.nplayers = session->num_players;
-            info.nplayers_connected = session->GetNumberOfConnectedPlayers();
-            info.state = session->state;
-            info.haspw = !session->password.empty();
-            ++info_index;
+    response.result = session->Join(con, player_name, password);
+
+    if (response.result == JoinSessionResult::SUCCESS) {
+        // The lobby snapshot, later changes arrive as LobbyUpdateMessages
+        for (const auto &player : session->players) {
+            if (player.has_value()) {
+                response.connected_players.emplace_back(session->GetPlayerInfo(player.value()));
+            }
         }
     }
+
+    return response;
+}
+
+ClientConnection *Server::TryGetConnection(i32 id) {
+    if (static_cast<size_t>(id) >= this->clients.size()) {
+        return nullptr;
+    }
+
+    return this->clients.at(id).get();
 }
 
 void Server::DoAccept() {
@@ -277,12 +417,16 @@ void Server::DoAccept() {
         this->pollfds.emplace_back();
     }
 
-    LogInfo("server", "Client connected: {}:{}"_format(inet_ntoa(client_address.sin_addr), client_address.sin_port));
-
     auto &con = this->clients[client_id];
     assert(con == nullptr);
     TcpSocket tcp_socket;
     tcp_socket.SetConnectedSocket(client_socket);
+
+    LogInfo("server", "Client connected: {}:{} (connection {}, trace id {})"_format(
+        inet_ntoa(client_address.sin_addr),
+        client_address.sin_port,
+        client_id,
+        tcp_socket.trace_id));
     con = std::make_unique<ClientConnection>(client_id, ToRvalue(tcp_socket));
     con->Start();
 
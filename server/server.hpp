@@ -6,6 +6,9 @@
 #include "common/net_msg.hpp"
 #include "common/socket.hpp"
 #include "server/client_connection.hpp"
+#include "server/timer_wheel.hpp"
+#include "server/session_directory.hpp"
+#include "common/net_trace.hpp"
 
 struct Server {
     Server();
@@ -17,20 +20,38 @@ struct Server {
     void NotifySent(ClientConnection &con);
     Optional<i32> CreateSession(StringView name, StringView password, i32 num_players, i32 num_npcs, bool persistent);
     Session *TryGetSession(i32 id);
+    Session *FindOpenSession(StringView password);
+    JoinSessionResponse JoinSession(ClientConnection &con, u16 session_id, StringView player_name, StringView password);
     ClientConnection *TryGetConnection(i32 id);
-    void GetInfo(GetSessionInfoResponse &output) const;
     void DoAccept();
+    void PollConsole();
+    void LogNetStats(bool detailed);
+    void RemoveGarbageSession(i32 id);
 
     inline void	ProtoErr(ClientConnection &con) {
         con.Close(false, DisconnectReason::PROTO_ERR, "Protocol error");
     }
 
     constexpr static i32 default_port = 1303;
+    constexpr static u64 net_stats_log_interval = 600; // Ticks
     net::SocketDescriptor sd = -1;
     Array<pollfd> pollfds;
+    TimerWheel timers; // Advanced once per tick, declared before the connections and sessions so it outlives them
+    NetTraceWriter net_trace; // Outlives the connections as well
     Array<UniquePtr<ClientConnection>> clients;
     Array<UniquePtr<Session>> sessions;
+    SessionDirectory session_directory{this};
     bool quit_flag = false;
+    u64 num_ticks = 0;
+    u64 num_send_queue_overflows = 0; // Clients that were dropped because their send queue grew too long
+    u64 num_inbound_dropped = 0; // Messages and game commands over the clients' rate limits
+    u64 num_rate_limit_disconnects = 0;
+    LatencyHistogram input_queue_latency; // From receiving a traced input until a tick applied it
+    LatencyHistogram input_flush_latency; // From pushing the ack of a traced input until it left the socket
+    NetTrafficRate traffic_rate;
+    String console_input;
+    bool console_enabled = true;
+    Optional<String> replay_directory; // Every game is recorded to a replay file in this directory if set
 };
 
 Server &GetServer();
@@ -2,262 +2,637 @@
 
 #include "common/net_msg.hpp"
 #include "common/log.hpp"
+#include "common/crc32.hpp"
 #include <glm/glm.hpp>
 #include <algorithm>
-#include <random>
 
 #include "server/server.hpp"
 #include "server/session.hpp"
 
+// Periodic replication. Each known entity gains priority every tick, faster if it is close to
+// the client, moving fast or important. Entities over the send threshold are sent in order of
+// priority as long as the budget of the tick lasts, the others keep gaining priority.
+constexpr static f32 replication_budget = 600.0f; // Bytes per tick and client
+constexpr static f32 replication_threshold = 1.0f;
+constexpr static f32 replication_base_rate = 1.0f / 30.0f; // Priority per tick of an idle projectile next to the client
+constexpr static f32 replication_tank_importance = 2.0f;
+constexpr static f32 replication_projectile_speed = 25.0f; // Counts as fast
+
 ServerGameState::ServerGameState(Session *session)
     : session(session) {
-    this->command_callbacks[GameCommand::Type::MOVE_TANK] =
-        [](ServerGameState &state, const CommandContext &context, GameCommand &command) {
-            auto &move_tank = static_cast<MoveTankCommand &>(command);
-            auto player_tank = state.session->GetPlayer(*context.con).tank_id;
+}
 
-            if (player_tank != Entity{move_tank.entity}) {
-                return false;
-            }
+void ServerGameState::RecordCommand(const CommandContext &context, const GameCommand &command) {
+    if (this->session->replay != nullptr) {
+        this->session->RecordCommand(*context.con, command);
+    }
+}
 
-            auto &planet_position = state.entities.Get<CPlanetPosition>(player_tank);
-            planet_position.delta = move_tank.velocity;
-            move_tank.planet_position = planet_position.value;
-            return true;
-        };
+Entity ServerGameState::GetPlayerTank(const CommandContext &context) {
+    return this->session->GetPlayer(*context.con).tank_id;
+}
 
-    this->command_callbacks[GameCommand::Type::ROTATE_TURRET] =
-        [](ServerGameState &state, const CommandContext &context, GameCommand &command) {
-            auto &rotate_turret = static_cast<RotateTurretCommand &>(command);
-            auto player_tank = state.session->GetPlayer(*context.con).tank_id;
+bool ServerGameState::OnCommand(const CommandContext &context, MoveTankCommand &move_tank) {
+    auto player_tank = this->session->GetPlayer(*context.con).tank_id;
 
-            if (player_tank != Entity{rotate_turret.entity}) {
-                return false;
-            }
+    if (player_tank != Entity{move_tank.entity}) {
+        return false;
+    }
 
-            if (rotate_turret.is_absolute) {
-                state.entities.Get<CTank>(player_tank).target_turret_rotation = rotate_turret.target_rotation;
-            } else {
-                state.entities.Get<CTank>(player_tank).flags = rotate_turret.flags;
-            }
+    auto &planet_position = this->entities.Get<CPlanetPosition>(player_tank);
+    planet_position.delta = move_tank.velocity;
+    move_tank.planet_position = planet_position.value;
+    return true;
+}
+
+bool ServerGameState::OnCommand(const CommandContext &context, RotateTurretCommand &rotate_turret) {
+    auto player_tank = this->session->GetPlayer(*context.con).tank_id;
+
+    if (player_tank != Entity{rotate_turret.entity}) {
+        return false;
+    }
+
+    if (rotate_turret.is_absolute) {
+        this->entities.Get<CTank>(player_tank).target_turret_rotation = rotate_turret.target_rotation;
+    } else {
+        this->entities.Get<CTank>(player_tank).flags = rotate_turret.flags;
+    }
+
+    return true;
+}
+
+bool ServerGameState::OnCommand(const CommandContext &context, ChargeCommand &charge_command) {
+    auto player_tank = this->session->GetPlayer(*context.con).tank_id;
+    if (player_tank != Entity{charge_command.entity}) {
+        return false;
+    }
 
+    auto charging = this->entities.TryGet<CCharging>(player_tank);
+    auto &tank = this->entities.Get<CTank>(player_tank);
+
+    if (charge_command.fire) {
+        if (charging == nullptr) {
+            // Was not charging
+            return false;
+        } else if (tank.weapon_type == Weapon::Type::MACHINEGUN) {
+            // Machine gun needs no charge
+            this->entities.Remove<CCharging>(player_tank);
+            //log_debug("fire", "Stop fire machine gun");
             return true;
-        };
-
-    this->command_callbacks[GameCommand::Type::CHARGE] =
-        [](ServerGameState &state, const CommandContext &context, GameCommand &command) {
-            auto &charge_command = static_cast<ChargeCommand &>(command);
-            auto player_tank = state.session->GetPlayer(*context.con).tank_id;
-            if (player_tank != Entity{charge_command.entity}) {
-                return false;
+        }
+
+        // "Fall through": spawn projectile (see below)
+    } else {
+        if (charging == nullptr) {
+            //log_debug("fire", "Charge");
+            this->entities.Add<CCharging>(player_tank).start_time = this->time;
+
+            if (tank.weapon_type == Weapon::Type::MACHINEGUN) {
+                //log_debug("fire", "Start fire machine gun");
             }
 
-            auto charging = state.entities.TryGet<CCharging>(player_tank);
-            auto &tank = state.entities.Get<CTank>(player_tank);
-
-            if (charge_command.fire) {
-                if (charging == nullptr) {
-                    // Was not charging
-                    return false;
-                } else if (tank.weapon_type == Weapon::Type::MACHINEGUN) {
-                    // Machine gun needs no charge
-                    state.entities.Remove<CCharging>(player_tank);
-                    //log_debug("fire", "Stop fire machine gun");
-                    return true;
+            return true;
+        } else {
+            // Was already charging
+            charging->start_time = this->time;
+            return false;
+        }
+    }
+
+    auto res = this->FireProjectile(player_tank);
+    this->entities.Remove<CCharging>(player_tank);
+    return res;
+}
+
+bool ServerGameState::OnCommand(const CommandContext &context, SwitchWeaponCommand &switch_weapon) {
+    auto &tank = this->entities.Get<CTank>(this->session->GetPlayer(*context.con).tank_id);
+    tank.weapon_type = switch_weapon.weapon_type;
+    return true;
+}
+
+bool ServerGameState::OnCommand(const CommandContext &context, SetViewCommand &set_view) {
+    this->session->GetPlayer(*context.con).interest.camera_sector = GetSector(set_view.position);
+    return true;
+}
+
+void ServerGameState::Prepare() {
+    LogInfo("server_game_state prepare", "creating player tanks");
+
+    auto num_players = std::count_if(this->session->players.begin(), this->session->players.end(),
+        [](const auto &player) {
+            return player.has_value();
+        });
+    auto num_planets = this->session->players.size() + this->session->num_npcs + 3;
+
+    this->level = MakeLevelDescriptor(this->rng.Next(), num_planets, num_players + this->session->num_npcs);
+
+    Array<Entity> tanks;
+    auto generated = this->GenerateLevel(this->level, tanks);
+    assert(generated);
+
+    // The player tanks come first, the rest are NPCs
+    size_t tank_index = 0;
+    for (auto &player : this->session->players) {
+        if (player.has_value()) {
+            player.value().tank_id = tanks[tank_index++];
+        }
+    }
+
+    // All tanks are part of the level, so every client knows them initially.
+    // UpdateInterest sends leave events for the ones that are too far away.
+    for (auto &player : this->session->players) {
+        if (player.has_value()) {
+            auto &interest = player.value().interest;
+            interest = PlayerInterest{};
+            interest.tank_sector = GetSector(this->GetTankWorldPosition(player.value().tank_id));
+
+            this->entities.View<CTank>().each(
+                [&](Entity entity, CTank &tank) {
+                    interest.known_entities.insert(entity);
+                });
+        }
+    }
+
+    this->level_checksum = this->ComputeChecksum();
+}
+
+void ServerGameState::DestroyEntity(Entity entity) {
+    if (this->entities.TryGet<CTank>(entity) != nullptr) {
+        PlaySfxCommand play_sfx;
+        play_sfx.sfx = PlaySfxCommand::Sfx::TANK_EXPLOSION;
+        this->BroadcastPositionalCommand(this->GetTankWorldPosition(entity), play_sfx);
+    }
+
+    DestroyEntityCommand destroy_entitiy_command;
+    destroy_entitiy_command.target = entt::to_integral(entity);
+    this->BroadcastEntityCommand(entity, destroy_entitiy_command);
+
+    this->entities.Destroy(entity);
+
+    for (auto &player : this->session->players) {
+        if (player.has_value()) {
+            player.value().interest.known_entities.erase(entity);
+        }
+    }
+}
+
+bool ServerGameState::FireProjectile(Entity firing_tank) {
+    auto volley = this->Fire(firing_tank, false);
+    if (!volley.has_value()) {
+        //log_debug("projectile spawn", "no projectile");
+        // Could not fire, maybe due to cooldown etc.
+        return false;
+    }
+
+    // The clients spawn the projectiles and play the sound themselves
+    Array<Entity> projectiles;
+    auto &weapon = g_weapons[static_cast<size_t>(volley.value().weapon_type)];
+    for (u32 i = 0; i < weapon.burst; ++i) {
+        projectiles.emplace_back(EntityRegistry::GetConsecutiveEntity(Entity{volley.value().first_projectile}, i));
+    }
+
+    this->BroadcastPositionalCommand(volley.value().position, volley.value(), projectiles);
+    return true;
+}
+
+// Returns false if the player has too many commands queued. A STATE command replaces the
+// queued one with the same key, it goes to the back of the queue like in the send queue.
+bool ServerGameState::QueueCommand(SessionPlayer &player, Packet &&packet, SendPolicy policy) {
+    auto &pending = player.pending_commands;
+    u64 key = policy.send_class == SendClass::STATE ? policy.key : 0;
+
+    if (key != 0) {
+        auto it = std::find_if(pending.begin(), pending.end(),
+            [&](const PendingCommand &command) {
+                return command.key == key;
+            });
+
+        if (it != pending.end()) {
+            pending.erase(it);
+            ++player.con->inbound_limiter.num_collapsed_commands;
+        }
+    }
+
+    if (pending.size() >= SessionPlayer::max_pending_commands) {
+        return false;
+    }
+
+    pending.emplace_back(PendingCommand{.packet = ToRvalue(packet), .key = key});
+    return true;
+}
+
+void ServerGameState::ApplyInputs() {
+    for (auto &player : this->session->players) {
+        if (!player.has_value()) {
+            continue;
+        }
+
+        auto &inputs = player.value().pending_inputs;
+        auto &con = *player.value().con;
+
+        if (!inputs.empty()) {
+            // Only the last input of the tick is applied, except for the ones that press or
+            // release the trigger. The inputs in between would only cause commands that the
+            // next one makes redundant.
+            for (size_t i = 0; i + 1 < inputs.size(); ++i) {
+                if (inputs[i].fire != player.value().applied_input.fire) {
+                    this->ApplyInput(player.value(), inputs[i]);
+                } else {
+                    ++con.inbound_limiter.num_collapsed_commands;
                 }
+            }
 
-                // "Fall through": spawn projectile (see below)
-            } else {
-                if (charging == nullptr) {
-                    //log_debug("fire", "Charge");
-                    state.entities.Add<CCharging>(player_tank).start_time = state.time;
+            this->ApplyInput(player.value(), inputs.back());
 
-                    if (tank.weapon_type == Weapon::Type::MACHINEGUN) {
-                        //log_debug("fire", "Start fire machine gun");
-                    }
+            InputAckMessage ack;
+            ack.sequence = inputs.back().sequence;
+            inputs.clear();
 
-                    return true;
+            if (con.clock_sync.IsSampleDue(this->time)) {
+                // The ack waits for a stream like the commands it acknowledges, the timestamp goes ahead in a ping
+                if (con.socket.send.stream_bytes > 0) {
+                    PingMessage ping;
+                    ping.my_time = this->time;
+                    con.Send(ping, SendPolicy{.send_class = SendClass::URGENT});
+                    ++con.clock_sync.num_pings_sent;
                 } else {
-                    // Was already charging
-                    charging->start_time = state.time;
-                    return false;
+                    ack.server_time = this->time;
                 }
+
+                con.clock_sync.OnTimestampSent(this->time);
             }
 
-            auto res = state.FireProjectile(player_tank);
-            state.entities.Remove<CCharging>(player_tank);
-            return res;
-        };
+            auto &received_at = player.value().traced_input_received_at;
+            if (received_at.has_value()) {
+                auto now = chrono::high_resolution_clock::now();
+                auto queued = chrono::duration_cast<chrono::microseconds>(now - received_at.value());
+                GetServer().input_queue_latency.Add(chrono::duration<f32, std::milli>{queued}.count());
 
-    this->command_callbacks[GameCommand::Type::SWITCH_WEAPON] =
-        [](ServerGameState &state, const CommandContext &context, GameCommand &command) {
-            auto &switch_weapon = static_cast<SwitchWeaponCommand &>(command);
-            auto &tank = state.entities.Get<CTank>(state.session->GetPlayer(*context.con).tank_id);
-            tank.weapon_type = switch_weapon.weapon_type;
-            return true;
-        };
-}
+                ack.timing = InputLatencyTiming{
+                    .tick = this->session->game_tick,
+                    .queued_us = static_cast<u32>(queued.count()),
+                };
+
+                received_at.reset();
+            }
+
+            con.Send(ack);
+
+            // The oldest ack that is still waiting is kept, a later one would leave the socket with it anyway
+            if (ack.timing.has_value() && !con.traced_ack.has_value()) {
+                con.traced_ack = ClientConnection::TracedAck{
+                    .send_offset = con.socket.GetSendOffset(),
+                    .pushed_at = chrono::high_resolution_clock::now(),
+                };
+            }
+        }
 
-void ServerGameState::Serialize(Packet &packet) const {
-    packet.WriteU8(this->background_color.r);
-    packet.WriteU8(this->background_color.g);
-    packet.WriteU8(this->background_color.b);
-    packet.WriteU8(this->background_color.a);
-    packet.WriteF32(this->size.x);
-    packet.WriteF32(this->size.y);
-    SerializeEntities(this->entities, packet);
+        CommandContext context{.con = &con};
+        for (auto &command : player.value().pending_commands) {
+            this->HandleCommandPacket(context, command.packet);
+        }
+
+        player.value().pending_commands.clear();
+    }
 }
 
-bool ServerGameState::HandleCommand(const CommandContext &context, GameCommand &command) {
-    auto it = this->command_callbacks.find(command.type);
+void ServerGameState::ApplyInput(SessionPlayer &player, const PlayerInput &input) {
+    auto &applied = player.applied_input;
 
-    if (it == this->command_callbacks.end()) {
-        return false;
+    if (!this->entities.IsValid(player.tank_id)) {
+        applied = input;
+        return;
     }
 
-    auto succeeded = it->second(*this, context, command);
+    // Translate the state changes into the corresponding commands, so they are validated
+    // and replicated just like single commands
+    CommandContext context{.con = player.con};
+    auto tank_id = entt::to_integral(player.tank_id);
 
-#if SERVER
-    if (succeeded) {
-        GameCommandMessage message;
-        Packet packet;
-        message.Serialize(packet);
-        this->SerializeCommand(command, packet);
-        this->session->BroadcastPacket(ToRvalue(packet));
+    if (input.move != applied.move) {
+        MoveTankCommand move_tank;
+        move_tank.entity = tank_id;
+        move_tank.velocity = CTank::MOVE_SPEED * std::clamp<i8>(input.move, -1, 1);
+        this->HandleCommand(context, move_tank);
     }
-#endif // SERVER
 
-    return succeeded;
+    if (input.turret_flags != applied.turret_flags) {
+        RotateTurretCommand rotate_turret;
+        rotate_turret.is_absolute = false;
+        rotate_turret.entity = tank_id;
+        rotate_turret.flags = input.turret_flags;
+        this->HandleCommand(context, rotate_turret);
+    }
+
+    if (input.target_turret_rotation != applied.target_turret_rotation) {
+        RotateTurretCommand rotate_turret;
+        rotate_turret.is_absolute = true;
+        rotate_turret.entity = tank_id;
+        rotate_turret.target_rotation = input.target_turret_rotation;
+        this->HandleCommand(context, rotate_turret);
+    }
+
+    if (input.fire != applied.fire) {
+        // Pressing starts charging, releasing fires
+        ChargeCommand charge;
+        charge.entity = tank_id;
+        charge.fire = !input.fire;
+        this->HandleCommand(context, charge);
+    }
+
+    auto weapon_type = static_cast<Weapon::Type>(input.weapon);
+    if (weapon_type < Weapon::Type::COUNT && weapon_type != this->entities.Get<CTank>(player.tank_id).weapon_type) {
+        SwitchWeaponCommand switch_weapon;
+        switch_weapon.weapon_type = weapon_type;
+        this->HandleCommand(context, switch_weapon);
+    }
+
+    applied = input;
 }
 
-void ServerGameState::Prepare() {
-    LogInfo("server_game_state prepare", "creating player tanks");
+void ServerGameState::UpdateInterest() {
+    // Bucket all replicated entities by sector. Planets are not included because
+    // every client needs them for the gravity simulation.
+    HashMap<u64, Array<Entity>> sectors;
+
+    this->entities.View<CTank>().each(
+        [&](Entity entity, CTank &tank) {
+            sectors[GetSectorKey(GetSector(this->GetTankWorldPosition(entity)))].emplace_back(entity);
+        });
+
+    this->entities.View<CProjectile, CPosition>().each(
+        [&](Entity entity, CProjectile &projectile, CPosition &position) {
+            sectors[GetSectorKey(GetSector(position.value))].emplace_back(entity);
+        });
+
+    HashSet<Entity> relevant_entities;
+    HashSet<u64> visited_sectors;
+
+    auto collect_sectors = [&](Vec2i center) {
+        for (auto y = -sector_interest_radius; y <= sector_interest_radius; ++y) {
+            for (auto x = -sector_interest_radius; x <= sector_interest_radius; ++x) {
+                auto key = GetSectorKey(center + Vec2i{x, y});
+                if (!visited_sectors.insert(key).second) {
+                    continue;
+                }
 
-    constexpr Vec2 planet_padding{300.0f, 300.0f};
-    constexpr Vec2 planet_spacing{480.0f, 480.0f};
-    constexpr Vec2i planet_grid_size{4, 4};
-
-    std::uniform_real_distribution dist_displacement{-170.0f, 170.0f};
-    std::uniform_real_distribution dist_mass{17.0f, 32.0f};
-    std::uniform_real_distribution dist_radius{70.0f, 120.0f};
-    std::uniform_int_distribution  dist_color{0, 140};
-    std::uniform_real_distribution dist_planet_position{0.0f, 360.0f};
-    std::uniform_int_distribution  dist_background_color_red{4, 10};
-    std::uniform_int_distribution  dist_background_color_green{4, 20};
-    std::uniform_int_distribution  dist_background_color_blue{20, 40};
-
-    this->background_color = Color{
-        dist_background_color_red(this->rng),
-        dist_background_color_green(this->rng),
-        dist_background_color_blue(this->rng),
-        255
+                auto it = sectors.find(key);
+                if (it != sectors.end()) {
+                    relevant_entities.insert(it->second.begin(), it->second.end());
+                }
+            }
+        }
     };
 
-    auto num_planets = this->session->players.size() + this->session->num_npcs + 3;
+    for (auto &player : this->session->players) {
+        if (!player.has_value()) {
+            continue;
+        }
 
-    Array<Entity> planets;
+        auto &interest = player.value().interest;
 
-    for (size_t i = 0; i < num_planets; ++i) {
-        auto planet = CreateEntity(this->entities, EntityPrefabId::PLANET);
-        planets.emplace_back(planet);
+        if (this->entities.IsValid(player.value().tank_id)) {
+            interest.tank_sector = GetSector(this->GetTankWorldPosition(player.value().tank_id));
+        }
 
-        this->size = 2.0f * planet_padding + Vec2{planet_grid_size} * planet_spacing;
-        auto displacement = Vec2{dist_displacement(this->rng), dist_displacement(this->rng)};
-        auto position = planet_padding + Vec2{(i % planet_grid_size.x), i / planet_grid_size.y} * planet_spacing + displacement;
-        this->entities.Get<CPosition>(planet).value = position;
-        this->entities.Get<CMass>(planet).value = dist_mass(this->rng);
-        this->entities.Get<CPlanet>(planet).radius = dist_radius(this->rng);
-        this->entities.Get<CPlanet>(planet).initial_position = position;
-        //this->entities.Get<CRenderColor>(planet).value = Color{dist_color(this->rng), dist_color(this->rng), dist_color(this->rng), 255};
-    }
+        relevant_entities.clear();
+        visited_sectors.clear();
+        collect_sectors(interest.tank_sector);
 
-    std::shuffle(planets.begin(), planets.end(), this->rng);
+        if (interest.camera_sector.has_value()) {
+            collect_sectors(interest.camera_sector.value());
+        }
 
-    i32 tank_index = 0;
+        for (auto it = interest.known_entities.begin(); it != interest.known_entities.end();) {
+            if (relevant_entities.contains(*it)) {
+                ++it;
+            } else {
+                this->SendLeave(player.value(), *it);
+                it = interest.known_entities.erase(it);
+            }
+        }
+
+        for (auto entity : relevant_entities) {
+            if (interest.known_entities.insert(entity).second) {
+                this->SendEnter(player.value(), entity);
+            }
+        }
+    }
+}
 
+void ServerGameState::ReplicateEntities() {
     for (auto &player : this->session->players) {
         if (player.has_value()) {
-            auto player_tank = CreateEntity(this->entities, EntityPrefabId::TANK);
-            player.value().tank_id = player_tank;
-            this->entities.Get<CTank>(player_tank).planet_id = planets[tank_index++];
-            this->entities.Get<CPlanetPosition>(player_tank).value = dist_planet_position(this->rng);
-            auto &health = this->entities.Get<CHealth>(player_tank);
-            health.value = 100.0f;
-            health.max = 100.0f;
+            this->ReplicateEntities(player.value());
         }
     }
+}
+
+void ServerGameState::ReplicateEntities(SessionPlayer &player) {
+    auto &interest = player.interest;
+    auto &priorities = interest.replication_priority;
 
-    for (size_t i = 0; i < this->session->num_npcs; ++i) {
-        auto npc_tank = CreateEntity(this->entities, EntityPrefabId::TANK);
-        this->entities.Get<CTank>(npc_tank).planet_id = planets[tank_index++];
-        this->entities.Get<CPlanetPosition>(npc_tank).value = dist_planet_position(this->rng);
-        auto &health = this->entities.Get<CHealth>(npc_tank);
-        health.value = 100.0f;
-        health.max = 100.0f;
+    std::erase_if(priorities, [&](const auto &entry) {
+        return !interest.known_entities.contains(entry.first);
+    });
+
+    Optional<Vec2> tank_position;
+    if (this->entities.IsValid(player.tank_id)) {
+        tank_position = this->GetTankWorldPosition(player.tank_id);
     }
-}
 
-void ServerGameState::DestroyEntity(Entity entity) {
-    if (this->entities.TryGet<CTank>(entity) != nullptr) {
-        PlaySfxCommand play_sfx;
-        play_sfx.sfx = PlaySfxCommand::Sfx::TANK_EXPLOSION;
+    Optional<Vec2> camera_position;
+    if (interest.camera_sector.has_value()) {
+        camera_position = (Vec2{interest.camera_sector.value()} + Vec2{0.5f, 0.5f}) * sector_size;
+    }
 
-        GameCommandMessage play_sfx_message;
-        Packet packet;
-        play_sfx_message.Serialize(packet);
-        this->SerializeCommand(play_sfx, packet);
-        this->session->BroadcastPacket(ToRvalue(packet));
+    auto get_distance_factor = [&](Vec2 position) {
+        auto distance = std::numeric_limits<f32>::max();
+
+        if (tank_position.has_value()) {
+            distance = glm::distance(position, tank_position.value());
+        }
+
+        if (camera_position.has_value()) {
+            distance = std::min(distance, glm::distance(position, camera_position.value()));
+        }
+
+        if (distance == std::numeric_limits<f32>::max()) {
+            return 1.0f;
+        }
+
+        return 1.0f / (1.0f + distance / sector_size);
+    };
+
+    Array<std::pair<f32, Entity>> candidates;
+
+    for (auto entity : interest.known_entities) {
+        if (!this->entities.IsValid(entity) || this->entities.TryGet<CNetReplication>(entity) == nullptr) {
+            continue;
+        }
+
+        f32 importance;
+        f32 speed;
+        Vec2 position;
+
+        if (this->entities.TryGet<CTank>(entity) != nullptr) {
+            importance = replication_tank_importance;
+            speed = std::abs(this->entities.Get<CPlanetPosition>(entity).delta) / CTank::MOVE_SPEED;
+            position = this->GetTankWorldPosition(entity);
+        } else if (this->entities.TryGet<CProjectile>(entity) != nullptr) {
+            importance = 1.0f;
+            speed = glm::length(this->entities.Get<CVelocity>(entity).value) / replication_projectile_speed;
+            position = this->entities.Get<CPosition>(entity).value;
+        } else {
+            continue; // Planets do not move
+        }
+
+        auto &priority = priorities[entity];
+        priority += replication_base_rate * importance * (1.0f + std::min(speed, 2.0f)) * get_distance_factor(position);
+
+        if (priority >= replication_threshold) {
+            candidates.emplace_back(priority, entity);
+        }
     }
 
-    this->entities.Destroy(entity);
+    std::sort(candidates.begin(), candidates.end(),
+        [](const auto &a, const auto &b) {
+            return a.first > b.first;
+        });
 
-    DestroyEntityCommand destroy_entitiy_command;
-    destroy_entitiy_command.target = entt::to_integral(entity);
+    // NOTE(janh): A client that gets state updates at a reduced rate gets a smaller budget as well
+    auto budget = replication_budget / static_cast<f32>(player.con->replication_rate.interval);
 
+    for (auto [priority, entity] : candidates) {
+        GameCommandMessage message;
+        Packet packet;
+        message.Serialize(packet);
+        SendPolicy policy;
+
+        if (auto tank = this->entities.TryGet<CTank>(entity); tank != nullptr) {
+            const auto &planet_position = this->entities.Get<CPlanetPosition>(entity);
+
+            MoveTankCommand move_tank;
+            move_tank.entity = entt::to_integral(entity);
+            move_tank.planet_position = planet_position.value;
+            move_tank.velocity = planet_position.delta;
+            this->SerializeCommand(move_tank, packet);
+            policy = move_tank.GetSendPolicy();
+        } else {
+            SetPositionCommand set_position;
+            set_position.target = entt::to_integral(entity);
+            set_position.position = this->entities.Get<CPosition>(entity).value;
+            this->SerializeCommand(set_position, packet);
+            policy = set_position.GetSendPolicy();
+        }
+
+        if (packet.position > budget) {
+            break;
+        }
+
+        budget -= packet.position;
+        priorities[entity] = 0.0f;
+        player.con->SendPacket(ToRvalue(packet), policy);
+    }
+}
+
+void ServerGameState::SendCommand(ClientConnection &con, const GameCommand &command) {
     GameCommandMessage message;
     Packet packet;
     message.Serialize(packet);
-    this->SerializeCommand(destroy_entitiy_command, packet);
-    this->session->BroadcastPacket(ToRvalue(packet));
+    this->SerializeCommand(command, packet);
+    con.SendPacket(ToRvalue(packet), GameState::GetSendPolicy(command));
 }
 
-bool ServerGameState::FireProjectile(Entity firing_tank) {
-    auto projectiles = this->Fire(firing_tank, false);
-    if (projectiles.empty()) {
-        //log_debug("projectile spawn", "no projectile");
-        // Could not fire, maybe due to cooldown etc.
-        return false;
+void ServerGameState::BroadcastEntityCommand(Entity entity, const GameCommand &command) {
+    GameCommandMessage message;
+    Packet packet;
+    message.Serialize(packet);
+    this->SerializeCommand(command, packet);
+    this->session->BroadcastPacketFiltered(ToRvalue(packet),
+        [&](const SessionPlayer &player) {
+            return player.interest.known_entities.contains(entity);
+        },
+        GameState::GetSendPolicy(command));
+}
+
+void ServerGameState::BroadcastPositionalCommand(Vec2 position, const GameCommand &command, const Array<Entity> &spawned_entities) {
+    auto sector = GetSector(position);
+
+    if (!spawned_entities.empty()) {
+        for (auto &player : this->session->players) {
+            if (player.has_value() && player.value().interest.Covers(sector)) {
+                player.value().interest.known_entities.insert(spawned_entities.begin(), spawned_entities.end());
+            }
+        }
     }
 
-    //log_debug("projectile spawn", "spawn projectile");
-    auto &tank = this->entities.Get<CTank>(firing_tank);
-
-    for (const auto &projectile : projectiles) {
-        // Send the spawn command
-        SpawnProjectileCommand spawn_projectile_command;
-        spawn_projectile_command.target = entt::to_integral(projectile);
-        spawn_projectile_command.firing_entity = entt::to_integral(firing_tank);
-        spawn_projectile_command.position = this->entities.Get<CPosition>(projectile).value;
-        spawn_projectile_command.velocity = this->entities.Get<CVelocity>(projectile).value;
-        spawn_projectile_command.weapon_type = tank.weapon_type;
-
-        Packet spawn_projectile_packet;
-        GameCommandMessage game_command_message;
-        game_command_message.Serialize(spawn_projectile_packet);
-        spawn_projectile_packet.WriteEnum(spawn_projectile_command.type);
-        spawn_projectile_command.Serialize(spawn_projectile_packet);
-        this->session->BroadcastPacket(ToRvalue(spawn_projectile_packet));
+    GameCommandMessage message;
+    Packet packet;
+    message.Serialize(packet);
+    this->SerializeCommand(command, packet);
+    this->session->BroadcastPacketFiltered(ToRvalue(packet),
+        [&](const SessionPlayer &player) {
+            return player.interest.Covers(sector);
+        },
+        GameState::GetSendPolicy(command));
+}
+
+void ServerGameState::SendEnter(SessionPlayer &player, Entity entity) {
+    if (auto tank = this->entities.TryGet<CTank>(entity); tank != nullptr) {
+        const auto &planet_position = this->entities.Get<CPlanetPosition>(entity);
+        const auto &health = this->entities.Get<CHealth>(entity);
+
+        SpawnTankCommand spawn_tank;
+        spawn_tank.target = entt::to_integral(entity);
+        spawn_tank.planet = entt::to_integral(tank->planet_id);
+        spawn_tank.planet_position = planet_position.value;
+        spawn_tank.velocity = planet_position.delta;
+        spawn_tank.turret_rotation = tank->turret_rotation;
+        spawn_tank.target_turret_rotation = tank->target_turret_rotation;
+        spawn_tank.flags = tank->flags;
+        spawn_tank.fuel = tank->fuel;
+        spawn_tank.health = health.value;
+        spawn_tank.max_health = health.max;
+        spawn_tank.weapon_type = tank->weapon_type;
+        this->SendCommand(*player.con, spawn_tank);
+    } else if (auto projectile = this->entities.TryGet<CProjectile>(entity); projectile != nullptr) {
+        SpawnProjectileCommand spawn_projectile;
+        spawn_projectile.target = entt::to_integral(entity);
+        spawn_projectile.firing_entity = entt::to_integral(projectile->firing_entity);
+        spawn_projectile.position = this->entities.Get<CPosition>(entity).value;
+        spawn_projectile.velocity = this->entities.Get<CVelocity>(entity).value;
+        spawn_projectile.weapon_type = projectile->weapon_type;
+        this->SendCommand(*player.con, spawn_projectile);
     }
+}
 
-    // Play sfx
-    PlaySfxCommand play_sfx;
-    play_sfx.sfx = PlaySfxCommand::Sfx::TANK_FIRE;
+// For a client that could not generate the same level. The client gets the complete current
+// state and knows every entity afterwards, UpdateInterest sends it leave events for the ones
+// that are too far away.
+void ServerGameState::SendLevelSnapshot(SessionPlayer &player) {
+    LoadLevelMessage message;
+    message.level = this->level;
+    message.checksum = this->level_checksum;
+    message.has_snapshot = true;
 
-    GameCommandMessage play_sfx_message;
     Packet packet;
-    play_sfx_message.Serialize(packet);
-    this->SerializeCommand(play_sfx, packet);
-    this->session->BroadcastPacket(ToRvalue(packet));
+    message.Serialize(packet);
+    this->Serialize(packet);
+    player.con->SendPacket(ToRvalue(packet));
+
+    auto &interest = player.interest;
+    interest.replication_priority.clear();
+    this->entities.View<CNetReplication>().each(
+        [&](Entity entity, CNetReplication &replication) {
+            if (this->entities.TryGet<CPlanet>(entity) == nullptr) {
+                interest.known_entities.insert(entity);
+            }
+        });
+}
 
-    return true;
+void ServerGameState::SendLeave(SessionPlayer &player, Entity entity) {
+    DestroyEntityCommand destroy_entity;
+    destroy_entity.target = entt::to_integral(entity);
+    this->SendCommand(*player.con, destroy_entity);
 }
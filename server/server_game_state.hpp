@@ -1,18 +1,70 @@
 #include "common/game_state.hpp"
+#include "common/player_input.hpp"
 
 struct Session;
+struct SessionPlayer;
 
 struct ServerGameState : public GameState {
-    using Command_Callback = bool(ServerGameState &, const CommandContext &, GameCommand &);
-    using Command_Callback_Map = HashMap<GameCommand::Type, Command_Callback *>;
-
     ServerGameState(Session *session);
-    void Serialize(Packet &packet) const;
-    bool HandleCommand(const CommandContext &context, GameCommand &command) final;
+
+    inline bool HandleCommandPacket(const CommandContext &context, Packet &packet) {
+        return DispatchCommandPacket(*this, context, packet);
+    }
+
+    // Commands from the clients. Types without an OnCommand overload are rejected.
+    template<typename Command>
+    bool HandleCommand(const CommandContext &context, Command &command);
+    bool OnCommand(const CommandContext &context, MoveTankCommand &move_tank);
+    bool OnCommand(const CommandContext &context, RotateTurretCommand &rotate_turret);
+    bool OnCommand(const CommandContext &context, ChargeCommand &charge_command);
+    bool OnCommand(const CommandContext &context, SwitchWeaponCommand &switch_weapon);
+    bool OnCommand(const CommandContext &context, SetViewCommand &set_view);
+    void RecordCommand(const CommandContext &context, const GameCommand &command);
+    Entity GetPlayerTank(const CommandContext &context);
+
     void Prepare();
     void DestroyEntity(Entity entity) final;
     bool FireProjectile(Entity firing_tank);
+    bool QueueCommand(SessionPlayer &player, Packet &&packet, SendPolicy policy);
+    void ApplyInputs();
+    void ApplyInput(SessionPlayer &player, const PlayerInput &input);
+    void UpdateInterest();
+    void ReplicateEntities();
+    void ReplicateEntities(SessionPlayer &player);
+    void SendCommand(ClientConnection &con, const GameCommand &command);
+    void BroadcastEntityCommand(Entity entity, const GameCommand &command);
+    void BroadcastPositionalCommand(Vec2 position, const GameCommand &command, const Array<Entity> &spawned_entities = {});
+    void SendEnter(SessionPlayer &player, Entity entity);
+    void SendLeave(SessionPlayer &player, Entity entity);
+    void SendLevelSnapshot(SessionPlayer &player);
 
-    Command_Callback_Map command_callbacks;
     Session *session = nullptr;
+    LevelDescriptor level;
+    u32 level_checksum = 0; // Of the state right after the level was generated
 };
+
+template<typename Command>
+bool ServerGameState::HandleCommand(const CommandContext &context, Command &command) {
+    if constexpr (!HandlesCommand<ServerGameState, Command>) {
+        return false;
+    } else {
+        // Recorded before the handler can modify it. Rejected commands are recorded as well
+        // because some of them still change the state (e.g. charging again restarts the charge).
+        this->RecordCommand(context, command);
+
+        auto succeeded = this->OnCommand(context, command);
+
+        if (succeeded) {
+            if constexpr (std::is_same_v<Command, SetViewCommand>) {
+                // Only relevant for the server
+            } else if constexpr (std::is_same_v<Command, SwitchWeaponCommand>) {
+                // The clients apply this to their own tank, other clients get the weapon with SpawnTankCommand
+                this->SendCommand(*context.con, command);
+            } else {
+                this->BroadcastEntityCommand(this->GetPlayerTank(context), command);
+            }
+        }
+
+        return succeeded;
+    }
+}
@@ -6,11 +6,15 @@
 #include "common/log.hpp"
 #include "common/player_info.hpp"
 
+#include <random>
+
 Session::Session(Server *server)
     : server(server) {
 }
 
-Session::~Session() = default;
+Session::~Session() {
+    this->server->timers.Cancel(this->idle_timer);
+}
 
 void Session::Start(i32 id, StringView name, StringView pw, i32 nplayers, i32 num_npcs, bool persistent) {
     assert(nplayers >= 1);
@@ -21,6 +25,18 @@ void Session::Start(i32 id, StringView name, StringView pw, i32 nplayers, i32 nu
     this->num_npcs = num_npcs;
     this->is_persistent = persistent;
     this->state = SessionState::LOBBY;
+    this->NotifyChanged();
+
+    if (!this->is_persistent) {
+        this->idle_timer = this->server->timers.Schedule(TimerWheel::ToTicks(Session::lobby_idle_timeout), [this] {
+            this->idle_timer = 0;
+
+            if (this->state == SessionState::LOBBY && this->GetNumberOfConnectedPlayers() == 0) {
+                LogInfo("session", "Session {} expired, nobody joined"_format(this->id));
+                this->Expire();
+            }
+        });
+    }
 }
 
 JoinSessionResult Session::Join(ClientConnection &con, StringView player_name, StringView password) {
@@ -61,6 +77,8 @@ JoinSessionResult Session::Join(ClientConnection &con, StringView player_name, S
     player->name_collision_index = name_collision_index;
 #endif
     con.session_id = this->id;
+    this->server->timers.Cancel(this->idle_timer);
+    this->NotifyChanged();
 
     LobbyUpdateMessage update_message;
     update_message.data.emplace<LobbyUpdateMessage::PlayerJoined>(
@@ -94,11 +112,21 @@ bool Session::Remove(ClientConnection &con) {
         });
     this->Broadcast(update_message);
 
+    if (this->replay != nullptr) {
+        Packet record;
+        record.WriteU32(this->game_tick);
+        record.WriteI32(con.player_id.value());
+        this->replay->Write(ReplayRecordType::LEAVE, record);
+    }
+
     player.reset();
     con.session_id.reset();
     con.player_id.reset();
+    con.held_state.clear(); // State updates of this session are of no use to the client anymore
+    this->NotifyChanged();
 
     if (this->GetNumberOfConnectedPlayers() == 0) {
+        this->replay.reset();
         this->game_state.reset();
         this->players.clear();
 
@@ -107,7 +135,7 @@ bool Session::Remove(ClientConnection &con) {
             this->state = SessionState::LOBBY;
         } else {
             LogInfo("session", "Session {} ended"_format(this->id));
-            this->state = SessionState::GARBAGE;
+            this->Expire();
         }
     }
 
@@ -159,15 +187,21 @@ bool Session::SetPlayerReady(ClientConnection &con) {
 
     if (all_players_ready) {
         LogInfo("session", "All players ready, starting game");
-        this->StartGame();
+        this->StartGame(std::random_device{}());
     }
 
     return true;
 }
 
-void Session::StartGame() {
+void Session::StartGame(u32 seed) {
     this->game_state = std::make_unique<ServerGameState>(this);
+    this->game_state->rng.Seed(seed);
     this->game_state->Prepare();
+    this->game_tick = 0;
+
+    if (this->server->replay_directory.has_value()) {
+        this->StartRecording(seed);
+    }
 
     for (auto& player : this->players) {
         if (!player.has_value()) {
@@ -182,11 +216,14 @@ void Session::StartGame() {
     }
 
     this->state = SessionState::INGAME;
+    this->NotifyChanged();
 
+    // A few dozen bytes instead of the entities, the clients generate the level themselves
     LoadLevelMessage message;
+    message.level = this->game_state->level;
+    message.checksum = this->game_state->level_checksum;
     Packet level_packet;
     message.Serialize(level_packet);
-    this->game_state->Serialize(level_packet);
     level_packet.WriteHeader();
 
     for (auto &player : this->players) {
@@ -198,6 +235,44 @@ void Session::StartGame() {
     }
 }
 
+void Session::StartRecording(u32 seed) {
+    auto time = chrono::system_clock::to_time_t(chrono::system_clock::now());
+    auto filename = "{}/session{}_{:%Y%m%d-%H%M%S}.tgreplay"_format(this->server->replay_directory.value(), this->id, *std::localtime(&time));
+
+    this->replay = std::make_unique<ReplayWriter>();
+    if (!this->replay->Open(filename)) {
+        this->replay.reset();
+        return;
+    }
+
+    // Everything that Prepare depends on, so the replay can prepare the same level
+    Packet session_record;
+    session_record.WriteU32(seed);
+    session_record.WriteString(this->name);
+    session_record.WriteI32(this->num_players);
+    session_record.WriteI32(this->num_npcs);
+    session_record.WriteU32(static_cast<u32>(this->players.size()));
+
+    for (const auto &player : this->players) {
+        session_record.WriteB8(player.has_value());
+        session_record.WriteString(player.has_value() ? player.value().name : "");
+    }
+
+    this->replay->Write(ReplayRecordType::SESSION, session_record);
+
+    Packet level_record;
+    level_record.WriteU32(this->game_state->level_checksum);
+    this->replay->Write(ReplayRecordType::LEVEL, level_record);
+}
+
+void Session::RecordCommand(const ClientConnection &con, const GameCommand &command) {
+    Packet record;
+    record.WriteU32(this->game_tick);
+    record.WriteI32(con.player_id.value_or(-1));
+    this->game_state->SerializeCommand(command, record);
+    this->replay->Write(ReplayRecordType::COMMAND, record);
+}
+
 SessionPlayer &Session::GetPlayer(ClientConnection &con) {
     CHECK(this->HasPlayer(con));
     CHECK(con.player_id.has_value());
@@ -213,7 +288,48 @@ void Session::Tick(f32 dt) {
         return;
     }
 
+    auto started = chrono::high_resolution_clock::now();
+
+    this->game_state->ApplyInputs();
     this->game_state->Tick(dt);
+    this->game_state->UpdateInterest();
+    this->game_state->ReplicateEntities();
+
+    for (auto &player : this->players) {
+        if (player.has_value()) {
+            player.value().con->TickReplication(this->server->num_ticks);
+        }
+    }
+
+    if (this->replay != nullptr) {
+        auto elapsed = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - started);
+
+        Packet tick_record;
+        tick_record.WriteU32(this->game_tick);
+        tick_record.WriteF32(dt);
+        tick_record.WriteU32(static_cast<u32>(elapsed.count()));
+        this->replay->Write(ReplayRecordType::TICK, tick_record);
+
+        if (this->game_tick % replay_checksum_interval == 0) {
+            Packet checksum_record;
+            checksum_record.WriteU32(this->game_tick);
+            checksum_record.WriteU32(this->game_state->ComputeChecksum());
+            this->replay->Write(ReplayRecordType::CHECKSUM, checksum_record);
+            this->replay->Flush();
+        }
+    }
+
+    ++this->game_tick;
+}
+
+// Removed by the server on the next tick, the session may still be on the call stack
+void Session::Expire() {
+    this->state = SessionState::GARBAGE;
+    this->NotifyChanged();
+
+    this->server->timers.Schedule(1, [server = this->server, id = this->id] {
+        server->RemoveGarbageSession(id);
+    });
 }
 
 void Session::BroadcastPacket(Packet &&packet) {
@@ -226,6 +342,16 @@ void Session::BroadcastPacket(Packet &&packet) {
     }
 }
 
+void Session::BroadcastPacketFiltered(Packet &&packet, const PlayerFilter &filter, SendPolicy policy) {
+    packet.WriteHeader();
+
+    for (const auto &player : this->players) {
+        if (player.has_value() && filter(player.value())) {
+            player.value().con->SendPacketCopy(packet, policy);
+        }
+    }
+}
+
 i32 Session::GetNumberOfConnectedPlayers(bool only_ready) const {
     if (only_ready) {
         return std::count_if(this->players.begin(), this->players.end(),
@@ -247,3 +373,18 @@ PlayerInfo Session::GetPlayerInfo(const SessionPlayer &player) const {
         .ready = player.ready
     };
 }
+
+SessionInfo Session::GetSessionInfo() const {
+    return SessionInfo{
+        .name = this->name,
+        .id = static_cast<u16>(this->id),
+        .nplayers = static_cast<u16>(this->num_players),
+        .nplayers_connected = static_cast<u16>(this->GetNumberOfConnectedPlayers()),
+        .state = this->state,
+        .haspw = !this->password.empty()
+    };
+}
+
+void Session::NotifyChanged() {
+    this->server->session_directory.MarkDirty(this->id);
+}
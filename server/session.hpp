@@ -4,13 +4,44 @@
 #include "common/session_info.hpp"
 #include "common/player_info.hpp"
 #include "common/game_state.hpp"
+#include "common/sector.hpp"
+#include "common/player_input.hpp"
+#include "common/net_stats.hpp"
+#include "common/replay.hpp"
+#include "server/timer_wheel.hpp"
 
 struct Server;
 struct Packet;
 struct ServerGameState;
 struct ClientConnection;
+struct GameCommand;
+
+// Which part of the world a player is interested in and which entities the
+// player's client currently knows about, see ServerGameState::UpdateInterest
+struct PlayerInterest {
+    inline bool Covers(Vec2i sector) const {
+        return
+            IsSectorInInterestRadius(this->tank_sector, sector) ||
+            (this->camera_sector.has_value() && IsSectorInInterestRadius(this->camera_sector.value(), sector));
+    }
+
+    Vec2i tank_sector{};
+    Optional<Vec2i> camera_sector;
+    HashSet<Entity> known_entities;
+    HashMap<Entity, f32> replication_priority; // Accumulated since the entity was last sent, see ServerGameState::ReplicateEntities
+};
+
+// A game command from the client that is applied at the beginning of the next session tick.
+// The packet's read position is at the command.
+struct PendingCommand {
+    Packet packet;
+    u64 key = 0; // Of its SendPolicy if it is a STATE command, a later one with the same key replaces it
+};
 
 struct SessionPlayer {
+    constexpr static size_t max_pending_inputs = 64;
+    constexpr static size_t max_pending_commands = 64;
+
     inline explicit SessionPlayer(ClientConnection *con)
         : con(con) {
     }
@@ -27,12 +58,23 @@ struct SessionPlayer {
     bool ready = false;
     Entity tank_id = entt::null;
     String name;
+    PlayerInterest interest;
+    Array<PlayerInput> pending_inputs; // Applied at the beginning of the next session tick
+    Array<PendingCommand> pending_commands; // Applied after the inputs
+    PlayerInput applied_input;
+    u32 last_received_input_sequence = 0;
+    Optional<chrono::high_resolution_clock::time_point> traced_input_received_at; // Of the newest pending input if its client traces the latency
+    bool level_snapshot_sent = false; // Only sent once, see ServerGameState::SendLevelSnapshot
 #if defined(DEVELOPMENT) && DEVELOPMENT
     i32 name_collision_index = 0;
 #endif
 };
 
 struct Session {
+    using PlayerFilter = std::function<bool(const SessionPlayer &)>;
+
+    constexpr static chrono::high_resolution_clock::duration lobby_idle_timeout = 5min; // Until a lobby nobody joined is removed
+
     explicit Session(Server *server);
     ~Session();
     void Start(i32 id, StringView name, StringView password, i32 num_players, i32 num_npcs, bool persistent);
@@ -40,12 +82,18 @@ struct Session {
     bool Remove(ClientConnection &con);
     bool HasPlayer(const ClientConnection &con) const;
     bool SetPlayerReady(ClientConnection &con);
-    void StartGame();
+    void StartGame(u32 seed);
+    void StartRecording(u32 seed);
+    void RecordCommand(const ClientConnection &con, const GameCommand &command);
     SessionPlayer &GetPlayer(ClientConnection &con);
     void Tick(f32 dt);
+    void Expire();
     void BroadcastPacket(Packet &&packet);
+    void BroadcastPacketFiltered(Packet &&packet, const PlayerFilter &filter, SendPolicy policy = {});
     i32 GetNumberOfConnectedPlayers(bool only_ready = false) const;
     PlayerInfo GetPlayerInfo(const SessionPlayer &player) const;
+    SessionInfo GetSessionInfo() const;
+    void NotifyChanged(); // Something the session browser shows changed
 
     template<typename T>
     void Broadcast(const T &data) {
@@ -64,4 +112,9 @@ struct Session {
     i32 num_npcs = 0;
     Array<Optional<SessionPlayer>> players;
     bool is_persistent = false;
+    NetTrafficStats traffic;
+    NetTrafficRate traffic_rate;
+    u32 game_tick = 0; // Number of game state ticks since the game started
+    UniquePtr<ReplayWriter> replay; // Only if the server records replays
+    TimerId idle_timer = 0;
 };
@@ -0,0 +1,175 @@
+#include "server/session_directory.hpp"
+
+#include "server/server.hpp"
+#include "server/session.hpp"
+#include "server/client_connection.hpp"
+#include "common/net_msg.hpp"
+
+SessionDirectory::SessionDirectory(Server *server)
+    : server(server) {
+}
+
+SessionDirectory::~SessionDirectory() {
+    this->server->timers.Cancel(this->update_timer);
+}
+
+void SessionDirectory::MarkDirty(i32 session_id) {
+    this->stale.insert(session_id);
+    this->changed.insert(session_id);
+    this->listing_valid = false;
+
+    if (!this->server->timers.IsScheduled(this->update_timer)) {
+        this->update_timer = this->server->timers.Schedule(update_interval, [this] {
+            this->update_timer = 0;
+            this->PushUpdates();
+        });
+    }
+}
+
+void SessionDirectory::Subscribe(ClientConnection &con) {
+    con.session_list_subscribed = true;
+    this->subscribers.insert(con.id);
+}
+
+void SessionDirectory::Unsubscribe(ClientConnection &con) {
+    con.session_list_subscribed = false;
+    this->subscribers.erase(con.id);
+}
+
+const Packet &SessionDirectory::GetListing() {
+    this->Refresh();
+
+    if (!this->listing_valid) {
+        GetSessionInfoRequest request;
+        this->listing = Packet{};
+        this->WriteListing(request, this->listing);
+        this->listing.WriteHeader();
+        this->listing_valid = true;
+    }
+
+    return this->listing;
+}
+
+void SessionDirectory::WriteListing(const GetSessionInfoRequest &request, Packet &packet) {
+    this->Refresh();
+
+    u16 num_matching = 0;
+    u16 num_sessions = 0;
+
+    for (const auto &entry : this->entries) {
+        if (!entry.has_value() || !request.filter.Matches(entry->info)) {
+            continue;
+        }
+
+        if (num_matching >= request.first && (request.max_sessions == 0 || num_sessions < request.max_sessions)) {
+            ++num_sessions;
+        }
+
+        ++num_matching;
+    }
+
+    // Same layout as GetSessionInfoResponse::Serialize, but with the pre-serialized entries
+    packet.WriteEnum(GetSessionInfoResponse::Type);
+    packet.WriteU16(num_matching);
+    packet.WriteU16(request.first);
+    packet.WriteU16(num_sessions);
+
+    u16 index = 0;
+    for (const auto &entry : this->entries) {
+        if (num_sessions == 0) {
+            break;
+        }
+
+        if (!entry.has_value() || !request.filter.Matches(entry->info)) {
+            continue;
+        }
+
+        if (index++ >= request.first) {
+            packet.WriteData(entry->serialized.data(), entry->serialized.size());
+            --num_sessions;
+        }
+    }
+}
+
+void SessionDirectory::PushUpdates() {
+    this->Refresh();
+
+    if (this->changed.empty()) {
+        return;
+    }
+
+    Array<i32> ids{this->changed.begin(), this->changed.end()};
+    std::sort(ids.begin(), ids.end());
+    this->changed.clear();
+
+    if (this->subscribers.empty()) {
+        return;
+    }
+
+    u16 num_updated = 0;
+    for (auto id : ids) {
+        if (static_cast<size_t>(id) < this->entries.size() && this->entries[id].has_value()) {
+            ++num_updated;
+        }
+    }
+
+    // Same layout as SessionListUpdateMessage::Serialize, but with the pre-serialized entries
+    Packet packet;
+    packet.WriteEnum(SessionListUpdateMessage::Type);
+    packet.WriteU16(num_updated);
+    for (auto id : ids) {
+        if (static_cast<size_t>(id) < this->entries.size() && this->entries[id].has_value()) {
+            const auto &serialized = this->entries[id]->serialized;
+            packet.WriteData(serialized.data(), serialized.size());
+        }
+    }
+
+    packet.WriteU16(static_cast<u16>(ids.size() - num_updated));
+    for (auto id : ids) {
+        if (static_cast<size_t>(id) >= this->entries.size() || !this->entries[id].has_value()) {
+            packet.WriteU16(static_cast<u16>(id));
+        }
+    }
+
+    packet.WriteHeader();
+
+    std::erase_if(this->subscribers,
+        [&](i32 id) {
+            auto con = this->server->TryGetConnection(id);
+            if (con == nullptr || con->closed || !con->session_list_subscribed) {
+                return true;
+            }
+
+            con->SendPacketCopy(packet);
+            return false;
+        });
+}
+
+void SessionDirectory::Refresh() {
+    for (auto id : this->stale) {
+        auto session = this->server->TryGetSession(id);
+
+        if (static_cast<size_t>(id) >= this->entries.size()) {
+            this->entries.resize(id + 1);
+        }
+
+        auto &entry = this->entries[id];
+
+        if (session == nullptr || session->state == SessionState::GARBAGE) {
+            entry.reset();
+            continue;
+        }
+
+        if (!entry.has_value()) {
+            entry.emplace();
+        }
+
+        entry->info = session->GetSessionInfo();
+
+        Packet packet;
+        GetSessionInfoResponse::SerializeEntry(packet, entry->info);
+        entry->serialized.assign(packet.buffer.begin() + sizeof(Packet_Header), packet.buffer.end());
+    }
+
+    this->stale.clear();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/packet.hpp"
+#include "common/session_info.hpp"
+#include "server/timer_wheel.hpp"
+
+struct Server;
+struct ClientConnection;
+struct GetSessionInfoRequest;
+
+// The session browser's view of the sessions. Every session keeps a pre-serialized entry
+// that is only rebuilt after the session reported a change with MarkDirty, and the listing
+// of all sessions is kept as a ready-to-send packet. Answering a browsing client costs a
+// packet copy, or a copy of the matching entries if it asked for a page or a filter.
+//
+// Changes are collected and pushed to the subscribed connections as one update every
+// update_interval ticks, no matter how many sessions changed in between.
+struct SessionDirectory {
+    constexpr static u64 update_interval = 15; // Ticks
+
+    struct Entry {
+        SessionInfo info;
+        Array<char> serialized; // As written by GetSessionInfoResponse::SerializeEntry
+    };
+
+    explicit SessionDirectory(Server *server);
+    ~SessionDirectory();
+    void MarkDirty(i32 session_id);
+    void Subscribe(ClientConnection &con);
+    void Unsubscribe(ClientConnection &con);
+    const Packet &GetListing(); // All sessions, the header is already written
+    void WriteListing(const GetSessionInfoRequest &request, Packet &packet);
+    void PushUpdates();
+    void Refresh();
+
+    Server *server;
+    Array<Optional<Entry>> entries; // Indexed by session id
+    HashSet<i32> stale; // Entries that have to be rebuilt
+    HashSet<i32> changed; // Since the last pushed update
+    Packet listing;
+    bool listing_valid = false;
+    HashSet<i32> subscribers; // Connection ids
+    TimerId update_timer = 0;
+};
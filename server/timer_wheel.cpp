@@ -0,0 +1,123 @@
+#include "server/timer_wheel.hpp"
+
+static TimerId MakeTimerId(u32 index, u32 generation) {
+    return (static_cast<u64>(generation) << 32) | (static_cast<u64>(index) + 1);
+}
+
+TimerId TimerWheel::Schedule(u64 delay, Callback callback) {
+    assert(callback);
+
+    u32 index;
+    if (!this->free_timers.empty()) {
+        index = this->free_timers.back();
+        this->free_timers.pop_back();
+    } else {
+        index = static_cast<u32>(this->timers.size());
+        this->timers.emplace_back();
+    }
+
+    auto &timer = this->timers[index];
+    timer.expires = this->current_tick + std::clamp<u64>(delay, 1, max_delay);
+    timer.active = true;
+    timer.callback = ToRvalue(callback);
+    ++this->num_timers;
+
+    auto id = MakeTimerId(index, timer.generation);
+    this->Insert(id, timer.expires);
+    return id;
+}
+
+void TimerWheel::Cancel(TimerId &id) {
+    if (this->IsScheduled(id)) {
+        this->Free(GetTimerIndex(id));
+    }
+
+    id = 0;
+}
+
+void TimerWheel::Advance(u64 now) {
+    while (this->current_tick <= now) {
+        auto index = this->current_tick & slot_mask;
+
+        // The first wheel wrapped around, pull the next slot of the coarser wheels down
+        if (index == 0) {
+            for (u32 level = 1; level < num_levels; ++level) {
+                auto level_index = (this->current_tick >> (slot_bits * level)) & slot_mask;
+                this->Cascade(level, level_index);
+
+                if (level_index != 0) {
+                    break;
+                }
+            }
+        }
+
+        std::swap(this->due, this->wheels[0][index]);
+
+        for (auto id : this->due) {
+            if (!this->IsScheduled(id)) {
+                continue;
+            }
+
+            // Free first, the callback may schedule a timer that reuses the slot
+            auto index = GetTimerIndex(id);
+            auto callback = ToRvalue(this->timers[index].callback);
+            this->Free(index);
+            callback();
+        }
+
+        this->due.clear();
+        ++this->current_tick;
+    }
+}
+
+bool TimerWheel::IsScheduled(TimerId id) const {
+    if (id == 0) {
+        return false;
+    }
+
+    auto index = GetTimerIndex(id);
+    if (index >= this->timers.size()) {
+        return false;
+    }
+
+    const auto &timer = this->timers[index];
+    return timer.active && timer.generation == static_cast<u32>(id >> 32);
+}
+
+u32 TimerWheel::GetTimerIndex(TimerId id) {
+    return static_cast<u32>((id & 0xffffffff) - 1);
+}
+
+void TimerWheel::Insert(TimerId id, u64 expires) {
+    assert(expires >= this->current_tick);
+    auto delta = expires - this->current_tick;
+
+    for (u32 level = 0; level < num_levels; ++level) {
+        if (delta < (u64{1} << (slot_bits * (level + 1))) || level == num_levels - 1) {
+            this->wheels[level][(expires >> (slot_bits * level)) & slot_mask].emplace_back(id);
+            return;
+        }
+    }
+}
+
+void TimerWheel::Cascade(u32 level, u64 index) {
+    Array<TimerId> slot;
+    std::swap(slot, this->wheels[level][index]);
+
+    for (auto id : slot) {
+        if (this->IsScheduled(id)) {
+            this->Insert(id, this->timers[GetTimerIndex(id)].expires);
+        }
+    }
+}
+
+void TimerWheel::Free(u32 index) {
+    auto &timer = this->timers[index];
+    assert(timer.active);
+
+    timer.active = false;
+    timer.callback = nullptr;
+    ++timer.generation;
+    this->free_timers.emplace_back(index);
+    --this->num_timers;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/frame_timer.hpp"
+
+using TimerId = u64; // 0 is never a valid timer
+
+// Hierarchical timer wheel with a resolution of one server tick. Timers that are due
+// within one revolution of the first wheel sit in a slot of that wheel, timers that
+// are further out sit in a slot of a coarser wheel and cascade down as their time
+// approaches. Scheduling and cancelling are O(1) and advancing only looks at the slots
+// that are due, so a tick costs as much as the timers that fire, not as much as the
+// timers that exist.
+//
+// Cancelled timers leave a stale id in their slot which is skipped once the slot comes up.
+struct TimerWheel {
+    using Callback = std::function<void()>;
+
+    constexpr static u32 slot_bits = 6;
+    constexpr static u32 num_slots = 1 << slot_bits;
+    constexpr static u64 slot_mask = num_slots - 1;
+    constexpr static u32 num_levels = 4;
+    constexpr static u64 max_delay = (u64{1} << (slot_bits * num_levels)) - 1; // Longer delays are clamped
+
+    template<typename Rep, typename Period>
+    constexpr static u64 ToTicks(chrono::duration<Rep, Period> duration) {
+        auto tick_length = FrameTimer::tick_length;
+        return (chrono::duration_cast<FrameTimer::Duration>(duration) + tick_length - FrameTimer::Duration{1}) / tick_length;
+    }
+
+    TimerId Schedule(u64 delay, Callback callback); // Delay in ticks, fires no earlier than the next tick
+    void Cancel(TimerId &id); // Resets the id, does nothing if the timer already fired
+    void Advance(u64 now); // Fires every timer that is due up to and including the tick now
+    bool IsScheduled(TimerId id) const;
+
+    inline size_t GetNumTimers() const {
+        return this->num_timers;
+    }
+
+    struct Timer {
+        u64 expires = 0;
+        u32 generation = 0;
+        bool active = false;
+        Callback callback;
+    };
+
+    static u32 GetTimerIndex(TimerId id);
+    void Insert(TimerId id, u64 expires);
+    void Cascade(u32 level, u64 index);
+    void Free(u32 index);
+
+    Array<Timer> timers;
+    Array<u32> free_timers;
+    std::array<std::array<Array<TimerId>, num_slots>, num_levels> wheels;
+    Array<TimerId> due; // Scratch buffer for the slot that is being processed
+    u64 current_tick = 0; // The next tick that Advance processes
+    size_t num_timers = 0;
+};
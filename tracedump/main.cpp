@@ -0,0 +1,551 @@
+#include "common/net_trace.hpp"
+#include "common/net_msg.hpp"
+#include "common/game_state.hpp"
+#include "common/log.hpp"
+#include "json.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <map>
+
+// Decodes a trace recorded with "trace <file>" on the client or "tankgame-sv --trace <file>"
+// with the same deserializers the game uses, and sums it up so bandwidth spikes can be
+// tracked down to the messages that caused them.
+
+struct TracedumpOptions {
+    String filename;
+    bool json = false; // One JSON object per line instead of text
+    bool summary_only = false;
+    Optional<u32> connection_id;
+    Optional<String> type_name;
+    f32 interval_seconds = 1.0f; // Of the messages per type over time
+    u32 num_largest = 10;
+};
+
+struct TypeStats {
+    u64 count = 0;
+    u64 bytes = 0;
+    u32 max_size = 0;
+};
+
+struct DecodedRecord {
+    f64 time = 0.0; // Seconds since the trace started
+    u32 connection_id = 0;
+    NetDirection direction = NetDirection::INBOUND;
+    String type;
+    u32 size = 0;
+    Optional<String> detail; // Not set if the packet does not parse
+};
+
+struct StreamStats {
+    f64 last_time = -1.0;
+    Array<f64> gaps; // Seconds between consecutive packets
+    f64 max_gap = 0.0;
+    f64 max_gap_time = 0.0; // When the longest gap ended
+};
+
+struct TraceSummary {
+    std::map<String, TypeStats> types;
+    std::map<u64, std::map<String, TypeStats>> intervals; // Interval index -> type -> stats
+    std::map<std::pair<u32, NetDirection>, StreamStats> streams;
+    Array<DecodedRecord> largest; // Min-heap by size
+    u64 num_malformed = 0;
+};
+
+static void PrintUsage() {
+    fmt::print(
+        "usage: tankgame-tracedump <file> [--json] [--summary] [--connection <trace id>] [--type <message type>]\n"
+        "                          [--interval <seconds>] [--largest <n>]\n");
+}
+
+template<typename T>
+static bool ParseNumber(StringView text, T &out) {
+    auto [p, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+    return ec == std::errc{} && p == text.data() + text.size();
+}
+
+static bool ParseOptions(int argc, char **argv, TracedumpOptions &options) {
+    if (argc < 2) {
+        return false;
+    }
+
+    options.filename = argv[1];
+
+    for (int i = 2; i < argc; ++i) {
+        StringView arg = argv[i];
+        auto ok = true;
+
+        if (arg == "--json") {
+            options.json = true;
+        } else if (arg == "--summary") {
+            options.summary_only = true;
+        } else if (i + 1 >= argc) {
+            return false;
+        } else if (arg == "--connection") {
+            ok = ParseNumber(argv[++i], options.connection_id.emplace());
+        } else if (arg == "--type") {
+            options.type_name = String{argv[++i]};
+        } else if (arg == "--interval") {
+            ok = ParseNumber(argv[++i], options.interval_seconds) && options.interval_seconds > 0.0f;
+        } else if (arg == "--largest") {
+            ok = ParseNumber(argv[++i], options.num_largest);
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template<typename T>
+static String FormatField(const T &value) {
+    if constexpr (std::is_same_v<T, Vec2>) {
+        return "({}, {})"_format(value.x, value.y);
+    } else if constexpr (std::is_enum_v<T>) {
+        return "{}"_format(static_cast<i64>(value));
+    } else if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool> && sizeof(T) == 1) {
+        return "{}"_format(static_cast<i32>(value)); // Not as a character
+    } else {
+        return "{}"_format(value);
+    }
+}
+
+static Optional<String> DescribeGameCommand(Packet &packet) {
+    using Describer = Optional<String> (*)(Packet &);
+
+    constexpr static auto describers = GameCommands::MakeTable<Describer>(
+        []<typename Command>() -> Describer {
+            return [](Packet &packet) -> Optional<String> {
+                Command command;
+                if (!command.Deserialize(packet)) {
+                    return std::nullopt;
+                }
+
+                String fields;
+                std::apply(
+                    [&](const auto &...values) {
+                        ((fields += (fields.empty() ? "" : ", ") + FormatField(values)), ...);
+                    },
+                    Command::Fields(command));
+
+                return "{} [{}]"_format(ToString(Command::type_id), fields);
+            };
+        });
+
+    GameCommand::Type type;
+
+    if (!packet.ReadEnum(type)) {
+        return std::nullopt;
+    }
+
+    auto index = static_cast<size_t>(type);
+
+    if (index >= describers.size() || describers[index] == nullptr) {
+        return std::nullopt;
+    }
+
+    return describers[index](packet);
+}
+
+// The interesting fields of a message, messages without an overload are only validated
+template<typename Message>
+static String Describe(const Message &message) {
+    return {};
+}
+
+static String Describe(const HandshakeRequest &message) {
+    auto text = "version {}.{}.{} compression={}"_format(message.ver_major, message.ver_minor, message.ver_build, message.supports_compression);
+
+    if (message.fast_join.has_value()) {
+        text += " fast_join={} player='{}'"_format(message.fast_join->session_id, message.fast_join->player_name);
+    }
+
+    return text;
+}
+
+static String Describe(const HandshakeResponse &message) {
+    return "version {}.{}.{} ok={} compression={}"_format(message.ver_major, message.ver_minor, message.ver_build, message.ok, message.compression);
+}
+
+static String Describe(const PingMessage &message) {
+    return "server_time={}"_format(message.my_time);
+}
+
+static String Describe(const PongMessage &message) {
+    return "server_time={} client_time={} hold_time={}"_format(message.echo.server_time, message.echo.client_time, message.echo.hold_time);
+}
+
+static String Describe(const JoinSessionRequest &message) {
+    return "session={} player='{}'"_format(message.session_id, message.player_name);
+}
+
+static String Describe(const JoinSessionResponse &message) {
+    return "result='{}' players={}"_format(ToString(message.result), message.connected_players.size());
+}
+
+static String Describe(const GameStartedMessage &message) {
+    return "tank={}"_format(message.player_tank);
+}
+
+static String Describe(const LoadLevelMessage &message) {
+    return "seed={} planets={} checksum={:08x} snapshot={}"_format(message.level.seed, message.level.num_planets, message.checksum, message.has_snapshot);
+}
+
+static String Describe(const SetTickLengthMessage &message) {
+    return "delta_us={} duration_ms={}"_format(message.tick_length_delta_microseconds, message.duration_milliseconds);
+}
+
+static String Describe(const ClockSyncMessage &message) {
+    return "rtt={} last_rtt={} offset={}"_format(message.rtt, message.last_rtt, message.offset);
+}
+
+static String Describe(const PauseGameMessage &message) {
+    return "paused={}"_format(message.paused);
+}
+
+static String Describe(const DisconnectMessage &message) {
+    return "reason='{}' message='{}'"_format(ToString(message.reason), message.message);
+}
+
+static String Describe(const InputBundleMessage &message) {
+    if (message.inputs.empty()) {
+        return "inputs=0 echo={}"_format(message.echo.has_value());
+    }
+
+    return "inputs={} sequence={}..{} echo={} trace_latency={}"_format(
+        message.inputs.size(),
+        message.inputs.front().sequence,
+        message.inputs.back().sequence,
+        message.echo.has_value(),
+        message.trace_latency);
+}
+
+static String Describe(const InputAckMessage &message) {
+    auto text = "sequence={}"_format(message.sequence);
+
+    if (message.server_time.has_value()) {
+        text += " server_time={}"_format(message.server_time.value());
+    }
+
+    if (message.timing.has_value()) {
+        text += " applied_tick={} queued_us={}"_format(message.timing->tick, message.timing->queued_us);
+    }
+
+    return text;
+}
+
+template<typename Message>
+static Optional<String> Decode(Packet &packet) {
+    Message message;
+
+    if (!message.Deserialize(packet)) {
+        return std::nullopt;
+    }
+
+    return Describe(message);
+}
+
+// Requests and responses share their type, so the direction decides which one it is
+static Optional<String> DecodeMessage(bool from_client, NetMessageType type, Packet &packet) {
+    switch (type) {
+        case NetMessageType::HANDSHAKE:           return from_client ? Decode<HandshakeRequest>(packet) : Decode<HandshakeResponse>(packet);
+        case NetMessageType::PING:                return Decode<PingMessage>(packet);
+        case NetMessageType::PONG:                return Decode<PongMessage>(packet);
+        case NetMessageType::GET_SESSION_INFO:    return from_client ? Decode<GetSessionInfoRequest>(packet) : Decode<GetSessionInfoResponse>(packet);
+        case NetMessageType::CREATE_SESSION:      return from_client ? Decode<CreateSessionRequest>(packet) : Decode<CreateSessionResponse>(packet);
+        case NetMessageType::JOIN_SESSION:        return from_client ? Decode<JoinSessionRequest>(packet) : Decode<JoinSessionResponse>(packet);
+        case NetMessageType::LEAVE_SESSION:       return Decode<LeaveSessionMessage>(packet);
+        case NetMessageType::READY:               return Decode<ReadyMessage>(packet);
+        case NetMessageType::GAME_STARTED:        return Decode<GameStartedMessage>(packet);
+        case NetMessageType::LOAD_LEVEL:          return Decode<LoadLevelMessage>(packet);
+        case NetMessageType::GAME_COMMAND:        return DescribeGameCommand(packet);
+        case NetMessageType::SHUTDOWN:            return Decode<ShutdownMessage>(packet);
+        case NetMessageType::SET_TICK_LENGTH:     return Decode<SetTickLengthMessage>(packet);
+        case NetMessageType::PAUSE_GAME:          return Decode<PauseGameMessage>(packet);
+        case NetMessageType::LOBBY_UPDATE:        return Decode<LobbyUpdateMessage>(packet);
+        case NetMessageType::DISCONNECT:          return Decode<DisconnectMessage>(packet);
+        case NetMessageType::INPUT_BUNDLE:        return Decode<InputBundleMessage>(packet);
+        case NetMessageType::INPUT_ACK:           return Decode<InputAckMessage>(packet);
+        case NetMessageType::SESSION_LIST_UPDATE: return Decode<SessionListUpdateMessage>(packet);
+        case NetMessageType::REQUEST_LEVEL:       return Decode<RequestLevelMessage>(packet);
+        case NetMessageType::CLOCK_SYNC:          return Decode<ClockSyncMessage>(packet);
+        default:                                  return std::nullopt;
+    }
+}
+
+static DecodedRecord DecodeRecord(const NetTraceRecord &record, NetTraceRole role) {
+    DecodedRecord decoded;
+    decoded.time = static_cast<f64>(record.time_ns) / 1e9;
+    decoded.connection_id = record.connection_id;
+    decoded.direction = record.direction;
+    decoded.size = record.size;
+    decoded.type = "(invalid)";
+
+    if (record.size <= sizeof(Packet_Header)) {
+        return decoded;
+    }
+
+    Packet_Header header;
+    std::memcpy(&header, record.data, sizeof(header));
+
+    if (header.size & Packet_Header::FLAG_COMPRESSED) {
+        decoded.type = "(compressed)";
+        return decoded;
+    }
+
+    Packet packet;
+    packet.Reset(Array<char>(record.data, record.data + record.size));
+
+    NetMessageType type;
+    packet.ReadEnum(type);
+    decoded.type = ToString(type);
+
+    auto from_client = (role == NetTraceRole::RECORDED_BY_CLIENT) == (record.direction == NetDirection::OUTBOUND);
+    decoded.detail = DecodeMessage(from_client, type, packet);
+
+    // Game commands carry the command type in the name so the summary breaks them down
+    if (type == NetMessageType::GAME_COMMAND && record.size > sizeof(Packet_Header) + 1) {
+        decoded.type = "GAME_COMMAND:{}"_format(ToString(static_cast<GameCommand::Type>(record.data[sizeof(Packet_Header) + 1])));
+    }
+
+    return decoded;
+}
+
+static String ToShortString(NetDirection direction) {
+    return direction == NetDirection::INBOUND ? "in" : "out";
+}
+
+static void PrintRecord(const DecodedRecord &record, const TracedumpOptions &options) {
+    if (options.json) {
+        nlohmann::json json = {
+            {"time", record.time},
+            {"connection", record.connection_id},
+            {"direction", ToShortString(record.direction)},
+            {"type", record.type},
+            {"size", record.size},
+        };
+
+        if (record.detail.has_value()) {
+            json["detail"] = record.detail.value();
+        } else {
+            json["malformed"] = true;
+        }
+
+        fmt::print("{}\n", json.dump());
+        return;
+    }
+
+    fmt::print("{:12.6f} {:>4} {:<3} {:<32} {:>7} {}\n",
+        record.time,
+        record.connection_id,
+        ToShortString(record.direction),
+        record.type,
+        record.size,
+        record.detail.has_value() ? record.detail.value() : String{"MALFORMED"});
+}
+
+static void AddToSummary(TraceSummary &summary, const DecodedRecord &record, const TracedumpOptions &options) {
+    auto add = [&](TypeStats &stats) {
+        ++stats.count;
+        stats.bytes += record.size;
+        stats.max_size = std::max(stats.max_size, record.size);
+    };
+
+    add(summary.types[record.type]);
+    add(summary.intervals[static_cast<u64>(record.time / options.interval_seconds)][record.type]);
+
+    if (!record.detail.has_value()) {
+        ++summary.num_malformed;
+    }
+
+    auto &stream = summary.streams[{record.connection_id, record.direction}];
+    if (stream.last_time >= 0.0) {
+        auto gap = record.time - stream.last_time;
+        if (gap > stream.max_gap) {
+            stream.max_gap = gap;
+            stream.max_gap_time = record.time;
+        }
+        stream.gaps.emplace_back(gap);
+    }
+    stream.last_time = record.time;
+
+    auto by_size = [](const DecodedRecord &a, const DecodedRecord &b) {
+        return a.size > b.size;
+    };
+
+    if (summary.largest.size() < options.num_largest) {
+        summary.largest.emplace_back(record);
+        std::push_heap(summary.largest.begin(), summary.largest.end(), by_size);
+    } else if (options.num_largest > 0 && record.size > summary.largest.front().size) {
+        std::pop_heap(summary.largest.begin(), summary.largest.end(), by_size);
+        summary.largest.back() = record;
+        std::push_heap(summary.largest.begin(), summary.largest.end(), by_size);
+    }
+}
+
+static f64 GetPercentile(Array<f64> &values, f32 percentile) {
+    if (values.empty()) {
+        return 0.0;
+    }
+
+    auto index = static_cast<size_t>(percentile / 100.0f * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+static void PrintSummary(TraceSummary &summary, const TracedumpOptions &options) {
+    std::sort(summary.largest.begin(), summary.largest.end(),
+        [](const DecodedRecord &a, const DecodedRecord &b) {
+            return a.size > b.size;
+        });
+
+    // An interval is a spike if it has more than twice the median bytes
+    Array<f64> interval_bytes;
+    for (const auto &[index, types] : summary.intervals) {
+        u64 bytes = 0;
+        for (const auto &[type, stats] : types) {
+            bytes += stats.bytes;
+        }
+        interval_bytes.emplace_back(static_cast<f64>(bytes));
+    }
+    auto median_bytes = GetPercentile(interval_bytes, 50.0f);
+
+    if (options.json) {
+        nlohmann::json json;
+
+        for (const auto &[type, stats] : summary.types) {
+            json["types"][type] = {{"count", stats.count}, {"bytes", stats.bytes}, {"max_size", stats.max_size}};
+        }
+
+        for (const auto &[index, types] : summary.intervals) {
+            nlohmann::json interval = {{"start", index * options.interval_seconds}};
+            for (const auto &[type, stats] : types) {
+                interval["types"][type] = {{"count", stats.count}, {"bytes", stats.bytes}};
+            }
+            json["intervals"].emplace_back(ToRvalue(interval));
+        }
+
+        for (const auto &record : summary.largest) {
+            json["largest"].push_back({
+                {"time", record.time},
+                {"connection", record.connection_id},
+                {"direction", ToShortString(record.direction)},
+                {"type", record.type},
+                {"size", record.size}});
+        }
+
+        for (auto &[key, stream] : summary.streams) {
+            json["gaps"].push_back({
+                {"connection", key.first},
+                {"direction", ToShortString(key.second)},
+                {"p50", GetPercentile(stream.gaps, 50.0f)},
+                {"p99", GetPercentile(stream.gaps, 99.0f)},
+                {"max", stream.max_gap},
+                {"max_at", stream.max_gap_time}});
+        }
+
+        json["malformed"] = summary.num_malformed;
+        fmt::print("{}\n", nlohmann::json{{"summary", json}}.dump());
+        return;
+    }
+
+    fmt::print("\n== Messages per type ==\n");
+    fmt::print("{:<32} {:>8} {:>12} {:>8} {:>8}\n", "type", "count", "bytes", "avg", "max");
+    for (const auto &[type, stats] : summary.types) {
+        fmt::print("{:<32} {:>8} {:>12} {:>8} {:>8}\n", type, stats.count, stats.bytes, stats.bytes / stats.count, stats.max_size);
+    }
+
+    fmt::print("\n== Bytes per {}s (median {:.0f}) ==\n", options.interval_seconds, median_bytes);
+    for (const auto &[index, types] : summary.intervals) {
+        Array<std::pair<String, TypeStats>> sorted{types.begin(), types.end()};
+        std::sort(sorted.begin(), sorted.end(),
+            [](const auto &a, const auto &b) {
+                return a.second.bytes > b.second.bytes;
+            });
+
+        u64 bytes = 0;
+        u64 count = 0;
+        for (const auto &[type, stats] : sorted) {
+            bytes += stats.bytes;
+            count += stats.count;
+        }
+
+        String top;
+        for (size_t i = 0; i < std::min<size_t>(3, sorted.size()); ++i) {
+            top += "{} {}/{}  "_format(sorted[i].first, sorted[i].second.count, sorted[i].second.bytes);
+        }
+
+        fmt::print("{:10.1f} {:>8} msgs {:>10} bytes  {}{}\n",
+            index * options.interval_seconds,
+            count,
+            bytes,
+            top,
+            static_cast<f64>(bytes) > 2.0 * median_bytes ? "<-- spike" : "");
+    }
+
+    fmt::print("\n== Largest messages ==\n");
+    for (const auto &record : summary.largest) {
+        PrintRecord(record, options);
+    }
+
+    fmt::print("\n== Inter-arrival gaps (ms) ==\n");
+    for (auto &[key, stream] : summary.streams) {
+        fmt::print("connection {:>4} {:<3} n={:<8} p50={:8.2f} p99={:8.2f} max={:8.2f} (ended at {:.3f}s)\n",
+            key.first,
+            ToShortString(key.second),
+            stream.gaps.size(),
+            1000.0 * GetPercentile(stream.gaps, 50.0f),
+            1000.0 * GetPercentile(stream.gaps, 99.0f),
+            1000.0 * stream.max_gap,
+            stream.max_gap_time);
+    }
+
+    if (summary.num_malformed > 0) {
+        fmt::print("\n{} malformed packets\n", summary.num_malformed);
+    }
+}
+
+int main(int argc, char **argv) {
+    TracedumpOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 1;
+    }
+
+    NetTraceReader reader;
+    if (!reader.Open(options.filename)) {
+        return 1;
+    }
+
+    if (!options.json) {
+        fmt::print("{} trace, started at unix time {} ms\n", reader.role == NetTraceRole::RECORDED_BY_SERVER ? "Server" : "Client", reader.started_unix_ms);
+    }
+
+    TraceSummary summary;
+    NetTraceRecord record;
+
+    while (reader.Next(record)) {
+        if (options.connection_id.has_value() && record.connection_id != options.connection_id.value()) {
+            continue;
+        }
+
+        auto decoded = DecodeRecord(record, reader.role);
+
+        if (options.type_name.has_value() && !decoded.type.starts_with(options.type_name.value())) {
+            continue;
+        }
+
+        if (!options.summary_only) {
+            PrintRecord(decoded, options);
+        }
+
+        AddToSummary(summary, decoded, options);
+    }
+
+    PrintSummary(summary, options);
+    return 0;
+}